@@ -707,12 +707,24 @@ int ne__negotiate_ssl(ne_session *sess)
     sess->ssl_cc_requested = 0;
     ctx->failures = 0;
 
+#ifdef WINSCP
+    /* the session of another connection to the server is tried,
+     * if it used the same client certificate (as far as known yet) */
+    ctx->cache_host = sess->server.hostname;
+    ctx->cache_port = (int)sess->server.port;
+    ctx->cache_clicert = sess->client_cert ? sess->client_cert->cert.subject : NULL;
+#endif
+
     if (ne_sock_connect_ssl(sess->socket, ctx, sess)) {
 	if (ctx->sess) {
 	    /* remove cached session. */
 	    SSL_SESSION_free(ctx->sess);
 	    ctx->sess = NULL;
 	}
+#ifdef WINSCP
+        cached_ssl_session_remove(sess->server.hostname,
+                                  (int)sess->server.port);
+#endif
         if (sess->ssl_cc_requested) {
             ne_set_error(sess, _("SSL handshake failed, "
                                  "client certificate was requested: %s"),
@@ -776,6 +788,14 @@ int ne__negotiate_ssl(ne_session *sess)
 	ctx->sess = SSL_get1_session(ssl);
     }
 
+#ifdef WINSCP
+    /* certificate was accepted, share the session
+     * (keyed by the client certificate actually provided, if any) */
+    cached_ssl_session_put(sess->server.hostname, (int)sess->server.port, ssl,
+                           sess->client_cert ? sess->client_cert->cert.subject : NULL,
+                           ctx->sess);
+#endif
+
     return NE_OK;
 }
 
@@ -1366,4 +1386,13 @@ char * ne_ssl_get_cipher(ne_session *sess)
     return buffer;	
 }
 
+void ne__ssl_set_session(ne_session *sess)
+{
+    SSL * ssl = ne__sock_sslsock(sess->socket);
+    if (ssl != NULL)
+    {
+        SSL_set_app_data(ssl, sess);
+    }
+}
+
 #endif
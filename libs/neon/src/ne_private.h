@@ -107,6 +107,13 @@ struct ne_session_s {
     void *notify_ud;
 
     int rdtimeout, cotimeout; /* read, connect timeouts. */
+#ifdef WINSCP
+    /* Buffer for request and response bodies, and size of the
+     * connection read buffer (ne_set_io_buffer_size); allocated on
+     * first use. */
+    size_t io_bufsize;
+    char *io_buffer;
+#endif
 
     struct hook *create_req_hooks, *pre_send_hooks, *post_send_hooks,
         *post_headers_hooks, *destroy_req_hooks, *destroy_sess_hooks, 
@@ -146,6 +153,12 @@ NE_PRIVATE int ne__negotiate_ssl(ne_session *sess);
 /* Set the session error appropriate for SSL verification failures. */
 NE_PRIVATE void ne__ssl_set_verify_err(ne_session *sess, int failures);
 
+#ifdef WINSCP
+/* Make the SSL connection of the session refer back to the session,
+ * after the connection was moved over from another session. */
+NE_PRIVATE void ne__ssl_set_session(ne_session *sess);
+#endif
+
 /* Return non-zero if hostname from certificate (cn) matches hostname
  * used for session (hostname); follows RFC2818 logic. */
 NE_PRIVATE int ne__ssl_match_hostname(const char *cn, size_t cnlen, 
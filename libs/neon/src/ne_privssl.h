@@ -41,8 +41,27 @@ struct ne_ssl_context_s {
     SSL_SESSION *sess;
     const char *hostname; /* for SNI */
     int failures; /* bitmask of exposed failure bits. */
+#ifdef WINSCP
+    /* Key of the session shared with other connections of the
+     * application, looked up by ne_sock_connect_ssl once the TLS
+     * versions allowed are set; cache_host is NULL to not share. */
+    const char *cache_host;
+    int cache_port;
+    X509 *cache_clicert;
+#endif
 };
 
+#ifdef WINSCP
+/* TLS sessions shared with other connections of the application,
+ * see TlsSessionCache.h */
+extern SSL_SESSION *cached_ssl_session_get(const char *host, int port,
+                                           const SSL *ssl, const X509 *clicert);
+extern void cached_ssl_session_put(const char *host, int port,
+                                   const SSL *ssl, const X509 *clicert,
+                                   SSL_SESSION *session);
+extern void cached_ssl_session_remove(const char *host, int port);
+#endif
+
 typedef SSL *ne_ssl_socket;
 
 /* Create a clicert object from cert DER {der, der_len}, using given
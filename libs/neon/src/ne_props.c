@@ -34,6 +34,9 @@
 #include "ne_basic.h"
 #include "ne_locks.h"
 #include "ne_internal.h"
+#ifdef WINSCP
+#include "ne_compress.h"
+#endif
 
 /* don't store flat props with a value > 10K */
 #define MAX_FLATPROP_LEN (102400)
@@ -124,6 +127,9 @@ static int propfind(ne_propfind_handler *handler,
 {
     int ret;
     ne_request *req = handler->request;
+#ifdef WINSCP
+    ne_decompress *dc = NULL;
+#endif
 
     /* Register the flat property handler to catch any properties 
      * which the user isn't handling as 'complex'. */
@@ -137,11 +143,26 @@ static int propfind(ne_propfind_handler *handler,
 
     ne_add_request_header(req, "Content-Type", NE_XML_MEDIA_TYPE);
     
+#ifdef WINSCP
+    /* Multistatus responses compress very well, the decompressed
+     * response is parsed incrementally as it is received. */
+    if (ne_get_session_flag(handler->sess, NE_SESSFLAG_COMPRESS)) {
+        dc = ne_decompress_reader(req, ne_accept_207, ne_xml_parse_v,
+                                  handler->parser);
+    }
+    else
+#endif
     ne_add_response_body_reader(req, ne_accept_207, ne_xml_parse_v, 
 				  handler->parser);
 
     ret = ne_request_dispatch(req);
 
+#ifdef WINSCP
+    if (dc != NULL) {
+        ne_decompress_destroy(dc);
+    }
+#endif
+
     if (ret == NE_OK && ne_get_status(req)->klass != 2) {
 	ret = NE_ERROR;
     } else if (ne_xml_failed(handler->parser)) {
@@ -375,6 +375,22 @@ static ssize_t body_fd_send(void *userdata, char *buffer, size_t count)
 #define CHUNK_TERM "\r\n0\r\n\r\n"
 #define CHUNK_NULL_TERM "0\r\n\r\n"
 
+#ifdef WINSCP
+/* Returns the session buffer for request and response bodies, its
+ * size in 'size'. */
+static char *get_io_buffer(ne_session *sess, size_t *size)
+{
+    if (sess->io_bufsize < NE_BUFSIZ) {
+        sess->io_bufsize = NE_BUFSIZ;
+    }
+    if (sess->io_buffer == NULL) {
+        sess->io_buffer = ne_malloc(sess->io_bufsize);
+    }
+    *size = sess->io_bufsize;
+    return sess->io_buffer;
+}
+#endif
+
 /* Sends the request body; returns 0 on success or an NE_* error code.
  * If retry is non-zero; will return NE_RETRY on persistent connection
  * timeout.  On error, the session error string is set and the
@@ -383,24 +399,38 @@ static int send_request_body(ne_request *req, int retry)
 {
     ne_session *const sess = req->session;
     NE_DEBUG_WINSCP_CONTEXT(sess);
+#ifdef WINSCP
+    char *buffer, *start;
+    size_t bufsize;
+#else
     char buffer[NE_BUFSIZ], *start;
+    size_t bufsize = sizeof buffer;
+#endif
     ssize_t bytes;
     size_t buflen;
     int chunked = req->body_length < 0, chunknum = 0;
     int ret;
 
+#ifdef WINSCP
+    buffer = get_io_buffer(sess, &bufsize);
+    /* The chunk-size prefix has room for four hex digits only */
+    if (chunked && bufsize > NE_BUFSIZ) {
+        bufsize = NE_BUFSIZ;
+    }
+#endif
+
     NE_DEBUG(NE_DBG_HTTP, "Sending request body:\n");
 
     /* Set up status union and (start, buflen) as the buffer to be
      * passed the supplied callback. */
     if (chunked) {
         start = buffer + CHUNK_OFFSET;
-        buflen = sizeof(buffer) - CHUNK_OFFSET;
+        buflen = bufsize - CHUNK_OFFSET;
         req->session->status.sr.total = -1;
     }
     else {
         start = buffer;
-        buflen = sizeof buffer;
+        buflen = bufsize;
         req->session->status.sr.total = req->body_length;
     }
 
@@ -1474,10 +1504,17 @@ int ne_end_request(ne_request *req)
 int ne_read_response_to_fd(ne_request *req, int fd)
 {
     ssize_t len;
+#ifdef WINSCP
+    /* Larger blocks than respbuf, to write the file in fewer calls */
+    size_t bufsize;
+    char *buffer = get_io_buffer(req->session, &bufsize);
+#else
+    char *buffer = req->respbuf;
+    size_t bufsize = sizeof req->respbuf;
+#endif
 
-    while ((len = ne_read_response_block(req, req->respbuf, 
-                                         sizeof req->respbuf)) > 0) {
-        const char *block = req->respbuf;
+    while ((len = ne_read_response_block(req, buffer, bufsize)) > 0) {
+        const char *block = buffer;
 
         do {
             ssize_t ret = write(fd, block, len);
@@ -1605,6 +1642,11 @@ static int do_connect(ne_session *sess, struct host_info *host)
         return NE_ERROR;
     }
 
+#ifdef WINSCP
+    if (sess->io_bufsize)
+        ne_sock_set_read_buffer_size(sess->socket, sess->io_bufsize);
+#endif
+
     if (sess->cotimeout)
 	ne_sock_connect_timeout(sess->socket, sess->cotimeout);
 
@@ -114,6 +114,9 @@ void ne_session_destroy(ne_session *sess)
     if (sess->user_agent) ne_free(sess->user_agent);
     if (sess->socks_user) ne_free(sess->socks_user);
     if (sess->socks_password) ne_free(sess->socks_password);
+#ifdef WINSCP
+    if (sess->io_buffer) ne_free(sess->io_buffer);
+#endif
 
 #ifdef NE_HAVE_SSL
     if (sess->ssl_context)
@@ -423,6 +426,17 @@ void ne_set_connect_timeout(ne_session *sess, int timeout)
     sess->cotimeout = timeout;
 }
 
+#ifdef WINSCP
+void ne_set_io_buffer_size(ne_session *sess, size_t size)
+{
+    if (sess->io_buffer) {
+        ne_free(sess->io_buffer);
+        sess->io_buffer = NULL;
+    }
+    sess->io_bufsize = size;
+}
+#endif
+
 #define UAHDR "User-Agent: "
 #define AGENT " neon/" NEON_VERSION "\r\n"
 
@@ -501,6 +515,45 @@ void ne_close_connection(ne_session *sess)
     sess->connected = 0;
 }
 
+#ifdef WINSCP
+int ne_session_move_connection(ne_session *to, ne_session *from)
+{
+    if (!from->connected || from->nexthop != &from->server
+        || to->connected || to->proxies != NULL
+        || to->use_ssl != from->use_ssl
+        || to->server.port != from->server.port
+        || ne_strcasecmp(to->server.hostname, from->server.hostname) != 0) {
+        return -1;
+    }
+
+    NE_DEBUG(NE_DBG_SOCKET, "sess: Taking over connection.\n");
+
+    to->socket = from->socket;
+    to->connected = 1;
+    /* Treat as persisted, so that the request is retried on a new
+     * connection if the server has closed this one meanwhile. */
+    to->persisted = 1;
+    to->is_http11 = from->is_http11;
+    to->nexthop = &to->server;
+
+#ifdef NE_HAVE_SSL
+    if (to->server_cert) {
+        ne_ssl_cert_free(to->server_cert);
+    }
+    to->server_cert = from->server_cert;
+    from->server_cert = NULL;
+    if (to->use_ssl) {
+        ne__ssl_set_session(to);
+    }
+#endif
+
+    from->socket = NULL;
+    from->connected = 0;
+    from->persisted = 0;
+    return 0;
+}
+#endif
+
 void ne_ssl_set_verify(ne_session *sess, ne_ssl_verify_fn fn, void *userdata)
 {
     sess->ssl_verify_fn = fn;
@@ -46,6 +46,17 @@ void ne_session_destroy(ne_session *sess);
  * session. */
 void ne_close_connection(ne_session *sess);
 
+#ifdef WINSCP
+/* Hand over the established (idle) connection of session 'from' to
+ * session 'to', which must be a session to the same server, not yet
+ * connected.  Only direct connections (no proxy) can be handed over.
+ * The certificate of the server is not verified again, it is up to
+ * the caller to pair only sessions with equal verification settings.
+ * Returns zero on success, non-zero if the connection cannot be
+ * handed over, in which case neither session is changed. */
+int ne_session_move_connection(ne_session *to, ne_session *from);
+#endif
+
 /* Configure an HTTP proxy server for the session.  This function will
  * override (remove) any proxy servers previously configured, and must
  * be called before any requests are created using this session. */
@@ -100,6 +111,11 @@ typedef enum ne_session_flag_e {
     NE_SESSFLAG_EXPECT100, /* enable this flag to enable the flag
                             * NE_REQFLAG_EXPECT100 for new requests. */
 
+#ifdef WINSCP
+    NE_SESSFLAG_COMPRESS, /* enable this flag to request compressed
+                           * (gzip) responses to PROPFIND. */
+#endif
+
     NE_SESSFLAG_LAST /* enum sentinel value */
 } ne_session_flag;
 
@@ -309,6 +325,15 @@ void ne_set_read_timeout(ne_session *sess, int timeout);
  * timeout value must be greater than zero. */
 void ne_set_connect_timeout(ne_session *sess, int timeout);
 
+#ifdef WINSCP
+/* Set the size of buffers used for reading from the connection and for
+ * sending request bodies and saving response bodies to files.  Larger
+ * buffers reduce the number of system calls for large bodies (and let
+ * the body be encrypted in full-size TLS records).  Zero sets the
+ * default size.  Takes effect for the next connection. */
+void ne_set_io_buffer_size(ne_session *sess, size_t size);
+#endif
+
 /* Sets the user-agent string. neon/VERSION will be appended, to make
  * the full header "User-Agent: product neon/VERSION".
  * If this function is not called, the User-Agent header is not sent.
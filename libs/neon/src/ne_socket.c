@@ -144,6 +144,21 @@ typedef struct in_addr ne_inet_addr;
 #include "ne_sspi.h"
 #include "ne_session.h"
 
+#if defined(WINSCP) && defined(USE_GETADDRINFO)
+/* Name resolution shared with the other protocol stacks of the
+ * application, see ResolverCache.h */
+extern int cached_getaddrinfo(const char *node, const char *service,
+                              const struct addrinfo *hints,
+                              struct addrinfo **res);
+extern void cached_freeaddrinfo(struct addrinfo *ai);
+extern void cached_addrinfo_connected(const struct sockaddr *addr);
+#define ne_getaddrinfo cached_getaddrinfo
+#define ne_freeaddrinfo cached_freeaddrinfo
+#else
+#define ne_getaddrinfo getaddrinfo
+#define ne_freeaddrinfo freeaddrinfo
+#endif
+
 #if defined(__BEOS__) && !defined(BONE_VERSION)
 /* pre-BONE */
 #define ne_close(s) closesocket(s)
@@ -219,7 +234,15 @@ struct ne_socket_s {
     char *bufpos;
     size_t bufavail;
 #define RDBUFSIZ 4096
+#ifdef WINSCP
+    /* Allocated, of ->bufsize bytes (ne_sock_set_read_buffer_size) */
+    char *buffer;
+    size_t bufsize;
+#define RDBUFLEN(s) ((s)->bufsize)
+#else
     char buffer[RDBUFSIZ];
+#define RDBUFLEN(s) (sizeof (s)->buffer)
+#endif
     /* Error string. */
     char error[192];
 };
@@ -458,12 +481,12 @@ ssize_t ne_sock_read(ne_socket *sock, char *buffer, size_t buflen)
 	sock->bufpos += buflen;
 	sock->bufavail -= buflen;
 	return (ssize_t)buflen;
-    } else if (buflen >= sizeof sock->buffer) {
+    } else if (buflen >= RDBUFLEN(sock)) {
 	/* No need for read buffer. */
 	return sock->ops->sread(sock, buffer, buflen);
     } else {
 	/* Fill read buffer. */
-	bytes = sock->ops->sread(sock, sock->buffer, sizeof sock->buffer);
+	bytes = sock->ops->sread(sock, sock->buffer, RDBUFLEN(sock));
 	if (bytes <= 0)
 	    return bytes;
 
@@ -485,7 +508,7 @@ ssize_t ne_sock_peek(ne_socket *sock, char *buffer, size_t buflen)
 	bytes = (ssize_t)sock->bufavail;
     } else {
 	/* fill the buffer. */
-	bytes = sock->ops->sread(sock, sock->buffer, sizeof sock->buffer);
+	bytes = sock->ops->sread(sock, sock->buffer, RDBUFLEN(sock));
 	if (bytes <= 0)
 	    return bytes;
 
@@ -853,7 +876,7 @@ ssize_t ne_sock_readline(ne_socket *sock, char *buf, size_t buflen)
     size_t len;
     
     if ((lf = memchr(sock->bufpos, '\n', sock->bufavail)) == NULL
-	&& sock->bufavail < RDBUFSIZ) {
+	&& sock->bufavail < RDBUFLEN(sock)) {
 	/* The buffered data does not contain a complete line: move it
 	 * to the beginning of the buffer. */
 	if (sock->bufavail)
@@ -865,11 +888,11 @@ ssize_t ne_sock_readline(ne_socket *sock, char *buf, size_t buflen)
 	do {
 	    /* Read more data onto end of buffer. */
 	    ssize_t ret = sock->ops->sread(sock, sock->buffer + sock->bufavail,
-                                           RDBUFSIZ - sock->bufavail);
+                                           RDBUFLEN(sock) - sock->bufavail);
 	    if (ret < 0) return ret;
 	    sock->bufavail += ret;
 	} while ((lf = memchr(sock->buffer, '\n', sock->bufavail)) == NULL
-		 && sock->bufavail < RDBUFSIZ);
+		 && sock->bufavail < RDBUFLEN(sock));
     }
 
     if (lf)
@@ -936,7 +959,7 @@ ne_sock_addr *ne_addr_resolve(const char *hostname, int flags)
 	hints.ai_flags |= AI_NUMERICHOST;
 #endif
         hints.ai_family = AF_INET6;
-	addr->errnum = getaddrinfo(hn, NULL, &hints, &addr->result);
+	addr->errnum = ne_getaddrinfo(hn, NULL, &hints, &addr->result);
 	ne_free(hn);
     } else 
 #endif /* AF_INET6 */
@@ -944,10 +967,10 @@ ne_sock_addr *ne_addr_resolve(const char *hostname, int flags)
 #ifdef USE_GAI_ADDRCONFIG /* added in the RFC3493 API */
         hints.ai_flags |= AI_ADDRCONFIG;
         hints.ai_family = AF_UNSPEC;
-        addr->errnum = getaddrinfo(hostname, NULL, &hints, &addr->result);
+        addr->errnum = ne_getaddrinfo(hostname, NULL, &hints, &addr->result);
 #else
         hints.ai_family = ipv6_disabled ? AF_INET : AF_UNSPEC;
-	addr->errnum = getaddrinfo(hostname, NULL, &hints, &addr->result);
+	addr->errnum = ne_getaddrinfo(hostname, NULL, &hints, &addr->result);
 #endif
     }
 #else /* Use gethostbyname() */
@@ -1182,7 +1205,7 @@ void ne_addr_destroy(ne_sock_addr *addr)
     /* Note that ->result is only valid for successful invocations of
      * getaddrinfo. */
     if (!addr->errnum && addr->result)
-	freeaddrinfo(addr->result);
+	ne_freeaddrinfo(addr->result);
 #else
     if (addr->addrs)
 	ne_free(addr->addrs);
@@ -1326,6 +1349,10 @@ ne_socket *ne_sock_create(void)
     ne_socket *sock = ne_calloc(sizeof *sock);
     sock->rdtimeout = SOCKET_READ_TIMEOUT;
     sock->cotimeout = 0;
+#ifdef WINSCP
+    sock->bufsize = RDBUFSIZ;
+    sock->buffer = ne_malloc(sock->bufsize);
+#endif
     sock->bufpos = sock->buffer;
     sock->ops = &iofns_raw;
     sock->fd = -1;
@@ -1485,8 +1512,12 @@ int ne_sock_connect(ne_socket *sock,
 #endif
     
     ret = connect_socket(sock, fd, addr, htons(port));
-    if (ret == 0)
+    if (ret == 0) {
         sock->fd = fd;
+#if defined(WINSCP) && defined(USE_GETADDRINFO)
+        cached_addrinfo_connected(addr->ai_addr);
+#endif
+    }
     else
         ne_close(fd);
 
@@ -1645,6 +1676,20 @@ void ne_sock_connect_timeout(ne_socket *sock, int timeout)
     sock->cotimeout = timeout;
 }
 
+#ifdef WINSCP
+
+void ne_sock_set_read_buffer_size(ne_socket *sock, size_t size)
+{
+    if (size > 0 && size != sock->bufsize && sock->bufavail == 0) {
+        ne_free(sock->buffer);
+        sock->bufsize = size;
+        sock->buffer = ne_malloc(sock->bufsize);
+        sock->bufpos = sock->buffer;
+    }
+}
+
+#endif /* WINSCP */
+
 #ifdef NE_HAVE_SSL
 
 #ifdef HAVE_GNUTLS
@@ -1789,13 +1834,19 @@ int ne_sock_connect_ssl(ne_socket *sock, ne_ssl_context *ctx, void *userdata)
     }
 #endif
     
-    if (ctx->sess)
-	SSL_set_session(ssl, ctx->sess);
-
 #ifdef WINSCP
     ne_init_ssl_session(ssl, userdata);
+    if (ctx->sess == NULL && ctx->cache_host != NULL) {
+        /* try the session of another connection to the server,
+         * now that the TLS versions allowed are set */
+        ctx->sess = cached_ssl_session_get(ctx->cache_host, ctx->cache_port,
+                                           ssl, ctx->cache_clicert);
+    }
 #endif
 
+    if (ctx->sess)
+	SSL_set_session(ssl, ctx->sess);
+
     ret = SSL_connect(ssl);
     if (ret != 1) {
 	error_ossl(sock, ret);
@@ -1966,6 +2017,9 @@ int ne_sock_close(ne_socket *sock)
         ret = 0;
     else
         ret = ne_close(sock->fd);
+#ifdef WINSCP
+    ne_free(sock->buffer);
+#endif
     ne_free(sock);
     return ret;
 }
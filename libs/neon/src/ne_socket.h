@@ -250,6 +250,13 @@ void ne_sock_read_timeout(ne_socket *sock, int timeout);
  * connect call will only timeout as dictated by the TCP stack. */
 void ne_sock_connect_timeout(ne_socket *sock, int timeout);
 
+#ifdef WINSCP
+/* Set size of the read buffer of the socket; the socket must not have
+ * any data buffered yet (call before connecting).  A large buffer
+ * reduces the number of recv() calls for large response bodies. */
+void ne_sock_set_read_buffer_size(ne_socket *sock, size_t size);
+#endif
+
 /* Negotiate an SSL connection on socket as an SSL server, using given
  * SSL context. */
 int ne_sock_accept_ssl(ne_socket *sock, ne_ssl_context *ctx);
@@ -551,6 +551,15 @@ const char *winsock_error_string(int error)
     return es->text;
 }
 
+#if defined(MPEXT) && !defined(NO_IPV6)
+/* Resolution shared by all sessions of the process, see ResolverCache.h */
+extern int cached_getaddrinfo(const char *node, const char *service,
+                              const struct addrinfo *hints,
+                              struct addrinfo **res);
+extern void cached_freeaddrinfo(struct addrinfo *ai);
+extern void cached_addrinfo_connected(const struct sockaddr *addr);
+#endif
+
 SockAddr sk_namelookup(const char *host, char **canonicalname,
 		       int address_family)
 {
@@ -595,7 +604,11 @@ SockAddr sk_namelookup(const char *host, char **canonicalname,
             {
                 /* strip [] on IPv6 address literals */
                 char *trimmed_host = host_strduptrim(host);
+#ifdef MPEXT
+                err = cached_getaddrinfo(trimmed_host, NULL, &hints, &ret->ais);
+#else
                 err = p_getaddrinfo(trimmed_host, NULL, &hints, &ret->ais);
+#endif
                 sfree(trimmed_host);
             }
 	    if (err == 0)
@@ -924,8 +937,13 @@ void sk_addr_free(SockAddr addr)
     if (--addr->refcount > 0)
 	return;
 #ifndef NO_IPV6
+#ifdef MPEXT
+    if (addr->ais)
+	cached_freeaddrinfo(addr->ais);
+#else
     if (addr->ais && p_freeaddrinfo)
 	p_freeaddrinfo(addr->ais);
+#endif
 #endif
     if (addr->addresses)
 	sfree(addr->addresses);
@@ -1807,6 +1825,10 @@ void select_result(WPARAM wParam, LPARAM lParam)
 	 * to.
 	 */
 	if (s->addr) {
+#if defined(MPEXT) && !defined(NO_IPV6)
+	    if (s->step.ai)
+		cached_addrinfo_connected(s->step.ai->ai_addr);
+#endif
 	    sk_addr_free(s->addr);
 	    s->addr = NULL;
 	}
@@ -27,10 +27,14 @@
 #include "../base/FormatUtils.cpp"
 
 #include "../core/RemoteFiles.cpp"
+#include "../core/ResolverCache.cpp"
+#include "../core/BandwidthLimiter.cpp"
+#include "../core/TlsSessionCache.cpp"
 #include "../core/Terminal.cpp"
 #include "../core/FileOperationProgress.cpp"
 #include "../core/Queue.cpp"
 #include "../core/SecureShell.cpp"
+#include "../core/SocketReactor.cpp"
 #include "../core/SessionInfo.cpp"
 #include "../core/Script.cpp"
 #include "../core/CoreMain.cpp"
@@ -1571,6 +1571,8 @@ private:
   TFarCheckBox *IgnoreLsWarningsCheck;
   TFarCheckBox *SCPLsFullTimeAutoCheck;
   TFarCheckBox *Scp1CompatibilityCheck;
+  TFarCheckBox *SCPTarTransferAutoCheck;
+  TFarCheckBox *SCPTarCompressionCheck;
   TFarEdit *PostLoginCommandsEdits[3];
   TFarEdit *TimeDifferenceEdit;
   TFarEdit *TimeDifferenceMinutesEdit;
@@ -1642,6 +1644,7 @@ private:
   TFarCheckBox *FtpUndupFFCheck;
   TFarCheckBox *SslSessionReuseCheck;
   TFarCheckBox *WebDAVCompressionCheck;
+  TFarCheckBox *WebDAVLockDiscoveryCheck;
   TObjectList *FTabs;
   intptr_t FFirstVisibleTabIndex;
 };
@@ -2108,6 +2111,16 @@ TSessionDialog::TSessionDialog(TCustomFarPlugin *AFarPlugin, TSessionActionEnum
 
   SetNextItemPosition(ipNewLine);
 
+  SCPTarTransferAutoCheck = new TFarCheckBox(this);
+  SCPTarTransferAutoCheck->SetCaption(GetMsg(NB_LOGIN_SCP_TAR_TRANSFER_AUTO));
+
+  SetNextItemPosition(ipRight);
+
+  SCPTarCompressionCheck = new TFarCheckBox(this);
+  SCPTarCompressionCheck->SetCaption(GetMsg(NB_LOGIN_SCP_TAR_COMPRESSION));
+
+  SetNextItemPosition(ipNewLine);
+
   new TFarSeparator(this);
 
   // SFTP Tab
@@ -2752,6 +2765,9 @@ TSessionDialog::TSessionDialog(TCustomFarPlugin *AFarPlugin, TSessionActionEnum
   WebDAVCompressionCheck = new TFarCheckBox(this);
   WebDAVCompressionCheck->SetCaption(GetMsg(NB_LOGIN_COMPRESSION));
 
+  WebDAVLockDiscoveryCheck = new TFarCheckBox(this);
+  WebDAVLockDiscoveryCheck->SetCaption(GetMsg(NB_LOGIN_WEBDAV_LOCK_DISCOVERY));
+
 #undef TRISTATE
 
   new TFarSeparator(this);
@@ -3045,6 +3061,8 @@ void TSessionDialog::UpdateControls()
   UnsetNationalVarsCheck->SetEnabled(ScpOnlyProtocol);
   ClearAliasesCheck->SetEnabled(ScpOnlyProtocol);
   Scp1CompatibilityCheck->SetEnabled(ScpOnlyProtocol);
+  SCPTarTransferAutoCheck->SetEnabled(ScpOnlyProtocol);
+  SCPTarCompressionCheck->SetEnabled(ScpOnlyProtocol);
 
   // Connection/Proxy tab
   TFarComboBox *ProxyMethodCombo = GetProxyMethodCombo();
@@ -3184,6 +3202,8 @@ bool TSessionDialog::Execute(TSessionData *SessionData, TSessionActionEnum &Acti
   ClearAliasesCheck->SetChecked(SessionData->GetClearAliases());
   IgnoreLsWarningsCheck->SetChecked(SessionData->GetIgnoreLsWarnings());
   Scp1CompatibilityCheck->SetChecked(SessionData->GetScp1Compatibility());
+  SCPTarTransferAutoCheck->SetChecked(SessionData->GetSCPTarTransfer() != asOff);
+  SCPTarCompressionCheck->SetChecked(SessionData->GetSCPTarCompression());
   UnsetNationalVarsCheck->SetChecked(SessionData->GetUnsetNationalVars());
   ListingCommandEdit->SetText(SessionData->GetListingCommand());
   SCPLsFullTimeAutoCheck->SetChecked((SessionData->GetSCPLsFullTime() != asOff));
@@ -3403,6 +3423,7 @@ bool TSessionDialog::Execute(TSessionData *SessionData, TSessionActionEnum &Acti
 
   // WebDAV tab
   WebDAVCompressionCheck->SetChecked(SessionData->GetCompression());
+  WebDAVLockDiscoveryCheck->SetChecked(SessionData->GetWebDavLockDiscovery());
 
 #undef TRISTATE
 
@@ -3501,6 +3522,8 @@ bool TSessionDialog::Execute(TSessionData *SessionData, TSessionActionEnum &Acti
     SessionData->SetClearAliases(ClearAliasesCheck->GetChecked());
     SessionData->SetIgnoreLsWarnings(IgnoreLsWarningsCheck->GetChecked());
     SessionData->SetScp1Compatibility(Scp1CompatibilityCheck->GetChecked());
+    SessionData->SetSCPTarTransfer(SCPTarTransferAutoCheck->GetChecked() ? asAuto : asOff);
+    SessionData->SetSCPTarCompression(SCPTarCompressionCheck->GetChecked());
     SessionData->SetUnsetNationalVars(UnsetNationalVarsCheck->GetChecked());
     SessionData->SetListingCommand(ListingCommandEdit->GetText());
     SessionData->SetSCPLsFullTime(SCPLsFullTimeAutoCheck->GetChecked() ? asAuto : asOff);
@@ -3727,7 +3750,10 @@ bool TSessionDialog::Execute(TSessionData *SessionData, TSessionActionEnum &Acti
 
     // WebDAV tab
     if (GetFSProtocol() == fsWebDAV)
+    {
       SessionData->SetCompression(WebDAVCompressionCheck->GetChecked());
+      SessionData->SetWebDavLockDiscovery(WebDAVLockDiscoveryCheck->GetChecked());
+    }
 
 #undef TRISTATE
     SessionData->SetBug(sbIgnore1, static_cast<TAutoSwitch>(2 - BugIgnore1Combo->GetItemIndex()));
@@ -3000,6 +3000,12 @@ bool TWinSCPFileSystem::Connect(TSessionData *Data)
     {
       throw Exception(FORMAT(GetMsg(NB_CANNOT_INIT_SESSION), Data->GetSessionName()));
     }
+
+    if (GetConfiguration()->GetQueueWarmConnections() > 0)
+    {
+      // have background connections authenticated before the first transfer
+      GetQueue()->WarmUp();
+    }
   }
   catch (Exception &E)
   {
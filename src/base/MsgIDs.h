@@ -266,6 +266,8 @@ enum MsgIDs {
     NB_LOGIN_CLEAR_NATIONAL_VARS,
     NB_LOGIN_CLEAR_ALIASES,
     NB_LOGIN_SCP1_COMPATIBILITY,
+    NB_LOGIN_SCP_TAR_TRANSFER_AUTO,
+    NB_LOGIN_SCP_TAR_COMPRESSION,
     NB_LOGIN_TIME_DIFFERENCE,
     NB_LOGIN_TIME_DIFFERENCE_HOURS,
     NB_LOGIN_TIME_DIFFERENCE_MINUTES,
@@ -389,6 +391,7 @@ enum MsgIDs {
     NB_LOGIN_FTP_POST_LOGIN_COMMANDS,
 
     NB_LOGIN_WEBDAV_GROUP,
+    NB_LOGIN_WEBDAV_LOCK_DISCOVERY,
 
     NB_PROPERTIES_CAPTION,
     NB_PROPERTIES_PROMPT,
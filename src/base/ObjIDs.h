@@ -105,6 +105,7 @@ enum TObjectClassId
   OBJECT_CLASS_TCommandSet,
   OBJECT_CLASS_TPoolForDataEvent,
   OBJECT_CLASS_TSecureShell,
+  OBJECT_CLASS_TSocketReactor,
   OBJECT_CLASS_TIEProxyConfig,
   OBJECT_CLASS_TSessionActionRecord,
   OBJECT_CLASS_TSessionInfo,
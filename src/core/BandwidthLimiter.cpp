@@ -0,0 +1,205 @@
+#include <vcl.h>
+#pragma hdrstop
+
+#include <Common.h>
+
+#include "BandwidthLimiter.h"
+
+// Consumer share is what the rate allows in 1/SHARE_PARTS of a second
+#define SHARE_PARTS 20
+// Burst allowed after the transfers were idle
+#define BURST_PARTS 4
+#define MIN_DELAY 10
+#define MAX_DELAY 100
+
+TBandwidthLimiter::TBandwidthLimiter() :
+  FRate(0),
+  FConsumers(0),
+  FTokens(0),
+  FRefillRemainder(0),
+  FLastRefill(0)
+{
+}
+
+void TBandwidthLimiter::SetRate(intptr_t Rate)
+{
+  if (Rate < 0)
+  {
+    Rate = 0;
+  }
+  // Called for every block by FileZilla, avoid locking when nothing changes
+  if (FRate != Rate)
+  {
+    TGuard Guard(FSection);
+    if (FRate == Rate)
+    {
+      // Set meanwhile by another thread
+    }
+    else if (FRate <= 0)
+    {
+      FLastRefill = ::GetTickCount();
+      FRefillRemainder = 0;
+      FRate = Rate;
+      // Do not make the transfers wait for the first refill
+      FTokens = GetShare();
+    }
+    else
+    {
+      Refill();
+      FRate = Rate;
+      FTokens = std::min(FTokens, GetCapacity());
+    }
+  }
+}
+
+int64_t TBandwidthLimiter::GetCapacity() const
+{
+  return std::max(static_cast<int64_t>(FRate) / BURST_PARTS, GetShare());
+}
+
+int64_t TBandwidthLimiter::GetShare() const
+{
+  int64_t Consumers = std::max(static_cast<int64_t>(FConsumers), static_cast<int64_t>(1));
+  return std::max(static_cast<int64_t>(FRate) / SHARE_PARTS / Consumers, static_cast<int64_t>(1));
+}
+
+void TBandwidthLimiter::Refill()
+{
+  DWORD Now = ::GetTickCount();
+  // Wraps correctly after 49.7 days
+  DWORD Elapsed = Now - FLastRefill;
+  FLastRefill = Now;
+  if (FRate > 0)
+  {
+    // Anything above a second would overflow the bucket anyway
+    Elapsed = std::min(Elapsed, static_cast<DWORD>(MSecsPerSec));
+    int64_t Amount = static_cast<int64_t>(Elapsed) * FRate + FRefillRemainder;
+    FTokens += Amount / MSecsPerSec;
+    FRefillRemainder = Amount % MSecsPerSec;
+    int64_t Capacity = GetCapacity();
+    if (FTokens >= Capacity)
+    {
+      FTokens = Capacity;
+      FRefillRemainder = 0;
+    }
+  }
+}
+
+int64_t TBandwidthLimiter::Take(int64_t Size)
+{
+  int64_t Result;
+  if (FRate <= 0)
+  {
+    Result = Size;
+  }
+  else
+  {
+    TGuard Guard(FSection);
+    Refill();
+    Result = std::max(std::min(Size, FTokens), static_cast<int64_t>(0));
+    FTokens -= Result;
+  }
+  return Result;
+}
+
+void TBandwidthLimiter::Return(int64_t Size)
+{
+  if (FRate > 0)
+  {
+    TGuard Guard(FSection);
+    FTokens = std::min(FTokens + Size, GetCapacity());
+  }
+}
+
+DWORD TBandwidthLimiter::GetDelay(int64_t Size)
+{
+  DWORD Result = 0;
+  if ((FRate > 0) && (Size > 0))
+  {
+    TGuard Guard(FSection);
+    Refill();
+    int64_t Needed = std::min(Size, GetCapacity()) - FTokens;
+    if (Needed > 0)
+    {
+      int64_t Delay = (Needed * MSecsPerSec - FRefillRemainder + FRate - 1) / FRate;
+      Result = static_cast<DWORD>(std::max(std::min(Delay, static_cast<int64_t>(MAX_DELAY)), static_cast<int64_t>(MIN_DELAY)));
+    }
+  }
+  return Result;
+}
+
+void TBandwidthLimiter::AddConsumer()
+{
+  ::InterlockedIncrement(&FConsumers);
+}
+
+void TBandwidthLimiter::RemoveConsumer()
+{
+  ::InterlockedDecrement(&FConsumers);
+}
+
+TBandwidthReservation::TBandwidthReservation(TBandwidthLimiter *Limiter) :
+  FLimiter(Limiter),
+  FReserved(0),
+  FAttached(false)
+{
+  DebugAssert(FLimiter != nullptr);
+}
+
+TBandwidthReservation::~TBandwidthReservation()
+{
+  Release();
+}
+
+int64_t TBandwidthReservation::Available(int64_t Size)
+{
+  int64_t Result;
+  if (FLimiter->GetRate() <= 0)
+  {
+    Release();
+    Result = Size;
+  }
+  else
+  {
+    if (!FAttached)
+    {
+      FLimiter->AddConsumer();
+      FAttached = true;
+    }
+    int64_t Share = FLimiter->GetShare();
+    if (FReserved < std::min(Size, Share))
+    {
+      // Also pays off what was transferred over the reservation before
+      FReserved += FLimiter->Take(Share - FReserved);
+    }
+    Result = (FReserved > 0) ? std::min(Size, FReserved) : 0;
+  }
+  return Result;
+}
+
+void TBandwidthReservation::Consume(int64_t Size)
+{
+  if (FAttached)
+  {
+    FReserved -= Size;
+  }
+}
+
+DWORD TBandwidthReservation::GetDelay(int64_t Size)
+{
+  return FLimiter->GetDelay(std::min(Size, FLimiter->GetShare()) - FReserved);
+}
+
+void TBandwidthReservation::Release()
+{
+  if (FAttached)
+  {
+    if (FReserved != 0)
+    {
+      FLimiter->Return(FReserved);
+      FReserved = 0;
+    }
+    FLimiter->RemoveConsumer();
+    FAttached = false;
+  }
+}
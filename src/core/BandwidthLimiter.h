@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Global.h>
+
+// Token bucket limiting the speed of any number of concurrent transfers
+// to a common rate. The bucket is refilled continuously (with resolution
+// of the system tick) rather than once a second, so that the transfers
+// do not burst at the beginning of each second and then stall.
+// Used both by FileZilla (all FTP transfers of the process)
+// and by TFileOperationProgressType (SFTP, SCP and WebDAV).
+class NB_CORE_EXPORT TBandwidthLimiter
+{
+  CUSTOM_MEM_ALLOCATION_IMPL
+  NB_DISABLE_COPY(TBandwidthLimiter)
+public:
+  TBandwidthLimiter();
+
+  // Bytes per second, 0 means no limit
+  void SetRate(intptr_t Rate);
+  intptr_t GetRate() const { return FRate; }
+
+  // Takes up to Size bytes from the bucket, returns how much was granted
+  int64_t Take(int64_t Size);
+  // Puts back bytes that were taken, but not transferred
+  // (negative Size charges bytes transferred over the grant)
+  void Return(int64_t Size);
+  // How much a single consumer may take at once, so that the rate
+  // is divided evenly among all consumers
+  int64_t GetShare() const;
+  // Milliseconds until Size bytes is available in the bucket
+  DWORD GetDelay(int64_t Size);
+
+  void AddConsumer();
+  void RemoveConsumer();
+
+private:
+  TCriticalSection FSection;
+  volatile intptr_t FRate;
+  volatile LONG FConsumers;
+  int64_t FTokens;
+  int64_t FRefillRemainder;
+  DWORD FLastRefill;
+
+  int64_t GetCapacity() const;
+  void Refill();
+};
+
+// Bandwidth reserved by a single transfer from a shared limiter.
+// The transfer takes its share from the limiter at once and then
+// accounts individual blocks locally, without locking the limiter.
+// Not thread-safe, each transfer (thread) has to use its own reservation.
+class NB_CORE_EXPORT TBandwidthReservation
+{
+  CUSTOM_MEM_ALLOCATION_IMPL
+  NB_DISABLE_COPY(TBandwidthReservation)
+public:
+  explicit TBandwidthReservation(TBandwidthLimiter *Limiter);
+  ~TBandwidthReservation();
+
+  // How much of Size can be transferred now (0 if nothing),
+  // Size as is, when the limiter does not limit
+  int64_t Available(int64_t Size);
+  // Accounts bytes actually transferred
+  void Consume(int64_t Size);
+  // Milliseconds to wait before Available() can grant Size
+  DWORD GetDelay(int64_t Size);
+  // Gives back unused reservation and stops taking part in dividing the rate
+  void Release();
+
+  TBandwidthLimiter *GetLimiter() const { return FLimiter; }
+
+private:
+  TBandwidthLimiter *FLimiter;
+  int64_t FReserved;
+  bool FAttached;
+};
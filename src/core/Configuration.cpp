@@ -68,6 +68,19 @@ TConfiguration::TConfiguration(TObjectClassId Kind) :
   FShowFtpWelcomeMessage(false),
   FTryFtpWhenSshFails(false),
   FParallelDurationThreshold(0),
+  FQueueWarmConnections(0),
+  FQueueIdleConnectionTimeout(0),
+  FResolverCacheLifetime(0),
+  FResolverPreferConnectedFamily(false),
+  FFtpTransferBufferSize(0),
+  FFtpModeZ(0),
+  FFtpModeZLevel(0),
+  FFtpPipelineDepth(0),
+  FFtpPrefetchPasv(false),
+  FParallelDownloadSegmentSize(0),
+  FTlsSessionCache(false),
+  FWebDAVCompression(false),
+  FWebDAVBufferSize(0),
   FScripting(false),
   FSessionReopenAutoMaximumNumberOfRetries(0),
   FDisablePasswordStoring(false),
@@ -144,6 +157,19 @@ void TConfiguration::Default()
   FExternalIpAddress.Clear();
   FTryFtpWhenSshFails = true;
   FParallelDurationThreshold = 10;
+  FQueueWarmConnections = 0;
+  FQueueIdleConnectionTimeout = 10 * 60;
+  FResolverCacheLifetime = 60;
+  FResolverPreferConnectedFamily = false;
+  FFtpTransferBufferSize = 64 * 1024;
+  FFtpModeZ = 0;
+  FFtpModeZLevel = 6;
+  FFtpPipelineDepth = 0;
+  FFtpPrefetchPasv = false;
+  FParallelDownloadSegmentSize = 0;
+  FTlsSessionCache = true;
+  FWebDAVCompression = true;
+  FWebDAVBufferSize = 256 * 1024;
   SetCollectUsage(FDefaultCollectUsage);
   FSessionReopenAutoMaximumNumberOfRetries = CONST_DEFAULT_NUMBER_OF_RETRIES;
 
@@ -285,6 +311,19 @@ UnicodeString TConfiguration::PropertyToKey(UnicodeString Property)
     KEY(String,   ExternalIpAddress); \
     KEY(Bool,     TryFtpWhenSshFails); \
     KEY(Integer,  ParallelDurationThreshold); \
+    KEY(Integer,  QueueWarmConnections); \
+    KEY(Integer,  QueueIdleConnectionTimeout); \
+    KEY(Integer,  ResolverCacheLifetime); \
+    KEY(Bool,     ResolverPreferConnectedFamily); \
+    KEY(Integer,  FtpTransferBufferSize); \
+    KEY(Integer,  FtpModeZ); \
+    KEY(Integer,  FtpModeZLevel); \
+    KEY(Integer,  FtpPipelineDepth); \
+    KEY(Bool,     FtpPrefetchPasv); \
+    KEY(Integer,  ParallelDownloadSegmentSize); \
+    KEY(Bool,     TlsSessionCache); \
+    KEY(Bool,     WebDAVCompression); \
+    KEY(Integer,  WebDAVBufferSize); \
     KEY(Bool,     CollectUsage); \
     KEY(Integer,  SessionReopenAutoMaximumNumberOfRetries); \
   ); \
@@ -1580,6 +1619,71 @@ void TConfiguration::SetParallelDurationThreshold(intptr_t Value)
   SET_CONFIG_PROPERTY(ParallelDurationThreshold);
 }
 
+void TConfiguration::SetQueueWarmConnections(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(QueueWarmConnections);
+}
+
+void TConfiguration::SetQueueIdleConnectionTimeout(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(QueueIdleConnectionTimeout);
+}
+
+void TConfiguration::SetResolverCacheLifetime(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(ResolverCacheLifetime);
+}
+
+void TConfiguration::SetResolverPreferConnectedFamily(bool Value)
+{
+  SET_CONFIG_PROPERTY(ResolverPreferConnectedFamily);
+}
+
+void TConfiguration::SetFtpTransferBufferSize(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(FtpTransferBufferSize);
+}
+
+void TConfiguration::SetFtpModeZ(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(FtpModeZ);
+}
+
+void TConfiguration::SetFtpModeZLevel(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(FtpModeZLevel);
+}
+
+void TConfiguration::SetFtpPipelineDepth(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(FtpPipelineDepth);
+}
+
+void TConfiguration::SetFtpPrefetchPasv(bool Value)
+{
+  SET_CONFIG_PROPERTY(FtpPrefetchPasv);
+}
+
+void TConfiguration::SetParallelDownloadSegmentSize(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(ParallelDownloadSegmentSize);
+}
+
+void TConfiguration::SetTlsSessionCache(bool Value)
+{
+  SET_CONFIG_PROPERTY(TlsSessionCache);
+}
+
+void TConfiguration::SetWebDAVCompression(bool Value)
+{
+  SET_CONFIG_PROPERTY(WebDAVCompression);
+}
+
+void TConfiguration::SetWebDAVBufferSize(intptr_t Value)
+{
+  SET_CONFIG_PROPERTY(WebDAVBufferSize);
+}
+
 void TConfiguration::SetPuttyRegistryStorageKey(UnicodeString Value)
 {
   SET_CONFIG_PROPERTY(PuttyRegistryStorageKey);
@@ -82,6 +82,19 @@ private:
   UnicodeString FExternalIpAddress;
   bool FTryFtpWhenSshFails;
   intptr_t FParallelDurationThreshold;
+  intptr_t FQueueWarmConnections;
+  intptr_t FQueueIdleConnectionTimeout;
+  intptr_t FResolverCacheLifetime;
+  bool FResolverPreferConnectedFamily;
+  intptr_t FFtpTransferBufferSize;
+  intptr_t FFtpModeZ;
+  intptr_t FFtpModeZLevel;
+  intptr_t FFtpPipelineDepth;
+  bool FFtpPrefetchPasv;
+  intptr_t FParallelDownloadSegmentSize;
+  bool FTlsSessionCache;
+  bool FWebDAVCompression;
+  intptr_t FWebDAVBufferSize;
   bool FScripting;
   intptr_t FSessionReopenAutoMaximumNumberOfRetries;
 
@@ -151,6 +164,19 @@ public:
   void SetExternalIpAddress(UnicodeString Value);
   void SetTryFtpWhenSshFails(bool Value);
   void SetParallelDurationThreshold(intptr_t Value);
+  void SetQueueWarmConnections(intptr_t Value);
+  void SetQueueIdleConnectionTimeout(intptr_t Value);
+  void SetResolverCacheLifetime(intptr_t Value);
+  void SetResolverPreferConnectedFamily(bool Value);
+  void SetFtpTransferBufferSize(intptr_t Value);
+  void SetFtpModeZ(intptr_t Value);
+  void SetFtpModeZLevel(intptr_t Value);
+  void SetFtpPipelineDepth(intptr_t Value);
+  void SetFtpPrefetchPasv(bool Value);
+  void SetParallelDownloadSegmentSize(intptr_t Value);
+  void SetTlsSessionCache(bool Value);
+  void SetWebDAVCompression(bool Value);
+  void SetWebDAVBufferSize(intptr_t Value);
   bool GetCollectUsage() const;
   void SetCollectUsage(bool Value);
   bool GetIsUnofficial() const;
@@ -317,6 +343,19 @@ public:
   __property UnicodeString ExternalIpAddress = { read = FExternalIpAddress, write = SetExternalIpAddress };
   __property bool TryFtpWhenSshFails = { read = FTryFtpWhenSshFails, write = SetTryFtpWhenSshFails };
   __property intptr_t ParallelDurationThreshold = { read = FParallelDurationThreshold, write = SetParallelDurationThreshold };
+  __property intptr_t QueueWarmConnections = { read = FQueueWarmConnections, write = SetQueueWarmConnections };
+  __property intptr_t QueueIdleConnectionTimeout = { read = FQueueIdleConnectionTimeout, write = SetQueueIdleConnectionTimeout };
+  __property intptr_t ResolverCacheLifetime = { read = FResolverCacheLifetime, write = SetResolverCacheLifetime };
+  __property bool ResolverPreferConnectedFamily = { read = FResolverPreferConnectedFamily, write = SetResolverPreferConnectedFamily };
+  __property intptr_t FtpTransferBufferSize = { read = FFtpTransferBufferSize, write = SetFtpTransferBufferSize };
+  __property intptr_t FtpModeZ = { read = FFtpModeZ, write = SetFtpModeZ };
+  __property intptr_t FtpModeZLevel = { read = FFtpModeZLevel, write = SetFtpModeZLevel };
+  __property intptr_t FtpPipelineDepth = { read = FFtpPipelineDepth, write = SetFtpPipelineDepth };
+  __property bool FtpPrefetchPasv = { read = FFtpPrefetchPasv, write = SetFtpPrefetchPasv };
+  __property intptr_t ParallelDownloadSegmentSize = { read = FParallelDownloadSegmentSize, write = SetParallelDownloadSegmentSize };
+  __property bool TlsSessionCache = { read = FTlsSessionCache, write = SetTlsSessionCache };
+  __property bool WebDAVCompression = { read = FWebDAVCompression, write = SetWebDAVCompression };
+  __property intptr_t WebDAVBufferSize = { read = FWebDAVBufferSize, write = SetWebDAVBufferSize };
 
   __property UnicodeString TimeFormat = { read = GetTimeFormat };
   __property TStorage Storage  = { read=GetStorage };
@@ -357,6 +396,19 @@ public:
   UnicodeString GetExternalIpAddress() const { return FExternalIpAddress; }
   bool GetTryFtpWhenSshFails() const { return FTryFtpWhenSshFails; }
   intptr_t GetParallelDurationThreshold() const { return FParallelDurationThreshold; }
+  intptr_t GetQueueWarmConnections() const { return FQueueWarmConnections; }
+  intptr_t GetQueueIdleConnectionTimeout() const { return FQueueIdleConnectionTimeout; }
+  intptr_t GetResolverCacheLifetime() const { return FResolverCacheLifetime; }
+  bool GetResolverPreferConnectedFamily() const { return FResolverPreferConnectedFamily; }
+  intptr_t GetFtpTransferBufferSize() const { return FFtpTransferBufferSize; }
+  intptr_t GetFtpModeZ() const { return FFtpModeZ; }
+  intptr_t GetFtpModeZLevel() const { return FFtpModeZLevel; }
+  intptr_t GetFtpPipelineDepth() const { return FFtpPipelineDepth; }
+  bool GetFtpPrefetchPasv() const { return FFtpPrefetchPasv; }
+  intptr_t GetParallelDownloadSegmentSize() const { return FParallelDownloadSegmentSize; }
+  bool GetTlsSessionCache() const { return FTlsSessionCache; }
+  bool GetWebDAVCompression() const { return FWebDAVCompression; }
+  intptr_t GetWebDAVBufferSize() const { return FWebDAVBufferSize; }
   bool GetDisablePasswordStoring() const { return FDisablePasswordStoring; }
   bool GetForceBanners() const { return FForceBanners; }
   bool GetDisableAcceptingHostKeys() const { return FDisableAcceptingHostKeys; }
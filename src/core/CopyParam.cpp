@@ -55,6 +55,8 @@ void TCopyParamType::Default()
   SetRemoveBOM(false);
   SetCPSLimit(0);
   SetNewerOnly(false);
+  SetPartOffset(0);
+  SetPartSize(-1);
 }
 
 UnicodeString TCopyParamType::GetInfoStr(
@@ -527,6 +529,8 @@ void TCopyParamType::Assign(const TCopyParamType *Source)
   COPY(RemoveBOM);
   COPY(CPSLimit);
   COPY(NewerOnly);
+  COPY(PartOffset);
+  COPY(PartSize);
 #undef COPY
 }
 
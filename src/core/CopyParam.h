@@ -92,6 +92,9 @@ private:
   bool FRemoveBOM;
   uintptr_t FCPSLimit;
   bool FNewerOnly;
+  // Segment of a file transferred in parallel, PartSize < 0 means the whole file
+  int64_t FPartOffset;
+  int64_t FPartSize;
 
 public:
   static const wchar_t TokenPrefix = L'%';
@@ -169,6 +172,8 @@ public:
   __property bool RemoveBOM = { read = FRemoveBOM, write = FRemoveBOM };
   __property unsigned long CPSLimit = { read = FCPSLimit, write = FCPSLimit };
   __property bool NewerOnly = { read = FNewerOnly, write = FNewerOnly };
+  __property int64_t PartOffset = { read = FPartOffset, write = FPartOffset };
+  __property int64_t PartSize = { read = FPartSize, write = FPartSize };
 #endif // #if 0
 
   const TFileMasks &GetAsciiFileMask() const { return FAsciiFileMask; }
@@ -220,6 +225,10 @@ public:
   void SetCPSLimit(uintptr_t Value) { FCPSLimit = Value; }
   bool GetNewerOnly() const { return FNewerOnly; }
   void SetNewerOnly(bool Value) { FNewerOnly = Value; }
+  int64_t GetPartOffset() const { return FPartOffset; }
+  void SetPartOffset(int64_t Value) { FPartOffset = Value; }
+  int64_t GetPartSize() const { return FPartSize; }
+  void SetPartSize(int64_t Value) { FPartSize = Value; }
 
 };
 
@@ -6,6 +6,7 @@
 
 #include "FileOperationProgress.h"
 #include "CoreMain.h"
+#include "BandwidthLimiter.h"
 
 #define TRANSFER_BUF_SIZE 32 * 1024
 
@@ -37,18 +38,30 @@ TFileOperationProgressType::~TFileOperationProgressType()
   DebugAssert(!GetSuspended() || FReset);
   SAFE_DESTROY_EX(TCriticalSection, FSection);
   SAFE_DESTROY_EX(TCriticalSection, FUserSelectionsSection);
+  SAFE_DESTROY_EX(TBandwidthReservation, FReservation);
+  SAFE_DESTROY_EX(TBandwidthLimiter, FLimiter);
 }
 
 void TFileOperationProgressType::Init()
 {
   FSection = new TCriticalSection();
   FUserSelectionsSection = new TCriticalSection();
+  // children of a parallel operation draw from the parent's limiter
+  FLimiter = (FParent == nullptr) ? new TBandwidthLimiter() : nullptr;
+  FReservation = new TBandwidthReservation(GetLimiter());
+}
+
+TBandwidthLimiter *TFileOperationProgressType::GetLimiter() const
+{
+  return (FParent != nullptr) ? FParent->GetLimiter() : FLimiter;
 }
 
 void TFileOperationProgressType::Assign(const TFileOperationProgressType &Other)
 {
   TValueRestorer<TCriticalSection *> SectionRestorer(FSection);
   TValueRestorer<TCriticalSection *> UserSelectionsSectionRestorer(FUserSelectionsSection);
+  TValueRestorer<TBandwidthLimiter *> LimiterRestorer(FLimiter);
+  TValueRestorer<TBandwidthReservation *> ReservationRestorer(FReservation);
   TGuard Guard(*FSection);
   TGuard OtherGuard(*Other.FSection);
 
@@ -87,8 +100,6 @@ void TFileOperationProgressType::Clear()
   FFileStartTime = 0.0;
   FFilesFinished = 0;
   FReset = false;
-  FLastSecond = 0;
-  FRemainingCPS = 0;
   FTicks.clear();
   FTotalTransferredThen.clear();
   FCounterSet = false;
@@ -134,7 +145,8 @@ void TFileOperationProgressType::ClearTransfer()
   FSkippedSize = 0;
   FTransferredSize = 0;
   FTransferringFile = false;
-  FLastSecond = 0;
+  // do not take part in dividing the limit while not transferring
+  FReservation->Release();
 }
 
 void TFileOperationProgressType::Start(TFileOperation AOperation,
@@ -158,6 +170,12 @@ void TFileOperationProgressType::Start(TFileOperation AOperation,
     FDirectory = ADirectory;
     FTemp = ATemp;
     FCPSLimit = ACPSLimit;
+    // the shared limiter of children follows the parent's limit only,
+    // which can be changed via SetCPSLimit of any of them
+    if (FParent == nullptr)
+    {
+      FLimiter->SetRate(FCPSLimit);
+    }
   }
 
   try
@@ -347,7 +365,7 @@ bool TFileOperationProgressType::IsLocallyDone() const
 
 void TFileOperationProgressType::SetSpeedCounters()
 {
-  if ((FCPSLimit > 0) && !FCounterSet)
+  if (!FCounterSet && (GetCPSLimit() > 0))
   {
     FCounterSet = true;
     // Configuration->Usage->Inc(L"SpeedLimitUses");
@@ -370,39 +388,20 @@ intptr_t TFileOperationProgressType::AdjustToCPSLimit(
 {
   SetSpeedCounters();
 
-  // CPSLimit reader is guarded, we cannot block whole method as it can last long.
-  if (FCPSLimit > 0)
+  // The limiter is shared with parallel transfers of the same operation
+  // and is refilled continuously, so we wait only until our share is available.
+  // The limit may also get dropped in DoProgress.
+  if (Size > 0)
   {
-    // we must not return 0, hence, if we reach zero,
-    // we wait until the next second
-    do
+    // we must not return 0, hence, if we reach zero, we wait
+    int64_t Available;
+    while ((Available = FReservation->Available(Size)) == 0)
     {
-      uintptr_t Second = (::GetTickCount() / MSecsPerSec);
-
-      if (Second != FLastSecond)
-      {
-        FRemainingCPS = FCPSLimit;
-        FLastSecond = Second;
-      }
-
-      if (FRemainingCPS == 0)
-      {
-        SleepEx(100, true);
-        DoProgress();
-      }
-    }
-    while ((FCPSLimit > 0) && (FRemainingCPS == 0));
-
-    // CPSLimit may have been dropped in DoProgress
-    if (FCPSLimit > 0)
-    {
-      if (FRemainingCPS < Size)
-      {
-        Size = FRemainingCPS;
-      }
-
-      FRemainingCPS -= Size;
+      SleepEx(FReservation->GetDelay(Size), true);
+      DoProgress();
     }
+    Size = static_cast<intptr_t>(Available);
+    FReservation->Consume(Size);
   }
   return Size;
 }
@@ -538,12 +537,15 @@ void TFileOperationProgressType::SetCPSLimit(intptr_t ACPSLimit)
 {
   if (FParent != nullptr)
   {
+    // the limit is shared by all transfers of the operation,
+    // as is the limiter (see GetLimiter)
     FParent->SetCPSLimit(ACPSLimit);
   }
   else
   {
     TGuard Guard(*FSection);
     FCPSLimit = ACPSLimit;
+    FLimiter->SetRate(FCPSLimit);
   }
 }
 
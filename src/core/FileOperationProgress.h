@@ -8,6 +8,8 @@
 #include "CopyParam.h"
 
 class TFileOperationProgressType;
+class TBandwidthLimiter;
+class TBandwidthReservation;
 
 enum TFileOperation
 {
@@ -100,8 +102,9 @@ private:
   TFileOperationProgressEvent FOnProgress;
   TFileOperationFinishedEvent FOnFinished;
   bool FReset;
-  uintptr_t FLastSecond;
-  intptr_t FRemainingCPS;
+  // Used by the top-level operation only, parallel transfers share it
+  TBandwidthLimiter *FLimiter;
+  TBandwidthReservation *FReservation;
   bool FCounterSet;
   rde::vector<intptr_t> FTicks;
   rde::vector<int64_t> FTotalTransferredThen;
@@ -125,6 +128,7 @@ protected:
   void RollbackTransferFromTotals(int64_t ATransferredSize, int64_t ASkippedSize);
   uintptr_t GetCPS() const;
   void Init();
+  TBandwidthLimiter *GetLimiter() const;
   static bool PassCancelToParent(TCancelStatus ACancel);
 
 public:
@@ -22,8 +22,8 @@ enum TFSCommand
   fsListFile, fsLookupUsersGroups, fsCopyToRemote, fsCopyToLocal, fsDeleteFile,
   fsRenameFile, fsCreateDirectory, fsChangeMode, fsChangeGroup, fsChangeOwner,
   fsHomeDirectory, fsUnset, fsUnalias, fsCreateLink, fsCopyFile,
-  fsAnyCommand, fsLang, fsReadSymlink, fsChangeProperties, fsMoveFile,
-  fsLock,
+  fsAnyCommand, fsLang, fsTarDetect, fsTarToRemote, fsTarToLocal,
+  fsReadSymlink, fsChangeProperties, fsMoveFile, fsLock,
 };
 
 const int dfNoRecursive = 0x01;
@@ -224,6 +224,10 @@ public:
   virtual void LockFile(UnicodeString AFileName, const TRemoteFile *AFile) = 0;
   virtual void UnlockFile(UnicodeString AFileName, const TRemoteFile *AFile) = 0;
   virtual void UpdateFromMain(TCustomFileSystem *MainFileSystem) = 0;
+  // Recursive operation over directory tree is starting/ending,
+  // the file system may read the whole tree at once (fsDirectoryTree)
+  virtual void BeginDirectoryTree() = 0;
+  virtual void EndDirectoryTree() = 0;
 
 #if 0
   __property UnicodeString CurrentDirectory = { read = GetCurrentDirectory };
@@ -172,26 +172,173 @@ struct message_t
 {
   CUSTOM_MEM_ALLOCATION_IMPL
 
-  message_t() : wparam(0),
+  message_t() : type(0),
+    wparam(0),
     lparam(0)
   {
   }
 
-  message_t(WPARAM w, LPARAM l) : wparam(w),
+  message_t(uintptr_t t, WPARAM w, LPARAM l) : type(t),
+    wparam(w),
     lparam(l)
   {
   }
 
+  uintptr_t type;
   WPARAM wparam;
   LPARAM lparam;
 };
 
-class TMessageQueue : public TObject, public rde::list<message_t>
+// Bounded multi-producer single-consumer queue of messages
+// posted by FileZilla thread.
+// Producers claim a cell by advancing the enqueue position,
+// the cell sequence number tells whether the cell is free
+// for the producer or ready for the consumer.
+// Only when the ring is full, messages go to a locked overflow list
+// (and keep going there until it is drained, to preserve the order).
+class TMessageQueue : public TObject
 {
+  NB_DISABLE_COPY(TMessageQueue)
 public:
   typedef message_t value_type;
+
+  explicit TMessageQueue(LONG Capacity);
+  virtual ~TMessageQueue();
+
+  void Push(const value_type &Message);
+  bool Pop(value_type &Message);
+  // The message to be popped next, if any
+  const value_type *Peek();
+
+private:
+  struct TCell
+  {
+    volatile LONG Sequence;
+    value_type Message;
+  };
+
+  TCell *FCells;
+  LONG FMask;
+  volatile LONG FEnqueuePos;
+  // accessed by the consumer only
+  LONG FDequeuePos;
+  TCriticalSection FOverflowSection;
+  rde::list<value_type> FOverflow;
+  volatile LONG FOverflowCount;
+
+  bool TryPush(const value_type &Message);
+  TCell *ReadyCell();
 };
 
+TMessageQueue::TMessageQueue(LONG Capacity) :
+  FCells(nullptr),
+  FMask(Capacity - 1),
+  FEnqueuePos(0),
+  FDequeuePos(0),
+  FOverflowCount(0)
+{
+  // power of two
+  DebugAssert((Capacity > 0) && ((Capacity & FMask) == 0));
+  FCells = new TCell[Capacity];
+  for (LONG Index = 0; Index < Capacity; ++Index)
+  {
+    FCells[Index].Sequence = Index;
+  }
+}
+
+TMessageQueue::~TMessageQueue()
+{
+  delete[] FCells;
+}
+
+bool TMessageQueue::TryPush(const value_type &Message)
+{
+  LONG Pos = FEnqueuePos;
+  for (;;)
+  {
+    TCell &Cell = FCells[Pos & FMask];
+    LONG Diff = static_cast<LONG>(static_cast<ULONG>(Cell.Sequence) - static_cast<ULONG>(Pos));
+    if (Diff == 0)
+    {
+      if (::InterlockedCompareExchange(&FEnqueuePos, Pos + 1, Pos) == Pos)
+      {
+        Cell.Message = Message;
+        // publish the message to the consumer
+        ::InterlockedExchange(&Cell.Sequence, Pos + 1);
+        return true;
+      }
+    }
+    else if (Diff < 0)
+    {
+      // full
+      return false;
+    }
+    Pos = FEnqueuePos;
+  }
+}
+
+void TMessageQueue::Push(const value_type &Message)
+{
+  if ((FOverflowCount > 0) || !TryPush(Message))
+  {
+    TGuard Guard(FOverflowSection);
+    FOverflow.push_back(Message);
+    ::InterlockedIncrement(&FOverflowCount);
+  }
+}
+
+TMessageQueue::TCell *TMessageQueue::ReadyCell()
+{
+  TCell *Cell = &FCells[FDequeuePos & FMask];
+  LONG Diff = static_cast<LONG>(static_cast<ULONG>(Cell->Sequence) - static_cast<ULONG>(FDequeuePos + 1));
+  return (Diff == 0) ? Cell : nullptr;
+}
+
+bool TMessageQueue::Pop(value_type &Message)
+{
+  TCell *Cell = ReadyCell();
+  bool Result = (Cell != nullptr);
+  if (Result)
+  {
+    Message = Cell->Message;
+    // release the cell to producers of the next round
+    ::InterlockedExchange(&Cell->Sequence, FDequeuePos + FMask + 1);
+    ++FDequeuePos;
+  }
+  else if (FOverflowCount > 0)
+  {
+    TGuard Guard(FOverflowSection);
+    Result = !FOverflow.empty();
+    if (Result)
+    {
+      Message = FOverflow.front();
+      FOverflow.pop_front();
+      ::InterlockedDecrement(&FOverflowCount);
+    }
+  }
+  return Result;
+}
+
+const TMessageQueue::value_type *TMessageQueue::Peek()
+{
+  const value_type *Result = nullptr;
+  TCell *Cell = ReadyCell();
+  if (Cell != nullptr)
+  {
+    Result = &Cell->Message;
+  }
+  else if (FOverflowCount > 0)
+  {
+    // the front of the list is not going away, only the consumer pops
+    TGuard Guard(FOverflowSection);
+    if (!FOverflow.empty())
+    {
+      Result = &FOverflow.front();
+    }
+  }
+  return Result;
+}
+
 #if 0
 // moved to FileSystems.h
 struct TFileTransferData
@@ -267,8 +414,9 @@ private:
 TFTPFileSystem::TFTPFileSystem(TTerminal *ATerminal) :
   TCustomFileSystem(OBJECT_CLASS_TFTPFileSystem, ATerminal),
   FFileZillaIntf(nullptr),
-  FQueue(new TMessageQueue),
+  FQueue(new TMessageQueue(1024)),
   FQueueEvent(::CreateEvent(nullptr, true, false, nullptr)),
+  FQueueSignalled(0),
   FFileSystemInfoValid(false),
   FReply(0),
   FCommandReply(0),
@@ -313,13 +461,14 @@ TFTPFileSystem::TFTPFileSystem(TTerminal *ATerminal) :
   FBytesAvailableSupported(false),
   FMVS(false),
   FVMS(false),
-  FFileTransferAny(false)
+  FFileTransferAny(false),
+  FPipelineCodes(nullptr),
+  FPipeliningUnsupported(false)
 {
 }
 
 void TFTPFileSystem::Init(void *)
 {
-  //FQueue.reserve(1000);
   ResetReply();
 
   FListAll = FTerminal->GetSessionData()->GetFtpListAll();
@@ -1119,8 +1268,18 @@ void TFTPFileSystem::ChangeFileProperties(UnicodeString AFileName,
       {
         try
         {
-          FTerminal->ProcessDirectory(AFileName, nb::bind(&TTerminal::ChangeFileProperties, FTerminal),
-            ToPtr(const_cast<TRemoteProperties *>(Properties)));
+          if (GetPipelineDepth() > 0)
+          {
+            TPipelineBatch Batch;
+            Batch.Properties = Properties;
+            FTerminal->ProcessDirectory(AFileName, nb::bind(&TFTPFileSystem::PipelineChangeFileProperties, this), &Batch);
+            FlushPipelinedChmods(Batch);
+          }
+          else
+          {
+            FTerminal->ProcessDirectory(AFileName, nb::bind(&TTerminal::ChangeFileProperties, FTerminal),
+              ToPtr(const_cast<TRemoteProperties *>(Properties)));
+          }
         }
         catch (...)
         {
@@ -1650,7 +1809,8 @@ void TFTPFileSystem::FileTransfer(UnicodeString AFileName,
   [&]()
   {
     FFileZillaIntf->FileTransfer(ApiPath(LocalFile).c_str(), RemoteFile.c_str(),
-      RemotePath.c_str(), Get, Size, ToInt(Type), &UserData);
+      RemotePath.c_str(), Get, Size, ToInt(Type), &UserData,
+      UserData.CopyParam->GetPartOffset(), UserData.CopyParam->GetPartSize());
     // we may actually catch response code of the listing
     // command (when checking for existence of the remote file)
     uintptr_t Reply = WaitForCommandReply();
@@ -1864,7 +2024,13 @@ void TFTPFileSystem::Sink(UnicodeString AFileName,
       L" transfer mode selected.");
 
     // Suppose same data size to transfer as to write
-    OperationProgress->SetTransferSize(AFile->GetSize());
+    bool Part = (CopyParam->GetPartSize() >= 0);
+    if (Part)
+    {
+      FTerminal->LogEvent(FORMAT("Downloading segment at offset %s of %s bytes.",
+        ::Int64ToStr(CopyParam->GetPartOffset()), ::Int64ToStr(CopyParam->GetPartSize())));
+    }
+    OperationProgress->SetTransferSize(Part ? CopyParam->GetPartSize() : AFile->GetSize());
     OperationProgress->SetLocalSize(OperationProgress->GetTransferSize());
 
     DWORD LocalFileAttrs = INVALID_FILE_ATTRIBUTES;
@@ -1918,7 +2084,8 @@ void TFTPFileSystem::Sink(UnicodeString AFileName,
       LocalFileAttrs = faArchive;
     }
     DWORD NewAttrs = CopyParam->LocalFileAttrs(*AFile->GetRights());
-    if ((NewAttrs & LocalFileAttrs) != NewAttrs)
+    // For segments, attributes are set by TParallelOperation once the whole file is downloaded
+    if (!Part && ((NewAttrs & LocalFileAttrs) != NewAttrs))
     {
       FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(CANT_SET_ATTRS, DestFullName), "",
       [&]()
@@ -2433,12 +2600,27 @@ void TFTPFileSystem::RemoteDeleteFile(UnicodeString AFileName,
   UnicodeString FilePath = base::UnixExtractFilePath(FileName);
 
   bool Dir = (AFile != nullptr) && AFile->GetIsDirectory() && FTerminal->CanRecurseToDirectory(AFile);
+  bool DeleteFromCwd =
+    (FTerminal->GetSessionData()->GetFtpDeleteFromCwd() == asOn) ||
+    ((FTerminal->GetSessionData()->GetFtpDeleteFromCwd() == asAuto) && FVMS);
 
   if (Dir && FLAGCLEAR(Params, dfNoRecursive))
   {
     try
     {
-      FTerminal->ProcessDirectory(FileName, nb::bind(&TTerminal::RemoteDeleteFile, FTerminal), &Params);
+      // Files are deleted using absolute paths, so that DELE commands
+      // of the whole directory can be sent at once
+      if ((GetPipelineDepth() > 0) && !DeleteFromCwd)
+      {
+        TPipelineBatch Batch;
+        Batch.Params = Params;
+        FTerminal->ProcessDirectory(FileName, nb::bind(&TFTPFileSystem::PipelineDeleteFile, this), &Batch);
+        FlushPipelinedDeletes(Batch);
+      }
+      else
+      {
+        FTerminal->ProcessDirectory(FileName, nb::bind(&TTerminal::RemoteDeleteFile, FTerminal), &Params);
+      }
     }
     catch (...)
     {
@@ -2468,8 +2650,7 @@ void TFTPFileSystem::RemoteDeleteFile(UnicodeString AFileName,
     }
     else
     {
-      if ((FTerminal->GetSessionData()->GetFtpDeleteFromCwd() == asOn) ||
-        ((FTerminal->GetSessionData()->GetFtpDeleteFromCwd() == asAuto) && FVMS))
+      if (DeleteFromCwd)
       {
         EnsureLocation(FilePath, false);
         FFileZillaIntf->Delete(FileNameOnly.c_str(), L"", true);
@@ -2548,6 +2729,7 @@ bool TFTPFileSystem::IsCapable(intptr_t Capability) const
   case fcMoveToQueue:
   case fsSkipTransfer:
   case fsParallelTransfers:
+  case fsParallelFileTransfers:
     return true;
 
   case fcPreservingTimestampUpload:
@@ -2582,6 +2764,7 @@ bool TFTPFileSystem::IsCapable(intptr_t Capability) const
   case fcPreservingTimestampDirs:
   case fcResumeSupport:
   case fcChangePassword:
+  case fsDirectoryTree:
     return false;
 
   default:
@@ -3460,6 +3643,22 @@ intptr_t TFTPFileSystem::GetOptionVal(intptr_t OptionID) const
     Result = FFileTransferNoList ? TRUE : FALSE;
     break;
 
+  case OPTION_MPEXT_TRANSFERBUFFERSIZE:
+    Result = FTerminal->GetConfiguration()->GetFtpTransferBufferSize();
+    break;
+
+  case OPTION_MPEXT_PREFETCHPASV:
+    Result = FTerminal->GetConfiguration()->GetFtpPrefetchPasv() ? TRUE : FALSE;
+    break;
+
+  case OPTION_MODEZ_USE:
+    Result = FTerminal->GetConfiguration()->GetFtpModeZ();
+    break;
+
+  case OPTION_MODEZ_LEVEL:
+    Result = FTerminal->GetConfiguration()->GetFtpModeZLevel();
+    break;
+
   default:
     DebugFail();
     Result = FALSE;
@@ -3480,38 +3679,47 @@ bool TFTPFileSystem::FTPPostMessage(uintptr_t Type, WPARAM wParam, LPARAM lParam
     TGuard Guard(FTransferStatusCriticalSection);
   }
 
-  TGuard Guard(FQueueCriticalSection);
-
-  FQueue->push_back(TMessageQueue::value_type(wParam, lParam));
-  ::SetEvent(FQueueEvent);
+  FQueue->Push(TMessageQueue::value_type(Type, wParam, lParam));
+  // Signal only when the consumer may be about to wait,
+  // not for every message
+  if (::InterlockedExchange(&FQueueSignalled, 1) == 0)
+  {
+    ::SetEvent(FQueueEvent);
+  }
 
   return true;
 }
 
 bool TFTPFileSystem::ProcessMessage()
 {
-  bool Result;
   TMessageQueue::value_type Message;
-
+  bool Result = FQueue->Pop(Message);
+  if (!Result)
   {
-    TGuard Guard(FQueueCriticalSection);
-
-    Result = !FQueue->empty();
-    if (Result)
-    {
-      Message = FQueue->front();
-      FQueue->erase(FQueue->begin());
-    }
-    else
-    {
-      // now we are perfectly sure that the queue is empty as it is locked,
-      // so reset the event
-      ::ResetEvent(FQueueEvent);
-    }
+    // Reset the event before clearing the flag and checking the queue
+    // once more: a message posted before the flag is cleared is found
+    // by the check, one posted after it signals the event again
+    ::ResetEvent(FQueueEvent);
+    ::InterlockedExchange(&FQueueSignalled, 0);
+    Result = FQueue->Pop(Message);
   }
 
   if (Result)
   {
+    // Transfer status carries absolute figures, so of consecutive
+    // status messages of the same transfer only the last one matters
+    while ((Message.type == TFileZillaIntf::MSG_TRANSFERSTATUS) && (Message.lparam != 0))
+    {
+      const TMessageQueue::value_type *Next = FQueue->Peek();
+      if ((Next == nullptr) ||
+          (Next->type != TFileZillaIntf::MSG_TRANSFERSTATUS) ||
+          !FFileZillaIntf->IsSupersededMessage(Message.wparam, Message.lparam, Next->wparam, Next->lparam))
+      {
+        break;
+      }
+      FFileZillaIntf->DiscardMessage(Message.wparam, Message.lparam);
+      FQueue->Pop(Message);
+    }
     FFileZillaIntf->HandleMessage(Message.wparam, Message.lparam);
   }
 
@@ -3916,6 +4124,195 @@ void TFTPFileSystem::SendCommand(UnicodeString Command)
   FLastCommandSent = CopyToChar(Command, L' ', false);
 }
 
+struct TFTPFileSystem::TPipelineBatch
+{
+  TPipelineBatch() : Params(0), Properties(nullptr) {}
+
+  intptr_t Params;
+  const TRemoteProperties *Properties;
+  TUnicodeStringVector FileNames;
+  TUnicodeStringVector Commands;
+  rde::vector<TRights> Rights;
+};
+
+intptr_t TFTPFileSystem::GetPipelineDepth() const
+{
+  intptr_t Result = FTerminal->GetConfiguration()->GetFtpPipelineDepth();
+  if ((Result <= 1) || FPipeliningUnsupported)
+  {
+    Result = 0;
+  }
+  return Result;
+}
+
+void TFTPFileSystem::PipelineCommands(const TUnicodeStringVector &Commands,
+  rde::vector<intptr_t> &Codes)
+{
+  UnicodeString Text;
+  for (size_t Index = 0; Index < Commands.size(); ++Index)
+  {
+    if (!Text.IsEmpty())
+    {
+      Text += L"\n";
+    }
+    Text += Commands[Index];
+  }
+
+  // The codes are collected in HandleReplyStatus,
+  // final replies come in the order the commands were sent
+  Codes.clear();
+  FPipelineCodes = &Codes;
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      FPipelineCodes = nullptr;
+    };
+    try
+    {
+      FFileZillaIntf->PipelineCommands(Text.c_str());
+      GotReply(WaitForCommandReply());
+    }
+    catch (Exception &E)
+    {
+      // Some servers (and firewalls) discard commands following
+      // the first one in a packet or close the connection.
+      TFileOperationProgressType *OperationProgress = FTerminal->GetOperationProgress();
+      if ((Codes.size() >= Commands.size()) ||
+          ((OperationProgress != nullptr) && (OperationProgress->GetCancel() != csContinue)))
+      {
+        throw;
+      }
+      FTerminal->LogEvent(L"Server does not seem to support command pipelining, disabling it.");
+      FPipeliningUnsupported = true;
+      // The callers issue the unanswered commands one by one,
+      // over a new connection, if the server closed this one
+      if (!FTerminal->GetActive() &&
+          !FTerminal->QueryReopen(&E, ropNoReadDirectory, OperationProgress))
+      {
+        throw;
+      }
+    }
+  }
+  __finally
+  {
+#if 0
+    FPipelineCodes = nullptr;
+#endif // #if 0
+  };
+}
+
+void TFTPFileSystem::PipelineDeleteFile(UnicodeString AFileName,
+  const TRemoteFile *AFile, void *Param)
+{
+  TPipelineBatch *Batch = static_cast<TPipelineBatch *>(Param);
+  if ((AFile != nullptr) && AFile->GetIsDirectory())
+  {
+    FTerminal->RemoteDeleteFile(AFileName, AFile, &Batch->Params);
+  }
+  else
+  {
+    // What TTerminal::RemoteDeleteFile does, only the DELE is deferred
+    FTerminal->StartOperationWithFile(AFileName, foDelete);
+    FTerminal->LogEvent(FORMAT("Deleting file \"%s\".", AFileName));
+    FTerminal->FileModified(AFile, AFileName, true);
+    UnicodeString FileName = GetAbsolutePath(AFileName, false);
+    Batch->FileNames.push_back(FileName);
+    Batch->Commands.push_back(FORMAT("DELE %s", FileName));
+    if (static_cast<intptr_t>(Batch->Commands.size()) >= GetPipelineDepth())
+    {
+      FlushPipelinedDeletes(*Batch);
+    }
+  }
+}
+
+void TFTPFileSystem::FlushPipelinedDeletes(TPipelineBatch &Batch)
+{
+  if (!Batch.Commands.empty())
+  {
+    rde::vector<intptr_t> Codes;
+    PipelineCommands(Batch.Commands, Codes);
+
+    for (size_t Index = 0; Index < Batch.FileNames.size(); ++Index)
+    {
+      UnicodeString FileName = Batch.FileNames[Index];
+      if ((Index < Codes.size()) && ((Codes[Index] / 100) == 2))
+      {
+        TRmSessionAction Action(FTerminal->GetActionLog(), FileName);
+      }
+      else
+      {
+        // Retry individually to get the error reported the usual way
+        FTerminal->DoDeleteFile(FileName, nullptr, Batch.Params);
+      }
+    }
+    FTerminal->ReactOnCommand(fsDeleteFile);
+
+    Batch.FileNames.clear();
+    Batch.Commands.clear();
+  }
+}
+
+void TFTPFileSystem::PipelineChangeFileProperties(UnicodeString AFileName,
+  const TRemoteFile *AFile, void *Param)
+{
+  TPipelineBatch *Batch = static_cast<TPipelineBatch *>(Param);
+  const TRemoteProperties *Properties = Batch->Properties;
+  if ((AFile == nullptr) || AFile->GetIsDirectory())
+  {
+    FTerminal->ChangeFileProperties(AFileName, AFile, const_cast<TRemoteProperties *>(Properties));
+  }
+  else
+  {
+    FTerminal->StartOperationWithFile(AFileName, foSetProperties);
+    FTerminal->LogEvent(FORMAT("Changing properties of \"%s\" (%s)",
+      AFileName, BooleanToEngStr(Properties->Recursive)));
+    FTerminal->LogEvent(FORMAT(" - mode: \"%s\"", Properties->Rights.GetModeStr()));
+    FTerminal->FileModified(AFile, AFileName);
+
+    TRights Rights = *AFile->GetRights();
+    Rights |= Properties->Rights.GetNumberSet();
+    Rights &= static_cast<uint16_t>(~Properties->Rights.GetNumberUnset());
+
+    UnicodeString FileName = GetAbsolutePath(AFileName, false);
+    Batch->FileNames.push_back(FileName);
+    Batch->Rights.push_back(Rights);
+    // the same format FZAPI uses, octal number represented as decadic
+    Batch->Commands.push_back(FORMAT("SITE CHMOD %03d %s", Rights.GetNumberDecadic(), FileName));
+    if (static_cast<intptr_t>(Batch->Commands.size()) >= GetPipelineDepth())
+    {
+      FlushPipelinedChmods(*Batch);
+    }
+  }
+}
+
+void TFTPFileSystem::FlushPipelinedChmods(TPipelineBatch &Batch)
+{
+  if (!Batch.Commands.empty())
+  {
+    rde::vector<intptr_t> Codes;
+    PipelineCommands(Batch.Commands, Codes);
+
+    for (size_t Index = 0; Index < Batch.FileNames.size(); ++Index)
+    {
+      UnicodeString FileName = Batch.FileNames[Index];
+      if ((Index < Codes.size()) && ((Codes[Index] / 100) == 2))
+      {
+        TChmodSessionAction Action(FTerminal->GetActionLog(), FileName, Batch.Rights[Index]);
+      }
+      else
+      {
+        FTerminal->DoChangeFileProperties(FileName, nullptr, Batch.Properties);
+      }
+    }
+    FTerminal->ReactOnCommand(fsChangeProperties);
+
+    Batch.FileNames.clear();
+    Batch.Commands.clear();
+    Batch.Rights.clear();
+  }
+}
+
 void TFTPFileSystem::SetLastCode(intptr_t Code)
 {
   FLastCode = Code;
@@ -4035,6 +4432,12 @@ void TFTPFileSystem::HandleReplyStatus(UnicodeString Response)
 
   if (!FMultineResponse)
   {
+    // collect final replies to pipelined commands, see PipelineCommands
+    if ((FPipelineCodes != nullptr) && (FLastCodeClass >= 2))
+    {
+      FPipelineCodes->push_back(FLastCode);
+    }
+
     if (FLastCode == 220)
     {
       // HOST command also uses 220 response.
@@ -5323,6 +5726,16 @@ void TFTPFileSystem::UnlockFile(UnicodeString /*FileName*/, const TRemoteFile *
   DebugFail();
 }
 
+void TFTPFileSystem::BeginDirectoryTree()
+{
+  DebugFail();
+}
+
+void TFTPFileSystem::EndDirectoryTree()
+{
+  DebugFail();
+}
+
 void TFTPFileSystem::UpdateFromMain(TCustomFileSystem * /*MainFileSystem*/)
 {
   // noop
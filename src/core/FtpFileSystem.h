@@ -5,6 +5,7 @@
 
 #include <time.h>
 #include <rdestl/map.h>
+#include <rdestl/vector.h>
 #include <FileSystems.h>
 
 class TFileZillaIntf;
@@ -90,6 +91,8 @@ public:
   virtual void LockFile(UnicodeString AFileName, const TRemoteFile *AFile) override;
   virtual void UnlockFile(UnicodeString AFileName, const TRemoteFile *AFile) override;
   virtual void UpdateFromMain(TCustomFileSystem *MainFileSystem) override;
+  virtual void BeginDirectoryTree() override;
+  virtual void EndDirectoryTree() override;
 
 protected:
 #if 0
@@ -228,6 +231,13 @@ protected:
   bool SupportsCommand(UnicodeString Command) const;
   void RegisterChecksumAlgCommand(UnicodeString Alg, UnicodeString Command);
   void SendCommand(UnicodeString Command);
+  struct TPipelineBatch;
+  intptr_t GetPipelineDepth() const;
+  void PipelineCommands(const TUnicodeStringVector &Commands, rde::vector<intptr_t> &Codes);
+  void PipelineDeleteFile(UnicodeString AFileName, const TRemoteFile *AFile, void *Param);
+  void PipelineChangeFileProperties(UnicodeString AFileName, const TRemoteFile *AFile, void *Param);
+  void FlushPipelinedDeletes(TPipelineBatch &Batch);
+  void FlushPipelinedChmods(TPipelineBatch &Batch);
   bool CanTransferSkipList(intptr_t Params, uintptr_t Flags, const TCopyParamType *CopyParam) const;
 
   static bool Unquote(UnicodeString &Str);
@@ -242,10 +252,10 @@ private:
   };
 
   mutable TFileZillaIntf *FFileZillaIntf;
-  TCriticalSection FQueueCriticalSection;
   TCriticalSection FTransferStatusCriticalSection;
   TMessageQueue *FQueue;
   HANDLE FQueueEvent;
+  volatile LONG FQueueSignalled;
   TSessionInfo FSessionInfo;
   TFileSystemInfo FFileSystemInfo;
   bool FFileSystemInfoValid;
@@ -316,6 +326,8 @@ private:
   bool FVMS;
   bool FFileTransferAny;
   mutable UnicodeString FOptionScratch;
+  rde::vector<intptr_t> *FPipelineCodes;
+  bool FPipeliningUnsupported;
 };
 
 UnicodeString GetOpenSSLVersionText();
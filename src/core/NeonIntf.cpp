@@ -12,6 +12,7 @@
 #include "WinSCPSecurity.h"
 #include <TextsCore.h>
 #include <StrUtils.hpp>
+#include <rdestl/vector.h>
 
 #define SESSION_PROXY_AUTH_KEY "proxyauth"
 #define SESSION_TLS_INIT_KEY "tlsinit"
@@ -305,3 +306,221 @@ UnicodeString NeonCertificateFailuresErrorStr(int Failures, UnicodeString HostNa
   }
   return Result;
 }
+
+// Most servers close idle connections after few seconds anyway,
+// neon retries the first request on a new connection then
+#define POOLED_CONNECTION_TIMEOUT 30000
+#define MAX_POOLED_CONNECTIONS 16
+
+class TNeonConnectionPool
+{
+  NB_DISABLE_COPY(TNeonConnectionPool)
+public:
+  TNeonConnectionPool() {}
+
+  void AddOwner(const void *Owner);
+  void RemoveOwner(const void *Owner);
+  void Put(ne_session *Session, const void *Owner);
+  bool Take(ne_session *Session, const void *Owner);
+
+private:
+  struct TEntry
+  {
+    CUSTOM_MEM_ALLOCATION_IMPL
+    const void *Owner;
+    UnicodeString Origin;
+    // Bare session without any hooks, holding the connection
+    ne_session *Holder;
+    DWORD Time;
+  };
+  typedef rde::vector<TEntry> TEntries;
+  typedef rde::vector<const void *> TOwners;
+  typedef rde::vector<ne_session *> THolders;
+
+  TCriticalSection FSection;
+  TEntries FEntries;
+  TOwners FOwners;
+
+  static UnicodeString GetOrigin(const ne_uri &uri);
+  static void Destroy(const THolders &Holders);
+  intptr_t FindOwner(const void *Owner) const;
+  void Expire(THolders &Expired);
+};
+
+UnicodeString TNeonConnectionPool::GetOrigin(const ne_uri &uri)
+{
+  return FORMAT("%s://%s:%d", StrFromNeon(uri.scheme), StrFromNeon(uri.host), static_cast<int>(uri.port));
+}
+
+void TNeonConnectionPool::Destroy(const THolders &Holders)
+{
+  // Outside of the lock, closing the connection may take a while
+  for (THolders::const_iterator I = Holders.begin(); I != Holders.end(); ++I)
+  {
+    ne_session_destroy(*I);
+  }
+}
+
+intptr_t TNeonConnectionPool::FindOwner(const void *Owner) const
+{
+  intptr_t Result = -1;
+  for (intptr_t Index = 0; (Result < 0) && (Index < static_cast<intptr_t>(FOwners.size())); Index++)
+  {
+    if (FOwners[Index] == Owner)
+    {
+      Result = Index;
+    }
+  }
+  return Result;
+}
+
+void TNeonConnectionPool::Expire(THolders &Expired)
+{
+  DWORD Now = ::GetTickCount();
+  TEntries::iterator I = FEntries.begin();
+  while (I != FEntries.end())
+  {
+    if (Now - I->Time >= POOLED_CONNECTION_TIMEOUT)
+    {
+      Expired.push_back(I->Holder);
+      I = FEntries.erase(I);
+    }
+    else
+    {
+      ++I;
+    }
+  }
+}
+
+void TNeonConnectionPool::AddOwner(const void *Owner)
+{
+  TGuard Guard(FSection);
+  if (FindOwner(Owner) < 0)
+  {
+    FOwners.push_back(Owner);
+  }
+}
+
+void TNeonConnectionPool::RemoveOwner(const void *Owner)
+{
+  THolders Dropped;
+  {
+    TGuard Guard(FSection);
+    intptr_t Index = FindOwner(Owner);
+    if (Index >= 0)
+    {
+      FOwners.erase(FOwners.begin() + Index);
+    }
+    TEntries::iterator I = FEntries.begin();
+    while (I != FEntries.end())
+    {
+      if (I->Owner == Owner)
+      {
+        Dropped.push_back(I->Holder);
+        I = FEntries.erase(I);
+      }
+      else
+      {
+        ++I;
+      }
+    }
+  }
+  Destroy(Dropped);
+}
+
+void TNeonConnectionPool::Put(ne_session *Session, const void *Owner)
+{
+  ne_uri uri = {nullptr};
+  ne_fill_server_uri(Session, &uri);
+  UnicodeString Origin = GetOrigin(uri);
+  ne_session *Holder = ne_session_create(uri.scheme, uri.host, uri.port);
+  ne_uri_free(&uri);
+
+  THolders Dropped;
+  // Fails for closed connections and connections over proxy
+  if (ne_session_move_connection(Holder, Session) != 0)
+  {
+    Dropped.push_back(Holder);
+  }
+  else
+  {
+    TGuard Guard(FSection);
+    Expire(Dropped);
+    if (FindOwner(Owner) < 0)
+    {
+      // The main session has closed meanwhile
+      Dropped.push_back(Holder);
+    }
+    else
+    {
+      if (FEntries.size() >= MAX_POOLED_CONNECTIONS)
+      {
+        Dropped.push_back(FEntries.front().Holder);
+        FEntries.erase(FEntries.begin());
+      }
+      TEntry Entry;
+      Entry.Owner = Owner;
+      Entry.Origin = Origin;
+      Entry.Holder = Holder;
+      Entry.Time = ::GetTickCount();
+      FEntries.push_back(Entry);
+    }
+  }
+  Destroy(Dropped);
+}
+
+bool TNeonConnectionPool::Take(ne_session *Session, const void *Owner)
+{
+  ne_uri uri = {nullptr};
+  ne_fill_server_uri(Session, &uri);
+  UnicodeString Origin = GetOrigin(uri);
+  ne_uri_free(&uri);
+
+  ne_session *Holder = nullptr;
+  THolders Dropped;
+  {
+    TGuard Guard(FSection);
+    Expire(Dropped);
+    // The most recently used connection is the least likely to be closed by the server
+    for (intptr_t Index = static_cast<intptr_t>(FEntries.size()) - 1; (Holder == nullptr) && (Index >= 0); Index--)
+    {
+      const TEntry &Entry = FEntries[Index];
+      if ((Entry.Owner == Owner) && (Entry.Origin == Origin))
+      {
+        Holder = Entry.Holder;
+        FEntries.erase(FEntries.begin() + Index);
+      }
+    }
+  }
+  Destroy(Dropped);
+
+  bool Result = false;
+  if (Holder != nullptr)
+  {
+    Result = (ne_session_move_connection(Session, Holder) == 0);
+    ne_session_destroy(Holder);
+  }
+  return Result;
+}
+
+static TNeonConnectionPool NeonConnectionPool;
+
+void NeonAddConnectionPoolOwner(const void *Owner)
+{
+  NeonConnectionPool.AddOwner(Owner);
+}
+
+void NeonRemoveConnectionPoolOwner(const void *Owner)
+{
+  NeonConnectionPool.RemoveOwner(Owner);
+}
+
+void NeonPoolConnection(ne_session *Session, const void *Owner)
+{
+  NeonConnectionPool.Put(Session, Owner);
+}
+
+bool NeonTakePooledConnection(ne_session *Session, const void *Owner)
+{
+  return NeonConnectionPool.Take(Session, Owner);
+}
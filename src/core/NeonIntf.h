@@ -24,4 +24,12 @@ void SetNeonTlsInit(ne_session *Session, TNeonTlsInit OnNeonTlsInit);
 AnsiString NeonExportCertificate(const ne_ssl_certificate *Certificate);
 bool NeonWindowsValidateCertificate(int &Failures, AnsiString AsciiCert, UnicodeString &Error);
 UnicodeString NeonCertificateFailuresErrorStr(int Failures, UnicodeString HostName);
+// Idle keep-alive connections of closed sessions, which other sessions
+// of the same Owner (secondary sessions of one main session) take over,
+// skipping TCP and TLS handshake and connection-based (NTLM) authentication.
+// Connections are pooled only while the Owner is registered.
+void NeonAddConnectionPoolOwner(const void *Owner);
+void NeonRemoveConnectionPoolOwner(const void *Owner);
+void NeonPoolConnection(ne_session *Session, const void *Owner);
+bool NeonTakePooledConnection(ne_session *Session, const void *Owner);
 
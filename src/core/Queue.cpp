@@ -277,6 +277,7 @@ class TTerminalItem : public TSignalThread
 {
   friend class TQueueItem;
   friend class TBackgroundTerminal;
+  friend class TTerminalQueue;
   NB_DISABLE_COPY(TTerminalItem)
 public:
   static inline bool classof(const TObject *Obj) { return Obj->is(OBJECT_CLASS_TTerminalItem); }
@@ -290,6 +291,7 @@ public:
   bool ProcessUserAction(void *Arg);
   void Cancel();
   void Idle();
+  void WarmUp();
   bool Pause();
   bool Resume();
 
@@ -301,8 +303,11 @@ protected:
   TUserAction *FUserAction;
   bool FCancel;
   bool FPause;
+  bool FWarmUp;
+  TDateTime FLastUsed;
 
   virtual void ProcessEvent() override;
+  void DoWarmUp();
   virtual void Finished() override;
   bool WaitForUserAction(TQueueItem::TStatus ItemStatus, TUserAction *UserAction);
   bool OverrideItemStatus(TQueueItem::TStatus &ItemStatus) const;
@@ -506,7 +511,9 @@ TTerminalQueue::TTerminalQueue(TTerminal *ATerminal,
   FOverallTerminals(0),
   FTransfersLimit(2),
   FKeepDoneItemsFor(0),
-  FEnabled(true)
+  FEnabled(true),
+  FWarmUpPending(false),
+  FWarmUpFailed(false)
 {
 }
 
@@ -605,6 +612,10 @@ void TTerminalQueue::TerminalFinished(TTerminalItem *TerminalItem)
       SAFE_DESTROY(TerminalItem);
     }
 
+    // refill the pool, when a warm connection was closed
+    // for being idle or was lost
+    WarmUp();
+
     TriggerEvent();
   }
 }
@@ -656,9 +667,113 @@ void TTerminalQueue::AddItem(TQueueItem *Item)
 
   DoListUpdate();
 
+  // the item will take the first connection,
+  // let the others connect meanwhile
+  WarmUp();
+
   TriggerEvent();
 }
 
+void TTerminalQueue::WarmUp()
+{
+  if (FConfiguration->GetQueueWarmConnections() > 0)
+  {
+    bool Trigger = false;
+    {
+      TGuard Guard(FItemsSection);
+
+      if (!FWarmUpFailed)
+      {
+        FWarmUpPending = true;
+        Trigger = true;
+      }
+    }
+
+    if (Trigger)
+    {
+      TriggerEvent();
+    }
+  }
+}
+
+void TTerminalQueue::TerminalConnected(bool Connected)
+{
+  bool Retry;
+  {
+    TGuard Guard(FItemsSection);
+
+    // once a connection succeeds (possibly after the user was prompted
+    // for credentials), give the warm-up another chance
+    Retry = Connected && FWarmUpFailed;
+    FWarmUpFailed = !Connected;
+  }
+
+  if (Retry)
+  {
+    WarmUp();
+  }
+}
+
+void TTerminalQueue::WarmUpTerminals()
+{
+  intptr_t WarmConnections = FConfiguration->GetQueueWarmConnections();
+  if ((FTransfersLimit > 0) && (WarmConnections > FTransfersLimit))
+  {
+    WarmConnections = FTransfersLimit;
+  }
+
+  TTerminalItem *TerminalItem;
+  do
+  {
+    TerminalItem = nullptr;
+
+    {
+      TGuard Guard(FItemsSection);
+
+      if (FEnabled && !FWarmUpFailed &&
+          (FTerminals->GetCount() < WarmConnections))
+      {
+        FOverallTerminals++;
+        TerminalItem = new TTerminalItem(this);
+        TerminalItem->InitTerminalItem(FOverallTerminals);
+        FTerminals->Add(TerminalItem);
+      }
+    }
+
+    if (TerminalItem != nullptr)
+    {
+      // the terminal threads connect in parallel,
+      // each becomes free once authenticated
+      TerminalItem->WarmUp();
+    }
+  }
+  while (!FTerminated && (TerminalItem != nullptr));
+}
+
+void TTerminalQueue::CloseIdleTerminals()
+{
+  intptr_t Timeout = FConfiguration->GetQueueIdleConnectionTimeout();
+  if (Timeout > 0)
+  {
+    TDateTime CloseUsedBefore = ::IncSecond(Now(), -Timeout);
+
+    TGuard Guard(FItemsSection);
+
+    for (intptr_t Index = FFreeTerminals - 1; Index >= 0; Index--)
+    {
+      TTerminalItem *TerminalItem = FTerminals->GetAs<TTerminalItem>(Index);
+      if (TerminalItem->FLastUsed <= CloseUsedBefore)
+      {
+        // take it out of free terminals,
+        // it gets removed by TerminalFinished() once its thread exits
+        FTerminals->Move(Index, FTerminals->GetCount() - 1);
+        FFreeTerminals--;
+        TerminalItem->Terminate();
+      }
+    }
+  }
+}
+
 void TTerminalQueue::RetryItem(TQueueItem *Item)
 {
   if (!FTerminated)
@@ -1087,6 +1202,21 @@ bool TTerminalQueue::WaitForEvent()
 
 void TTerminalQueue::ProcessEvent()
 {
+  CloseIdleTerminals();
+
+  bool WarmUpPending;
+  {
+    TGuard Guard(FItemsSection);
+
+    WarmUpPending = FWarmUpPending;
+    FWarmUpPending = false;
+  }
+
+  if (WarmUpPending)
+  {
+    WarmUpTerminals();
+  }
+
   TTerminalItem *TerminalItem;
   do
   {
@@ -1243,11 +1373,17 @@ bool TTerminalQueue::TryAddParallelOperation(TQueueItem *Item, bool Force)
 {
   TGuard Guard(FItemsSection);
 
-  bool Result =
-    (FFreeTerminals > 0) ||
-    (Force && (FItemsInProcess < FTransfersLimit));
+  // take all free connections at once
+  intptr_t Count = FFreeTerminals;
+  if (Force && (FItemsInProcess < FTransfersLimit))
+  {
+    // open all connections the limit allows at once, so that they connect
+    // concurrently, instead of adding one connection every few seconds
+    Count = Max(Count, Max(FTransfersLimit - FItems->GetCount(), static_cast<intptr_t>(1)));
+  }
 
-  if (Result)
+  bool Result = (Count > 0);
+  for (intptr_t Index = 0; Index < Count; Index++)
   {
     AddItem(DebugNotNull(Item->CreateParallelOperation()));
   }
@@ -1328,7 +1464,9 @@ TTerminalItem::TTerminalItem(TTerminalQueue *Queue) :
   FItem(nullptr),
   FUserAction(nullptr),
   FCancel(false),
-  FPause(false)
+  FPause(false),
+  FWarmUp(false),
+  FLastUsed(Now())
 {
 }
 
@@ -1381,10 +1519,65 @@ void TTerminalItem::Process(TQueueItem *Item)
   TriggerEvent();
 }
 
+void TTerminalItem::WarmUp()
+{
+  {
+    TGuard Guard(FCriticalSection);
+
+    DebugAssert(FItem == nullptr);
+    FWarmUp = true;
+  }
+
+  TriggerEvent();
+}
+
+void TTerminalItem::DoWarmUp()
+{
+  TGuard Guard(FCriticalSection);
+
+  FWarmUp = false;
+
+  try
+  {
+    if (!FTerminal->GetActive())
+    {
+      FTerminal->Open();
+    }
+  }
+  catch (Exception &E)
+  {
+    // nobody to report the error to, it will show up again,
+    // when the connection is opened for a queue item
+    FTerminal->LogEvent(FORMAT("Background connection warm-up failed: %s", E.Message));
+  }
+
+  if (!FTerminal->GetActive())
+  {
+    // do not keep retrying, the session most likely
+    // needs an interaction with user to authenticate
+    FQueue->TerminalConnected(false);
+    Terminate();
+  }
+  else
+  {
+    FLastUsed = Now();
+    if (!FQueue->TerminalFree(this))
+    {
+      Terminate();
+    }
+  }
+}
+
 void TTerminalItem::ProcessEvent()
 {
   if (!FItem)
+  {
+    if (FWarmUp)
+    {
+      DoWarmUp();
+    }
     return;
+  }
   TGuard Guard(FCriticalSection);
 
   bool Retry = true;
@@ -1404,6 +1597,7 @@ void TTerminalItem::ProcessEvent()
 
       FTerminal->GetSessionData()->SetRemoteDirectory(FItem->GetStartupDirectory());
       FTerminal->Open();
+      FQueue->TerminalConnected(true);
     }
 
     Retry = false;
@@ -1448,6 +1642,8 @@ void TTerminalItem::ProcessEvent()
     FQueue->DeleteItem(Item, !FCancel);
   }
 
+  FLastUsed = Now();
+
   if (!FTerminal->GetActive() ||
     !FQueue->TerminalFree(this))
   {
@@ -1612,8 +1808,9 @@ void TTerminalItem::TerminalPromptUser(TTerminal *Terminal,
 {
   if (FItem == nullptr)
   {
-    // sanity, should not occur
-    DebugFail();
+    // can occur only while warming up the connection,
+    // there's no queue item to show the prompt on
+    DebugAssert(FTerminal->GetStatus() < ssOpened);
     Result = false;
   }
   else
@@ -111,6 +111,9 @@ public:
   void AddItem(TQueueItem *Item);
   TTerminalQueueStatus *CreateStatus(TTerminalQueueStatus *Current);
   void Idle();
+  // Connects and authenticates background sessions ahead of use,
+  // up to Configuration->QueueWarmConnections
+  void WarmUp();
 
 #if 0
   __property bool IsEmpty = { read = GetIsEmpty };
@@ -173,6 +176,8 @@ protected:
   bool FEnabled;
   TDateTime FIdleInterval;
   TDateTime FLastIdle;
+  bool FWarmUpPending;
+  bool FWarmUpFailed;
 
   static TQueueItem *GetItem(TList *List, intptr_t Index);
   TQueueItem *GetItem(intptr_t Index) const;
@@ -195,6 +200,9 @@ protected:
   virtual void ProcessEvent();
   void TerminalFinished(TTerminalItem *TerminalItem);
   bool TerminalFree(TTerminalItem *TerminalItem);
+  void WarmUpTerminals();
+  void TerminalConnected(bool Connected);
+  void CloseIdleTerminals();
   intptr_t GetParallelDurationThreshold() const;
 
   void DoQueueItemUpdate(TQueueItem *Item);
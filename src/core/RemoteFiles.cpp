@@ -871,6 +871,7 @@ TRemoteFile *TRemoteFile::Duplicate(bool Standalone) const
     COPY_FP(Type);
     COPY_FP(CyclicLink);
     COPY_FP(HumanRights);
+    COPY_FP(ETag);
 #undef COPY_FP
     if (Standalone && (!FFullFileName.IsEmpty() || (GetDirectory() != nullptr)))
     {
@@ -1698,11 +1699,13 @@ void TRemoteFileList::DuplicateTo(TRemoteFileList *Copy) const
   }
   Copy->FDirectory = GetDirectory();
   Copy->FTimestamp = FTimestamp;
+  Copy->FValidator = FValidator;
 }
 
 void TRemoteFileList::Reset()
 {
   FTimestamp = Now();
+  FValidator.Clear();
   TObjectList::Clear();
 }
 
@@ -1906,6 +1909,11 @@ void TRemoteDirectoryCache::Clear()
       SAFE_DESTROY(List);
       SetObj(Index, nullptr);
     }
+    for (TRevalidableLists::iterator I = FRevalidable.begin(); I != FRevalidable.end(); ++I)
+    {
+      delete I->second;
+    }
+    FRevalidable.clear();
   }
   __finally
   {
@@ -1976,7 +1984,64 @@ void TRemoteDirectoryCache::AddFileList(TRemoteFileList *FileList)
     // when directory is loaded by secondary terminal
     DoClearFileList(FileList->GetDirectory(), false);
     AddObject(Copy->GetDirectory(), Copy);
+    ClearRevalidable(Copy->GetDirectory());
+  }
+}
+
+void TRemoteDirectoryCache::ClearRevalidable(UnicodeString Directory)
+{
+  TRevalidableLists::iterator I = FRevalidable.find(Directory);
+  if (I != FRevalidable.end())
+  {
+    delete I->second;
+    FRevalidable.erase(Directory);
+  }
+}
+
+const TRemoteFileList *TRemoteDirectoryCache::FindValidatedFileList(UnicodeString Directory) const
+{
+  const TRemoteFileList *Result = nullptr;
+  UnicodeString Directory2 = base::UnixExcludeTrailingBackslash(Directory);
+  intptr_t Index = IndexOf(Directory2);
+  if (Index >= 0)
+  {
+    Result = GetAs<TRemoteFileList>(Index);
+  }
+  else
+  {
+    TRevalidableLists::iterator I = FRevalidable.find(Directory2);
+    if (I != FRevalidable.end())
+    {
+      Result = I->second;
+    }
+  }
+  if ((Result != nullptr) && Result->GetValidator().IsEmpty())
+  {
+    Result = nullptr;
   }
+  return Result;
+}
+
+UnicodeString TRemoteDirectoryCache::GetFileListValidator(UnicodeString Directory) const
+{
+  TGuard Guard(FSection);
+
+  const TRemoteFileList *FileList = FindValidatedFileList(Directory);
+  return (FileList != nullptr) ? FileList->GetValidator() : UnicodeString();
+}
+
+bool TRemoteDirectoryCache::GetValidFileList(UnicodeString Directory,
+  UnicodeString Validator, TRemoteFileList *FileList) const
+{
+  TGuard Guard(FSection);
+
+  const TRemoteFileList *CachedFileList = FindValidatedFileList(Directory);
+  bool Result = (CachedFileList != nullptr) && (CachedFileList->GetValidator() == Validator);
+  if (Result)
+  {
+    CachedFileList->DuplicateTo(FileList);
+  }
+  return Result;
 }
 
 void TRemoteDirectoryCache::ClearFileList(UnicodeString Directory, bool SubDirs)
@@ -2011,7 +2076,17 @@ void TRemoteDirectoryCache::DoClearFileList(UnicodeString Directory, bool SubDir
 void TRemoteDirectoryCache::Delete(intptr_t Index)
 {
   TRemoteFileList *List = GetAs<TRemoteFileList>(Index);
-  SAFE_DESTROY(List);
+  if ((List != nullptr) && !List->GetValidator().IsEmpty())
+  {
+    // The server may still confirm the listing is up to date
+    UnicodeString Directory = List->GetDirectory();
+    ClearRevalidable(Directory);
+    FRevalidable.insert(TRevalidableLists::value_type(Directory, List));
+  }
+  else
+  {
+    SAFE_DESTROY(List);
+  }
   TStringList::Delete(Index);
 }
 
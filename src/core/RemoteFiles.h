@@ -122,6 +122,7 @@ private:
   UnicodeString FHumanRights;
   UnicodeString FFullFileName;
   UnicodeString FTypeName;
+  UnicodeString FETag;
   int64_t FSize;
   int64_t FINodeBlocks;
   intptr_t FIconIndex;
@@ -198,6 +199,7 @@ public:
   __property UnicodeString ListingStr = { read = GetListingStr, write = SetListingStr };
   __property TRights * Rights = { read = FRights, write = SetRights };
   __property UnicodeString HumanRights = { read = FHumanRights, write = FHumanRights };
+  __property UnicodeString ETag = { read = FETag, write = FETag };
   __property TTerminal * Terminal = { read = FTerminal, write = SetTerminal };
   __property wchar_t Type = { read = GetType, write = SetType };
   __property UnicodeString FullFileName  = { read = GetFullFileName, write = FFullFileName };
@@ -235,6 +237,9 @@ public:
   TRights *GetRights() const { return FRights; }
   UnicodeString GetHumanRights() const { return FHumanRights; }
   void SetHumanRights(UnicodeString Value) { FHumanRights = Value; }
+  // Entity tag of the file version, WebDAV only
+  UnicodeString GetETag() const { return FETag; }
+  void SetETag(UnicodeString Value) { FETag = Value; }
   TTerminal *GetTerminal() const { return FTerminal; }
   void SetFullFileName(UnicodeString Value) { FFullFileName = Value; }
 
@@ -276,6 +281,7 @@ public:
 protected:
   UnicodeString FDirectory;
   TDateTime FTimestamp;
+  UnicodeString FValidator;
 public:
   TRemoteFile *GetFile(Integer Index) const;
   virtual void SetDirectory(UnicodeString Value);
@@ -309,6 +315,10 @@ public:
 
   UnicodeString GetDirectory() const { return FDirectory; }
   TDateTime GetTimestamp() const { return FTimestamp; }
+  // Token that changes whenever the directory contents changes
+  // (WebDAV ctag or sync-token), empty if not known
+  UnicodeString GetValidator() const { return FValidator; }
+  void SetValidator(UnicodeString Value) { FValidator = Value; }
 };
 
 class NB_CORE_EXPORT TRemoteDirectory : public TRemoteFileList
@@ -370,6 +380,11 @@ public:
   void AddFileList(TRemoteFileList *FileList);
   void ClearFileList(UnicodeString Directory, bool SubDirs);
   void Clear();
+  // Listings with a validator are kept even when cleared,
+  // until the server tells they have changed
+  UnicodeString GetFileListValidator(UnicodeString Directory) const;
+  bool GetValidFileList(UnicodeString Directory, UnicodeString Validator,
+    TRemoteFileList *FileList) const;
 
 #if 0
   __property bool IsEmpty = { read = GetIsEmpty };
@@ -380,9 +395,14 @@ protected:
   virtual void Delete(intptr_t Index);
 
 private:
+  typedef rde::map<UnicodeString, TRemoteFileList *> TRevalidableLists;
+
   TCriticalSection FSection;
+  mutable TRevalidableLists FRevalidable;
   bool GetIsEmptyPrivate() const;
   void DoClearFileList(UnicodeString Directory, bool SubDirs);
+  void ClearRevalidable(UnicodeString Directory);
+  const TRemoteFileList *FindValidatedFileList(UnicodeString Directory) const;
 };
 
 class TRemoteDirectoryChangesCache : private TStringList
@@ -0,0 +1,470 @@
+#include <vcl.h>
+#pragma hdrstop
+
+#include <Common.h>
+#include <rdestl/vector.h>
+
+#include "ResolverCache.h"
+#include "CoreMain.h"
+#include "Configuration.h"
+
+#ifndef AUTO_WINSOCK
+#include <winsock2.h>
+#endif
+#include <ws2tcpip.h>
+#include <windns.h>
+
+class TResolverCache
+{
+  NB_DISABLE_COPY(TResolverCache)
+public:
+  TResolverCache();
+  ~TResolverCache();
+
+  int GetAddrInfo(const char *Node, const char *Service,
+    const struct addrinfo *Hints, struct addrinfo **Result);
+  void Connected(const struct sockaddr *Addr);
+
+  static struct addrinfo *CopyAddrInfo(const struct addrinfo *AddrInfo, int PreferredFamily);
+  static void SetService(struct addrinfo *AddrInfo, u_short Port, const struct addrinfo *Hints);
+  static void FreeAddrInfo(struct addrinfo *AddrInfo);
+
+private:
+  struct TEntry
+  {
+    AnsiString Key;
+    // Held for the whole time the name is being resolved,
+    // so that concurrent lookups of the same name wait for the first one
+    TCriticalSection Lookup;
+    struct addrinfo *AddrInfo;
+    DWORD Resolved;
+    DWORD Lifetime;
+    int ConnectedFamily;
+    // Lookups holding the entry, it cannot be removed meanwhile
+    intptr_t Users;
+  };
+  typedef rde::vector<TEntry *> TEntries;
+
+  typedef DNS_STATUS (WINAPI *TDnsQuery)(PCSTR Name, WORD Type, DWORD Options,
+    PVOID Extra, PDNS_RECORD *QueryResults, PVOID *Reserved);
+  typedef VOID (WINAPI *TDnsFree)(PVOID Data, DNS_FREE_TYPE FreeType);
+
+  TCriticalSection FSection;
+  TEntries FEntries;
+  HMODULE FDnsApi;
+  TDnsQuery FDnsQuery;
+  TDnsFree FDnsFree;
+
+  TEntry *GetEntry(const AnsiString &Key);
+  void ReleaseEntry(TEntry *Entry);
+  void RemoveExpiredEntries();
+  DWORD GetLifetime(const char *Node, int Family);
+  intptr_t GetTtl(const char *Node, WORD Type);
+  static bool SameAddress(const struct sockaddr *Addr1, const struct sockaddr *Addr2);
+};
+
+TResolverCache::TResolverCache() :
+  FDnsApi(nullptr),
+  FDnsQuery(nullptr),
+  FDnsFree(nullptr)
+{
+  // DnsQuery is used only to read TTL of the records
+  // the system resolver has cached
+  FDnsApi = ::LoadLibrary(L"dnsapi.dll");
+  if (FDnsApi != nullptr)
+  {
+    FDnsQuery = reinterpret_cast<TDnsQuery>(::GetProcAddress(FDnsApi, "DnsQuery_A"));
+    FDnsFree = reinterpret_cast<TDnsFree>(::GetProcAddress(FDnsApi, "DnsFree"));
+  }
+}
+
+TResolverCache::~TResolverCache()
+{
+  for (TEntries::iterator it = FEntries.begin(); it != FEntries.end(); ++it)
+  {
+    TEntry *Entry = *it;
+    FreeAddrInfo(Entry->AddrInfo);
+    delete Entry;
+  }
+  if (FDnsApi != nullptr)
+  {
+    ::FreeLibrary(FDnsApi);
+  }
+}
+
+// Entries are not expected to be many, as there are rarely more than
+// a few hosts connected to, this only guards against unbounded growth
+static const intptr_t ResolverCacheMaxEntries = 64;
+
+TResolverCache::TEntry *TResolverCache::GetEntry(const AnsiString &Key)
+{
+  TGuard Guard(FSection);
+
+  RemoveExpiredEntries();
+
+  for (TEntries::iterator it = FEntries.begin(); it != FEntries.end(); ++it)
+  {
+    if ((*it)->Key == Key)
+    {
+      (*it)->Users++;
+      return *it;
+    }
+  }
+
+  TEntry *Entry = new TEntry();
+  Entry->Key = Key;
+  Entry->AddrInfo = nullptr;
+  Entry->Resolved = 0;
+  Entry->Lifetime = 0;
+  Entry->ConnectedFamily = AF_UNSPEC;
+  Entry->Users = 1;
+  FEntries.push_back(Entry);
+  return Entry;
+}
+
+void TResolverCache::ReleaseEntry(TEntry *Entry)
+{
+  TGuard Guard(FSection);
+  DebugAssert(Entry->Users > 0);
+  Entry->Users--;
+}
+
+void TResolverCache::RemoveExpiredEntries()
+{
+  // called with FSection acquired
+  DWORD Ticks = GetTickCount();
+  TEntries::iterator it = FEntries.begin();
+  while (it != FEntries.end())
+  {
+    TEntry *Entry = *it;
+    if ((Entry->Users == 0) &&
+        ((Entry->AddrInfo == nullptr) || (Ticks - Entry->Resolved >= Entry->Lifetime)))
+    {
+      FreeAddrInfo(Entry->AddrInfo);
+      delete Entry;
+      it = FEntries.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  // still full, make room by dropping the entries resolved the longest ago
+  while (static_cast<intptr_t>(FEntries.size()) >= ResolverCacheMaxEntries)
+  {
+    TEntries::iterator Oldest = FEntries.end();
+    for (it = FEntries.begin(); it != FEntries.end(); ++it)
+    {
+      if (((*it)->Users == 0) &&
+          ((Oldest == FEntries.end()) || (Ticks - (*it)->Resolved > Ticks - (*Oldest)->Resolved)))
+      {
+        Oldest = it;
+      }
+    }
+    if (Oldest == FEntries.end())
+    {
+      // all entries are being resolved just now
+      break;
+    }
+    FreeAddrInfo((*Oldest)->AddrInfo);
+    delete *Oldest;
+    FEntries.erase(Oldest);
+  }
+}
+
+intptr_t TResolverCache::GetTtl(const char *Node, WORD Type)
+{
+  intptr_t Result = -1;
+  PDNS_RECORD Records = nullptr;
+  if ((FDnsQuery != nullptr) && (FDnsFree != nullptr) &&
+      (FDnsQuery(Node, Type, DNS_QUERY_NO_WIRE_QUERY, nullptr, &Records, nullptr) == 0))
+  {
+    for (PDNS_RECORD Record = Records; Record != nullptr; Record = Record->pNext)
+    {
+      if ((Record->wType == Type) &&
+          ((Result < 0) || (static_cast<intptr_t>(Record->dwTtl) < Result)))
+      {
+        Result = static_cast<intptr_t>(Record->dwTtl);
+      }
+    }
+    FDnsFree(Records, DnsFreeRecordList);
+  }
+  return Result;
+}
+
+DWORD TResolverCache::GetLifetime(const char *Node, int Family)
+{
+  TConfiguration *Configuration = GetConfiguration();
+  intptr_t Result = (Configuration != nullptr) ? Configuration->GetResolverCacheLifetime() : 60;
+  if (Result > 0)
+  {
+    // never keep the addresses longer than the DNS records allow
+    intptr_t Ttl = (Family != AF_INET6) ? GetTtl(Node, DNS_TYPE_A) : -1;
+    if (Family != AF_INET)
+    {
+      intptr_t Ttl6 = GetTtl(Node, DNS_TYPE_AAAA);
+      if ((Ttl6 >= 0) && ((Ttl < 0) || (Ttl6 < Ttl)))
+      {
+        Ttl = Ttl6;
+      }
+    }
+    if ((Ttl >= 0) && (Ttl < Result))
+    {
+      Result = Ttl;
+    }
+  }
+  return static_cast<DWORD>(Max(Result, static_cast<intptr_t>(0)) * 1000);
+}
+
+int TResolverCache::GetAddrInfo(const char *Node, const char *Service,
+  const struct addrinfo *Hints, struct addrinfo **Result)
+{
+  *Result = nullptr;
+  struct addrinfo *AddrInfo = nullptr;
+  int Error = EAI_NONAME;
+
+  // only numeric ports can be filled into the cached addresses
+  char *ServiceEnd = nullptr;
+  unsigned long Port = (Service != nullptr) ? strtoul(Service, &ServiceEnd, 10) : 0;
+  bool Cacheable =
+    (Node != nullptr) && (*Node != '\0') &&
+    ((Service == nullptr) || ((*Service != '\0') && (*ServiceEnd == '\0') && (Port <= 0xFFFF))) &&
+    ((Hints == nullptr) ||
+     (!FLAGSET(Hints->ai_flags, AI_PASSIVE) && !FLAGSET(Hints->ai_flags, AI_NUMERICHOST)));
+
+  if (Cacheable)
+  {
+    // numeric addresses are converted without any network lookup,
+    // there's nothing to cache
+    struct addrinfo NumericHints;
+    if (Hints != nullptr)
+    {
+      NumericHints = *Hints;
+    }
+    else
+    {
+      memset(&NumericHints, 0, sizeof(NumericHints));
+    }
+    NumericHints.ai_flags |= AI_NUMERICHOST;
+    Error = ::getaddrinfo(Node, Service, &NumericHints, &AddrInfo);
+    Cacheable = (Error != 0);
+  }
+  else
+  {
+    // local or numeric addresses or a named service
+    Error = ::getaddrinfo(Node, Service, Hints, &AddrInfo);
+  }
+
+  if (!Cacheable)
+  {
+    if (Error == 0)
+    {
+      *Result = CopyAddrInfo(AddrInfo, AF_UNSPEC);
+      ::freeaddrinfo(AddrInfo);
+    }
+  }
+  else
+  {
+    // the addresses are the same for all services and socket types,
+    // only the address family restricts them
+    int Family = (Hints != nullptr) ? Hints->ai_family : AF_UNSPEC;
+    AnsiString Key = AnsiString(Node) + "\n" + AnsiString(FORMAT("%d", Family));
+    TEntry *Entry = GetEntry(Key);
+
+    {
+      TGuard Guard(Entry->Lookup);
+
+      if ((Entry->AddrInfo != nullptr) &&
+          (GetTickCount() - Entry->Resolved < Entry->Lifetime))
+      {
+        Error = 0;
+      }
+      else
+      {
+        struct addrinfo LookupHints;
+        memset(&LookupHints, 0, sizeof(LookupHints));
+        LookupHints.ai_family = Family;
+        // one entry per address, the socket type is set for each caller
+        LookupHints.ai_socktype = SOCK_STREAM;
+        LookupHints.ai_flags = AI_CANONNAME;
+        Error = ::getaddrinfo(Node, nullptr, &LookupHints, &AddrInfo);
+        // failures are not cached, the next connection attempt tries again
+        if (Error == 0)
+        {
+          DWORD Lifetime = GetLifetime(Node, Family);
+          TGuard Guard2(FSection);
+          FreeAddrInfo(Entry->AddrInfo);
+          Entry->AddrInfo = CopyAddrInfo(AddrInfo, AF_UNSPEC);
+          Entry->Resolved = GetTickCount();
+          Entry->Lifetime = Lifetime;
+          ::freeaddrinfo(AddrInfo);
+        }
+      }
+
+      if (Error == 0)
+      {
+        TConfiguration *Configuration = GetConfiguration();
+        bool PreferConnectedFamily = (Configuration != nullptr) && Configuration->GetResolverPreferConnectedFamily();
+        TGuard Guard2(FSection);
+        *Result = CopyAddrInfo(Entry->AddrInfo, PreferConnectedFamily ? Entry->ConnectedFamily : AF_UNSPEC);
+      }
+    }
+
+    ReleaseEntry(Entry);
+
+    if (*Result != nullptr)
+    {
+      SetService(*Result, static_cast<u_short>(Port), Hints);
+    }
+  }
+
+  return Error;
+}
+
+bool TResolverCache::SameAddress(const struct sockaddr *Addr1, const struct sockaddr *Addr2)
+{
+  bool Result = false;
+  if (Addr1->sa_family == Addr2->sa_family)
+  {
+    // ports are ignored, the same host is resolved for different services
+    if (Addr1->sa_family == AF_INET)
+    {
+      Result = (memcmp(&reinterpret_cast<const struct sockaddr_in *>(Addr1)->sin_addr,
+        &reinterpret_cast<const struct sockaddr_in *>(Addr2)->sin_addr, sizeof(struct in_addr)) == 0);
+    }
+    else if (Addr1->sa_family == AF_INET6)
+    {
+      Result = (memcmp(&reinterpret_cast<const struct sockaddr_in6 *>(Addr1)->sin6_addr,
+        &reinterpret_cast<const struct sockaddr_in6 *>(Addr2)->sin6_addr, sizeof(struct in6_addr)) == 0);
+    }
+  }
+  return Result;
+}
+
+void TResolverCache::Connected(const struct sockaddr *Addr)
+{
+  TGuard Guard(FSection);
+
+  for (TEntries::iterator it = FEntries.begin(); it != FEntries.end(); ++it)
+  {
+    TEntry *Entry = *it;
+    // entries are replaced under FSection too,
+    // no need to wait for the lookups in progress
+    for (const struct addrinfo *AddrInfo = Entry->AddrInfo; AddrInfo != nullptr; AddrInfo = AddrInfo->ai_next)
+    {
+      if ((AddrInfo->ai_addr != nullptr) && SameAddress(AddrInfo->ai_addr, Addr))
+      {
+        Entry->ConnectedFamily = Addr->sa_family;
+        break;
+      }
+    }
+  }
+}
+
+struct addrinfo *TResolverCache::CopyAddrInfo(const struct addrinfo *AddrInfo, int PreferredFamily)
+{
+  struct addrinfo *Result = nullptr;
+  struct addrinfo **Next = &Result;
+  // first pass copies addresses of the preferred family (if any), the second one the others
+  for (int Pass = (PreferredFamily != AF_UNSPEC) ? 0 : 1; Pass < 2; Pass++)
+  {
+    for (const struct addrinfo *Source = AddrInfo; Source != nullptr; Source = Source->ai_next)
+    {
+      bool Preferred = (Source->ai_family == PreferredFamily);
+      if ((PreferredFamily != AF_UNSPEC) && ((Pass == 0) != Preferred))
+      {
+        continue;
+      }
+      // the address and canonical name are stored in the same block as the structure
+      size_t CanonNameLen = (Source->ai_canonname != nullptr) ? strlen(Source->ai_canonname) + 1 : 0;
+      uint8_t *Block = static_cast<uint8_t *>(nb_malloc(sizeof(struct addrinfo) + Source->ai_addrlen + CanonNameLen));
+      struct addrinfo *Copy = reinterpret_cast<struct addrinfo *>(Block);
+      *Copy = *Source;
+      Copy->ai_next = nullptr;
+      Copy->ai_addr = nullptr;
+      Copy->ai_canonname = nullptr;
+      if (Source->ai_addr != nullptr)
+      {
+        Copy->ai_addr = reinterpret_cast<struct sockaddr *>(Block + sizeof(struct addrinfo));
+        memmove(Copy->ai_addr, Source->ai_addr, Source->ai_addrlen);
+      }
+      if (CanonNameLen > 0)
+      {
+        Copy->ai_canonname = reinterpret_cast<char *>(Block + sizeof(struct addrinfo) + Source->ai_addrlen);
+        memmove(Copy->ai_canonname, Source->ai_canonname, CanonNameLen);
+      }
+      *Next = Copy;
+      Next = &Copy->ai_next;
+    }
+  }
+  // callers (PuTTY) take the canonical name from the first entry only
+  if ((Result != nullptr) && (Result->ai_canonname == nullptr) &&
+      (AddrInfo != nullptr) && (AddrInfo->ai_canonname != nullptr) && (Result->ai_next != nullptr))
+  {
+    for (struct addrinfo *Copy = Result->ai_next; Copy != nullptr; Copy = Copy->ai_next)
+    {
+      if (Copy->ai_canonname != nullptr)
+      {
+        Result->ai_canonname = Copy->ai_canonname;
+        Copy->ai_canonname = nullptr;
+        break;
+      }
+    }
+  }
+  return Result;
+}
+
+void TResolverCache::SetService(struct addrinfo *AddrInfo, u_short Port, const struct addrinfo *Hints)
+{
+  for (; AddrInfo != nullptr; AddrInfo = AddrInfo->ai_next)
+  {
+    if ((Hints != nullptr) && (Hints->ai_socktype != 0))
+    {
+      AddrInfo->ai_socktype = Hints->ai_socktype;
+      AddrInfo->ai_protocol = Hints->ai_protocol;
+    }
+    if (AddrInfo->ai_addr != nullptr)
+    {
+      if (AddrInfo->ai_family == AF_INET)
+      {
+        reinterpret_cast<struct sockaddr_in *>(AddrInfo->ai_addr)->sin_port = htons(Port);
+      }
+      else if (AddrInfo->ai_family == AF_INET6)
+      {
+        reinterpret_cast<struct sockaddr_in6 *>(AddrInfo->ai_addr)->sin6_port = htons(Port);
+      }
+    }
+  }
+}
+
+void TResolverCache::FreeAddrInfo(struct addrinfo *AddrInfo)
+{
+  while (AddrInfo != nullptr)
+  {
+    struct addrinfo *Next = AddrInfo->ai_next;
+    nb_free(AddrInfo);
+    AddrInfo = Next;
+  }
+}
+
+static TResolverCache ResolverCache;
+
+int cached_getaddrinfo(const char *Node, const char *Service,
+  const struct addrinfo *Hints, struct addrinfo **Result)
+{
+  return ResolverCache.GetAddrInfo(Node, Service, Hints, Result);
+}
+
+void cached_freeaddrinfo(struct addrinfo *AddrInfo)
+{
+  TResolverCache::FreeAddrInfo(AddrInfo);
+}
+
+void cached_addrinfo_connected(const struct sockaddr *Addr)
+{
+  if (Addr != nullptr)
+  {
+    ResolverCache.Connected(Addr);
+  }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+struct addrinfo;
+struct sockaddr;
+
+// Drop-in replacement of getaddrinfo() backed by a process-wide cache
+// shared by all protocol stacks (PuTTY, FileZilla, neon), so that sessions
+// connecting to the same host (secondary sessions, queue connections)
+// do not each wait for the resolver.
+// Concurrent lookups of the same name are resolved only once.
+// The result has to be released with cached_freeaddrinfo().
+extern "C" int cached_getaddrinfo(const char *Node, const char *Service,
+  const struct addrinfo *Hints, struct addrinfo **Result);
+extern "C" void cached_freeaddrinfo(struct addrinfo *AddrInfo);
+// Reports an address a connection was successfully established to,
+// with Configuration->ResolverPreferConnectedFamily the address family
+// is then preferred in subsequent results for the same host
+extern "C" void cached_addrinfo_connected(const struct sockaddr *Addr);
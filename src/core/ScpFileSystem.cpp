@@ -11,6 +11,7 @@
 #include "TextsCore.h"
 #include "HelpCore.h"
 #include "SecureShell.h"
+#include "TarStream.h"
 
 #include <stdio.h>
 
@@ -36,9 +37,9 @@ inline void ThrowScpEror(Exception *Exception, UnicodeString Message)
   throw EScp(Exception, Message);
 }
 
-#define MaxShellCommand fsLang
+#define MaxShellCommand fsTarToLocal
 #define ShellCommandCount MaxShellCommand + 1
-#define MaxCommandLen 40
+#define MaxCommandLen 128
 
 struct TCommandType
 {
@@ -153,6 +154,11 @@ const TCommandType DefaultCommandSet[ShellCommandCount] =
   /*CopyFile*/            {  0,  0, T, F, F, "cp -p -r -f %s \"%s\" \"%s\"" /* file/directory, target name*/},
   /*AnyCommand*/          {  0, -1, T, T, F, "%s" },
   /*Lang*/                {  0,  1, F, F, F, "printenv LANG"},
+  // see TSCPFileSystem::DetectTar
+  /*TarDetect*/           { -1, -1, F, F, F, "command -v tar ; command -v gzip ; printf abc | head -c 2" },
+  // head makes sure the shell gets back its input after the archive, whatever tar reads
+  /*TarToRemote*/         { -1, -1, T, F, F, "(cd \"%s\" && echo \"%s\" && head -c %s | (tar -x -o %s -f - ; R=$? ; cat > /dev/null ; exit $R))" /* directory, first line, archive size, options */ },
+  /*TarToLocal*/          { -1, -1, F, F, F, "(cd \"%s\" && echo \"%s\" && tar -c -h %s -f - %s)" /* directory, first line, options, files */ },
 };
 #undef F
 #undef T
@@ -325,6 +331,8 @@ TSCPFileSystem::TSCPFileSystem(TTerminal *ATerminal) :
   FReturnCode(0),
   FProcessingCommand(false),
   FLsFullTime(asAuto),
+  FTarTransfer(asAuto),
+  FTarGzip(false),
   FOnCaptureOutput(nullptr),
   FScpFatalError(false)
 {
@@ -336,6 +344,9 @@ void TSCPFileSystem::Init(void *Data)
   DebugAssert(FSecureShell);
   FCommandSet = new TCommandSet(FTerminal->GetSessionData());
   FLsFullTime = FTerminal->GetSessionData()->GetSCPLsFullTime();
+  FTarTransfer = FTerminal->GetSessionData()->GetSCPTarTransfer();
+  // Unless detected otherwise, see DetectTar
+  FTarGzip = true;
   FScpFatalError = false;
   FOutput = new TStringList();
   FProcessingCommand = false;
@@ -518,8 +529,12 @@ bool TSCPFileSystem::IsCapable(intptr_t Capability) const
   case fcLocking:
   case fcPreservingTimestampDirs:
   case fcResumeSupport:
+  case fsParallelTransfers:
+    return true;
+
   case fsSkipTransfer:
-  case fsParallelTransfers: // does not implement cpNoRecurse
+  case fsParallelFileTransfers:
+  case fsDirectoryTree:
     return false;
 
   case fcChangePassword:
@@ -1610,6 +1625,11 @@ void TSCPFileSystem::CopyToRemote(const TStrings *AFilesToCopy,
   DebugAssert(AFilesToCopy && OperationProgress);
 
   Params &= ~(cpAppend | cpResume);
+  if (CanTarTransfer(AFilesToCopy, true, CopyParam, Params, OperationProgress))
+  {
+    TarCopyToRemote(AFilesToCopy, TargetDir, CopyParam, Params, OperationProgress, OnceDoneOperation);
+    return;
+  }
   bool CheckExistence = base::UnixSamePath(TargetDir, FTerminal->RemoteGetCurrentDirectory()) &&
     (FTerminal->GetFiles() != nullptr) && FTerminal->GetFiles()->GetLoaded();
   bool CopyBatchStarted = false;
@@ -2219,13 +2239,18 @@ void TSCPFileSystem::SCPDirectorySource(UnicodeString DirectoryName,
     DWORD FindAttrs = faReadOnly | faHidden | faSysFile | faDirectory | faArchive;
     TSearchRecChecked SearchRec;
     bool FindOK = false;
-    FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(LIST_DIR_ERROR, DirectoryName), "",
-    [&]()
+    // With cpNoRecurse (parallel transfer) only the (empty) directory
+    // is created, its contents are transferred separately
+    if (FLAGCLEAR(Params, cpNoRecurse))
     {
-      UnicodeString Path = ::IncludeTrailingBackslash(DirectoryName) + L"*.*";
-      FindOK = ::FindFirstChecked(Path,
-          FindAttrs, SearchRec) == 0;
-    });
+      FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(LIST_DIR_ERROR, DirectoryName), "",
+      [&]()
+      {
+        UnicodeString Path = ::IncludeTrailingBackslash(DirectoryName) + L"*.*";
+        FindOK = ::FindFirstChecked(Path,
+            FindAttrs, SearchRec) == 0;
+      });
+    }
 
     try__finally
     {
@@ -2286,7 +2311,9 @@ void TSCPFileSystem::SCPDirectorySource(UnicodeString DirectoryName,
 
     /* TODO : Delete also read-only directories. */
     /* TODO : Show error message on failure. */
-    if (!OperationProgress->GetCancel())
+    // With cpNoRecurse the contents may still be being transferred
+    // by other connections
+    if (!OperationProgress->GetCancel() && FLAGCLEAR(Params, cpNoRecurse))
     {
       if (FLAGSET(Params, cpDelete))
       {
@@ -2322,7 +2349,14 @@ void TSCPFileSystem::CopyToLocal(const TStrings *AFilesToCopy,
   TOnceDoneOperation &OnceDoneOperation)
 {
   bool CloseSCP = False;
+  // Whether remote scp may still be running and needs closing on failure
+  bool SCPRunning = false;
   Params &= ~(cpAppend | cpResume);
+  if (CanTarTransfer(AFilesToCopy, false, CopyParam, Params, OperationProgress))
+  {
+    TarCopyToLocal(AFilesToCopy, TargetDir, CopyParam, Params, OperationProgress, OnceDoneOperation);
+    return;
+  }
   UnicodeString Options = InitOptionsStr(CopyParam);
 
   FTerminal->LogEvent(FORMAT("Copying %d files/directories to local directory "
@@ -2336,7 +2370,7 @@ void TSCPFileSystem::CopyToLocal(const TStrings *AFilesToCopy,
       // In case that copying doesn't cause fatal error (ie. connection is
       // still active) but wasn't successful (exception or user termination)
       // we need to ensure, that SCP on remote side is closed
-      if (FTerminal->GetActive() && (CloseSCP ||
+      if (FTerminal->GetActive() && SCPRunning && (CloseSCP ||
           (OperationProgress->GetCancel() == csCancel) ||
           (OperationProgress->GetCancel() == csCancelTransfer)))
       {
@@ -2368,9 +2402,37 @@ void TSCPFileSystem::CopyToLocal(const TStrings *AFilesToCopy,
       TRemoteFile *File = AFilesToCopy->GetAs<TRemoteFile>(IFile);
       DebugAssert(File);
 
+      if (FLAGSET(Params, cpNoRecurse) && File->GetIsDirectory())
+      {
+        // Remote scp would send the whole tree, so the directory is only
+        // created locally, its contents are transferred separately
+        // (parallel transfer). Remote scp is not running (the previous
+        // file, if any, completed, otherwise the loop would have ended),
+        // so there is nothing to close, when this fails.
+        SCPRunning = false;
+        bool Success = false;
+        try__finally
+        {
+          SCOPE_EXIT
+          {
+            OperationProgress->Finish(FileName, Success, OnceDoneOperation);
+          };
+          SCPSinkDirectory(File, TargetDir, CopyParam, OperationProgress);
+          Success = true;
+        }
+        __finally
+        {
+#if 0
+          OperationProgress->Finish(FileName, Success, OnceDoneOperation);
+#endif // #if 0
+        };
+        continue;
+      }
+
       try
       {
         bool Success = true; // Have to be set to True (see ::SCPSink)
+        SCPRunning = true;
         SendCommand(FCommandSet->FullCommand(fsCopyToLocal,
             Options, DelimitStr(FileName)));
         SkipFirstLine();
@@ -2479,6 +2541,35 @@ void TSCPFileSystem::CopyToLocal(const TStrings *AFilesToCopy,
   };
 }
 
+void TSCPFileSystem::SCPSinkDirectory(const TRemoteFile *AFile, UnicodeString TargetDir,
+  const TCopyParamType *CopyParam, TFileOperationProgressType *OperationProgress)
+{
+  // Local counterpart of the 'D' record handling in SCPSink
+  UnicodeString AbsoluteFileName = base::UnixExcludeTrailingBackslash(AFile->GetFullFileName());
+  OperationProgress->SetFile(AbsoluteFileName);
+
+  UnicodeString TargetDirectory = CreateTargetDirectory(AFile->GetFileName(), TargetDir, CopyParam);
+  UnicodeString DestFileName =
+    ::IncludeTrailingBackslash(TargetDirectory) +
+    FTerminal->ChangeFileName(CopyParam, OperationProgress->GetFileName(), osRemote, true);
+
+  FTerminal->LogEvent(FORMAT("Creating local directory \"%s\" without its contents.", DestFileName));
+
+  DWORD LocalFileAttrs = FTerminal->GetLocalFileAttributes(ApiPath(DestFileName));
+  if (LocalFileAttrs == INVALID_FILE_ATTRIBUTES)
+  {
+    FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(CREATE_DIR_ERROR, DestFileName), "",
+    [&]()
+    {
+      THROWOSIFFALSE(::ForceDirectories(ApiPath(DestFileName)));
+    });
+  }
+  else if (FLAGCLEAR(LocalFileAttrs, faDirectory))
+  {
+    ThrowFileSkipped(nullptr, FMTLOAD(NOT_DIRECTORY_ERROR, DestFileName));
+  }
+}
+
 void TSCPFileSystem::SCPError(const UnicodeString Message, bool Fatal)
 {
   SCPSendError(Message, Fatal);
@@ -2963,6 +3054,16 @@ void TSCPFileSystem::UnlockFile(UnicodeString /*FileName*/, const TRemoteFile *
   DebugFail();
 }
 
+void TSCPFileSystem::BeginDirectoryTree()
+{
+  DebugFail();
+}
+
+void TSCPFileSystem::EndDirectoryTree()
+{
+  DebugFail();
+}
+
 void TSCPFileSystem::UpdateFromMain(TCustomFileSystem * /*MainFileSystem*/)
 {
   // noop
@@ -2983,3 +3084,916 @@ UnicodeString TSCPFileSystem::InitOptionsStr(const TCopyParamType *CopyParam) co
   return Options;
 }
 
+struct TTarSourceItem
+{
+  TTarSourceItem() : Index(0) {}
+
+  UnicodeString FileName;
+  // Remote name, relative to the target directory
+  UnicodeString DestName;
+  // Top-level file (in the list of files to copy) the item belongs to
+  intptr_t Index;
+  TTarEntry Entry;
+};
+
+bool TSCPFileSystem::CanTarTransfer(const TStrings *AFilesToCopy, bool ToRemote,
+  const TCopyParamType *CopyParam, intptr_t Params,
+  TFileOperationProgressType *OperationProgress)
+{
+  // The archive is packed and unpacked as a whole, so there is no place
+  // for decisions on individual files (overwrite confirmations, ascii mode,
+  // deleting the source files). Single files are better sent with scp.
+  bool Result =
+    (FTarTransfer != asOff) &&
+    FLAGCLEAR(Params, cpDelete | cpTemporary | cpNewerOnly | cpNoRecurse) &&
+    (CopyParam->GetTransferMode() == tmBinary) &&
+    !CopyParam->GetClearArchive() &&
+    (FTerminal->EffectiveBatchOverwrite(L"", CopyParam, Params, OperationProgress, false) == boAll);
+
+  bool AnyDirectory = false;
+  UnicodeString SourceDir;
+  for (intptr_t Index = 0; Result && (Index < AFilesToCopy->GetCount()); ++Index)
+  {
+    if (ToRemote)
+    {
+      // Files with objects attached come from synchronization
+      Result = (AFilesToCopy->GetObj(Index) == nullptr);
+      if (Result && ::DirectoryExists(ApiPath(AFilesToCopy->GetString(Index))))
+      {
+        AnyDirectory = true;
+      }
+    }
+    else
+    {
+      const TRemoteFile *File = AFilesToCopy->GetAs<TRemoteFile>(Index);
+      DebugAssert(File);
+      // tar is run in the source directory
+      UnicodeString FileDir =
+        base::UnixExtractFilePath(base::UnixExcludeTrailingBackslash(File->GetFullFileName()));
+      if (Index == 0)
+      {
+        SourceDir = FileDir;
+      }
+      Result = base::UnixSamePath(SourceDir, FileDir);
+      if (File->GetIsDirectory())
+      {
+        AnyDirectory = true;
+      }
+    }
+  }
+  Result = Result && AnyDirectory;
+
+  if (Result && (FTarTransfer == asAuto))
+  {
+    DetectTar();
+  }
+  return Result && (FTarTransfer == asOn);
+}
+
+void TSCPFileSystem::DetectTar()
+{
+  // "head -c" bounds the uploaded archive, it is not in POSIX,
+  // so it is checked along with tar
+  bool Tar = false;
+  bool Head = false;
+  bool Gzip = false;
+  try
+  {
+    ExecCommand(fsTarDetect, 0);
+
+    for (intptr_t Index = 0; Index < FOutput->GetCount(); ++Index)
+    {
+      UnicodeString Line = FOutput->GetString(Index).Trim();
+      UnicodeString Name = base::UnixExtractFileName(Line);
+      if (Name == L"tar")
+      {
+        Tar = true;
+      }
+      else if (Name == L"gzip")
+      {
+        Gzip = true;
+      }
+      else if (Line == L"ab")
+      {
+        Head = true;
+      }
+    }
+  }
+  catch (Exception &)
+  {
+    // ignore non-fatal errors
+    if (!FTerminal->GetActive())
+    {
+      throw;
+    }
+  }
+
+  FTarTransfer = (Tar && Head) ? asOn : asOff;
+  FTarGzip = Gzip;
+  FTerminal->LogEvent(FORMAT("Tar transfer available: %s (tar: %s, head: %s, gzip: %s)",
+    BooleanToEngStr(FTarTransfer == asOn), BooleanToEngStr(Tar), BooleanToEngStr(Head),
+    BooleanToEngStr(Gzip)));
+}
+
+void TSCPFileSystem::TarStarted(UnicodeString Command)
+{
+  // The first line is printed only once in the directory,
+  // otherwise we get an error and the last line
+  UnicodeString Line = FSecureShell->ReceiveLine();
+  if (Line != FCommandSet->GetFirstLine())
+  {
+    if (IsLastLine(Line))
+    {
+      ReadCommandOutput(coRaiseExcept, &Command);
+      FTerminal->TerminalError(LoadStr(SCP_INIT_ERROR));
+    }
+    else
+    {
+      FTerminal->FatalError(nullptr, FMTLOAD(FIRST_LINE_EXPECTED, Line));
+    }
+  }
+}
+
+void TSCPFileSystem::TarCopyToRemote(const TStrings *AFilesToCopy,
+  UnicodeString TargetDir, const TCopyParamType *CopyParam,
+  intptr_t /*Params*/, TFileOperationProgressType *OperationProgress,
+  TOnceDoneOperation &OnceDoneOperation)
+{
+  DebugAssert(AFilesToCopy && OperationProgress);
+
+  intptr_t Count = AFilesToCopy->GetCount();
+  FTerminal->LogEvent(FORMAT("Copying %d files/directories to remote directory "
+      "\"%s\" as tar archive", Count, TargetDir));
+
+  rde::vector<bool> Failed(Count);
+  rde::vector<TTarSourceItem> Items;
+  bool Success = false;
+
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      for (intptr_t Index = 0; Index < Count; ++Index)
+      {
+        OperationProgress->Finish(AFilesToCopy->GetString(Index),
+          Success && !Failed[Index], OnceDoneOperation);
+      }
+    };
+
+    // The archive size is sent upfront, so the trees are walked first
+    for (intptr_t Index = 0; (Index < Count) && !OperationProgress->GetCancel(); ++Index)
+    {
+      UnicodeString FileName = AFilesToCopy->GetString(Index);
+      try
+      {
+        OperationProgress->SetFile(FileName, false);
+
+        if (!FTerminal->AllowLocalFileTransfer(FileName, CopyParam, OperationProgress))
+        {
+          ThrowSkipFileNull();
+        }
+
+        DWORD FindAttrs = faReadOnly | faHidden | faSysFile | faDirectory | faArchive;
+        TSearchRecChecked SearchRec;
+        FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(FILE_NOT_EXISTS, FileName), "",
+        [&]()
+        {
+          if (::FindFirstChecked(::ExcludeTrailingBackslash(FileName), FindAttrs, SearchRec) != 0)
+          {
+            ::RaiseLastOSError();
+          }
+        });
+        base::FindClose(SearchRec);
+
+        UnicodeString DestName =
+          FTerminal->ChangeFileName(
+            CopyParam, base::ExtractFileName(FileName, false), osLocal, true);
+
+        if (FTerminal->GetSessionData()->GetCacheDirectories())
+        {
+          FTerminal->DirectoryModified(TargetDir, false);
+
+          if (FLAGSET(SearchRec.Attr, faDirectory))
+          {
+            FTerminal->DirectoryModified(base::UnixIncludeTrailingBackslash(TargetDir) +
+              DestName, true);
+          }
+        }
+
+        TarSource(FileName, DestName, Index, SearchRec, CopyParam, OperationProgress, Items);
+      }
+      catch (ESkipFile &E)
+      {
+        Failed[Index] = true;
+        TSuspendFileOperationProgress Suspend(OperationProgress);
+        if (!FTerminal->HandleException(&E))
+        {
+          throw;
+        }
+      }
+    }
+
+    if (!Items.empty() && !OperationProgress->GetCancel())
+    {
+      int64_t Size = TarEndSize;
+      for (size_t ItemIndex = 0; ItemIndex < Items.size(); ++ItemIndex)
+      {
+        Size += TarEntrySize(Items[ItemIndex].Entry);
+      }
+
+      UnicodeString Options;
+      if (CopyParam->GetPreserveRights())
+      {
+        AddToList(Options, L"-p", L" ");
+      }
+      if (!CopyParam->GetPreserveTime())
+      {
+        AddToList(Options, L"-m", L" ");
+      }
+
+      UnicodeString DelimitedTargetDir = DelimitStr(base::UnixExcludeTrailingBackslash(TargetDir));
+      UnicodeString SizeStr = ::Int64ToStr(Size);
+      UnicodeString Command =
+        FCommandSet->Command(fsTarToRemote, DelimitedTargetDir, FCommandSet->GetFirstLine(), SizeStr, Options);
+      FTerminal->LogEvent(FORMAT("Sending %d entries as tar archive of %s bytes.",
+        static_cast<int>(Items.size()), SizeStr));
+      SendCommand(FCommandSet->FullCommand(fsTarToRemote,
+        DelimitedTargetDir, FCommandSet->GetFirstLine(), SizeStr, Options));
+      TarStarted(Command);
+
+      TTarWriter Writer;
+      auto SendOutput = [&](bool All)
+      {
+        if ((Writer.GetOutputSize() > 0) &&
+            (All || (Writer.GetOutputSize() >= static_cast<intptr_t>(TFileOperationProgressType::StaticBlockSize()))))
+        {
+          FSecureShell->Send(Writer.GetOutput(), Writer.GetOutputSize());
+          Writer.DiscardOutput();
+        }
+      };
+
+      // Once the archive size is announced, it has to be sent whole,
+      // every failure from now on is fatal
+      try
+      {
+        for (size_t ItemIndex = 0; ItemIndex < Items.size(); ++ItemIndex)
+        {
+          const TTarSourceItem &Item = Items[ItemIndex];
+          UnicodeString AbsoluteFileName = base::UnixIncludeTrailingBackslash(TargetDir) + Item.DestName;
+
+          OperationProgress->SetFile(Item.FileName, false);
+
+          if (Item.Entry.Type == tetDirectory)
+          {
+            Writer.AddEntry(Item.Entry);
+            Writer.EndEntry();
+          }
+          else
+          {
+            HANDLE LocalFileHandle = INVALID_HANDLE_VALUE;
+            try
+            {
+              FTerminal->TerminalOpenLocalFile(Item.FileName, GENERIC_READ,
+                nullptr, &LocalFileHandle, nullptr, nullptr, nullptr, nullptr);
+            }
+            catch (ESkipFile &E)
+            {
+              // Keep the announced archive size
+              Writer.AddFiller(TarEntrySize(Item.Entry));
+              Failed[Item.Index] = true;
+              TSuspendFileOperationProgress Suspend(OperationProgress);
+              if (!FTerminal->HandleException(&E))
+              {
+                throw;
+              }
+            }
+
+            if (LocalFileHandle != INVALID_HANDLE_VALUE)
+            {
+              std::unique_ptr<TSafeHandleStream> Stream(new TSafeHandleStream(LocalFileHandle));
+              TUploadSessionAction Action(FTerminal->GetActionLog());
+              Action.SetFileName(::ExpandUNCFileName(Item.FileName));
+              Action.Destination(AbsoluteFileName);
+
+              try__finally
+              {
+                SCOPE_EXIT
+                {
+                  Stream.reset();
+                  SAFE_CLOSE_HANDLE(LocalFileHandle);
+                };
+                OperationProgress->SetFileInProgress();
+                OperationProgress->SetLocalSize(Item.Entry.Size);
+                OperationProgress->SetTransferSize(Item.Entry.Size);
+                OperationProgress->SetAsciiTransfer(false);
+                OperationProgress->SetTransferringFile(true);
+
+                try
+                {
+                  Writer.AddEntry(Item.Entry);
+                  TFileBuffer BlockBuf;
+                  // Data appended to the file meanwhile are not sent,
+                  // missing data (file truncated) are padded by the writer
+                  while (Writer.GetDataRemaining() > 0)
+                  {
+                    int64_t BlockSize =
+                      std::min(static_cast<int64_t>(OperationProgress->LocalBlockSize()), Writer.GetDataRemaining());
+                    FileOperationLoopCustom(FTerminal, OperationProgress, False,
+                      FMTLOAD(READ_ERROR, Item.FileName), "",
+                    [&]()
+                    {
+                      BlockBuf.LoadStream(Stream.get(), BlockSize, false);
+                    });
+                    if (BlockBuf.GetSize() == 0)
+                    {
+                      break;
+                    }
+
+                    Writer.AddData(reinterpret_cast<const uint8_t *>(BlockBuf.GetData()),
+                      static_cast<intptr_t>(BlockBuf.GetSize()));
+                    OperationProgress->AddLocallyUsed(BlockBuf.GetSize());
+                    SendOutput(false);
+                    OperationProgress->AddTransferred(BlockBuf.GetSize());
+
+                    if (OperationProgress->GetCancel() == csCancelTransfer)
+                    {
+                      throw Exception(MainInstructions(LoadStr(USER_TERMINATED)));
+                    }
+                  }
+                  Writer.EndEntry();
+                }
+                catch (Exception &E)
+                {
+                  FTerminal->RollbackAction(Action, OperationProgress, &E);
+                  throw;
+                }
+                OperationProgress->SetTransferringFile(false);
+              }
+              __finally
+              {
+#if 0
+                delete Stream;
+                CloseHandle(LocalFileHandle);
+#endif // #if 0
+              };
+
+              FTerminal->LogFileDone(OperationProgress, AbsoluteFileName);
+            }
+          }
+
+          SendOutput(false);
+
+          if (OperationProgress->GetCancel())
+          {
+            throw Exception(MainInstructions(LoadStr(USER_TERMINATED)));
+          }
+        }
+
+        Writer.Finish();
+        SendOutput(true);
+      }
+      catch (Exception &E)
+      {
+        FTerminal->FatalError(&E, FMTLOAD(COPY_FATAL, OperationProgress->GetFileName()));
+      }
+
+      ReadCommandOutput(coWaitForLastLine | coRaiseExcept | coExpectNoOutput, &Command);
+    }
+    Success = !OperationProgress->GetCancel();
+  }
+  __finally
+  {
+#if 0
+    for (int Index = 0; Index < Count; Index++)
+    {
+      OperationProgress->Finish(AFilesToCopy->Strings[Index],
+        Success && !Failed[Index], OnceDoneOperation);
+    }
+#endif // #if 0
+  };
+}
+
+void TSCPFileSystem::TarSource(UnicodeString AFileName, UnicodeString DestName, intptr_t Index,
+  const TSearchRecChecked &SearchRec, const TCopyParamType *CopyParam,
+  TFileOperationProgressType *OperationProgress, rde::vector<TTarSourceItem> &Items)
+{
+  bool Dir = FLAGSET(SearchRec.Attr, faDirectory);
+
+  TTarSourceItem Item;
+  Item.FileName = AFileName;
+  Item.DestName = DestName;
+  Item.Index = Index;
+  Item.Entry.Name = FSecureShell->ConvertOutput(DestName);
+  Item.Entry.Type = Dir ? tetDirectory : tetFile;
+  Item.Entry.Size = Dir ? 0 :
+    (static_cast<int64_t>(SearchRec.FindData.nFileSizeHigh) << 32) + SearchRec.FindData.nFileSizeLow;
+  Item.Entry.MTime =
+    ::ConvertTimestampToUnixSafe(SearchRec.FindData.ftLastWriteTime, FTerminal->GetSessionData()->GetDSTMode());
+  Item.Entry.Mode = CopyParam->RemoteFileRights(SearchRec.Attr).GetNumber();
+  Items.push_back(Item);
+
+  if (Dir)
+  {
+    FTerminal->LogEvent(FORMAT("Entering directory \"%s\".", AFileName));
+
+    DWORD FindAttrs = faReadOnly | faHidden | faSysFile | faDirectory | faArchive;
+    TSearchRecChecked ChildRec;
+    bool FindOK = false;
+    FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(LIST_DIR_ERROR, AFileName), "",
+    [&]()
+    {
+      UnicodeString Path = ::IncludeTrailingBackslash(AFileName) + L"*.*";
+      FindOK = ::FindFirstChecked(Path, FindAttrs, ChildRec) == 0;
+    });
+
+    try__finally
+    {
+      SCOPE_EXIT
+      {
+        base::FindClose(ChildRec);
+      };
+      while (FindOK && !OperationProgress->GetCancel())
+      {
+        if ((ChildRec.Name != THISDIRECTORY) && (ChildRec.Name != PARENTDIRECTORY))
+        {
+          UnicodeString FileName = ::IncludeTrailingBackslash(AFileName) + ChildRec.Name;
+          try
+          {
+            if (!FTerminal->AllowLocalFileTransfer(FileName, CopyParam, OperationProgress))
+            {
+              ThrowSkipFileNull();
+            }
+            UnicodeString ChildDestName =
+              DestName + L"/" + FTerminal->ChangeFileName(CopyParam, ChildRec.Name, osLocal, false);
+            TarSource(FileName, ChildDestName, Index, ChildRec, CopyParam, OperationProgress, Items);
+          }
+          catch (ESkipFile &E)
+          {
+            // If ESkipFile occurs, just log it and continue with next file
+            TSuspendFileOperationProgress Suspend(OperationProgress);
+            if (!FTerminal->HandleException(&E))
+            {
+              throw;
+            }
+          }
+        }
+        FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(LIST_DIR_ERROR, AFileName), "",
+        [&]()
+        {
+          FindOK = (::FindNextChecked(ChildRec) == 0);
+        });
+      }
+    }
+    __finally
+    {
+#if 0
+      FindClose(ChildRec);
+#endif // #if 0
+    };
+  }
+}
+
+void TSCPFileSystem::TarCopyToLocal(const TStrings *AFilesToCopy,
+  UnicodeString TargetDir, const TCopyParamType *CopyParam,
+  intptr_t /*Params*/, TFileOperationProgressType *OperationProgress,
+  TOnceDoneOperation &OnceDoneOperation)
+{
+  DebugAssert(AFilesToCopy && OperationProgress);
+
+  intptr_t Count = AFilesToCopy->GetCount();
+  FTerminal->LogEvent(FORMAT("Copying %d files/directories to local directory "
+      "\"%s\" as tar archive", Count, TargetDir));
+  FTerminal->LogEvent(CopyParam->GetLogStr());
+
+  const TSessionData *Data = FTerminal->GetSessionData();
+  rde::vector<bool> Failed(Count);
+  bool Success = false;
+
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      for (intptr_t Index = 0; Index < Count; ++Index)
+      {
+        OperationProgress->Finish(AFilesToCopy->GetString(Index),
+          Success && !Failed[Index], OnceDoneOperation);
+      }
+    };
+
+    // Names of the requested files (the only top-level entries
+    // accepted from the archive) and their local counterparts
+    std::unique_ptr<TStringList> Names(new TStringList());
+    Names->SetCaseSensitive(true);
+    std::unique_ptr<TStringList> LocalNames(new TStringList());
+    UnicodeString SourceDir;
+    UnicodeString Files;
+    for (intptr_t Index = 0; Index < Count; ++Index)
+    {
+      const TRemoteFile *File = AFilesToCopy->GetAs<TRemoteFile>(Index);
+      DebugAssert(File);
+      UnicodeString FullFileName = base::UnixExcludeTrailingBackslash(File->GetFullFileName());
+      // all files are in the same directory, see CanTarTransfer
+      SourceDir = base::UnixExtractFilePath(FullFileName);
+      UnicodeString Name = base::UnixExtractFileName(FullFileName);
+      Names->Add(Name);
+      UnicodeString TargetDirectory = CreateTargetDirectory(File->GetFileName(), TargetDir, CopyParam);
+      LocalNames->Add(::IncludeTrailingBackslash(TargetDirectory) +
+        FTerminal->ChangeFileName(CopyParam, Name, osRemote, true));
+      AddToList(Files, L"\"" + DelimitStr(Name) + L"\"", L" ");
+    }
+
+    bool Compressed = Data->GetSCPTarCompression() && FTarGzip;
+    UnicodeString Options = Compressed ? L"-z" : L"";
+    UnicodeString DelimitedSourceDir = DelimitStr(base::UnixExcludeTrailingBackslash(SourceDir));
+    UnicodeString Command =
+      FCommandSet->Command(fsTarToLocal, DelimitedSourceDir, FCommandSet->GetFirstLine(), Options, Files);
+    SendCommand(FCommandSet->FullCommand(fsTarToLocal,
+      DelimitedSourceDir, FCommandSet->GetFirstLine(), Options, Files));
+    TarStarted(Command);
+
+    // When tar cannot start at all (none of the files can be read),
+    // only the last line comes
+    const char *LastLine = LAST_LINE;
+    intptr_t LastLineLength = static_cast<intptr_t>(strlen(LastLine));
+    RawByteString Head;
+    uint8_t Ch = 0;
+    do
+    {
+      FSecureShell->Receive(&Ch, 1);
+      Head += static_cast<char>(Ch);
+    }
+    while ((Head.Length() < LastLineLength) && (Ch == static_cast<uint8_t>(LastLine[Head.Length() - 1])));
+
+    if (Head == LastLine)
+    {
+      UnicodeString Line = FSecureShell->ConvertInput(Head) + FSecureShell->ReceiveLine();
+      if (IsLastLine(Line))
+      {
+        ReadCommandOutput(coRaiseExcept, &Command);
+      }
+      FTerminal->TerminalError(LoadStr(SCP_INIT_ERROR));
+    }
+
+    uintptr_t CodePage = Data->GetCodePageAsNumber();
+    TTarReader Reader(Compressed);
+    Reader.Feed(reinterpret_cast<const uint8_t *>(Head.c_str()), Head.Length());
+
+    // Maps an archive name to the remote and the local file name,
+    // failing for names outside of the requested files.
+    // Entries come grouped by the top-level file, so its lookup is cached.
+    UnicodeString TopName;
+    intptr_t TopIndex = -1;
+    auto MapName = [&](const RawByteString &Name, intptr_t &Index,
+      UnicodeString &RemoteName, UnicodeString &LocalName) -> bool
+    {
+      UnicodeString Path = FSecureShell->ConvertInput(Name, CodePage);
+      bool Result = true;
+      Index = -1;
+      while (Result && !Path.IsEmpty())
+      {
+        UnicodeString Part = CutToChar(Path, L'/', false);
+        if (Part.IsEmpty() || (Part == THISDIRECTORY))
+        {
+          continue;
+        }
+        else if (Part == PARENTDIRECTORY)
+        {
+          Result = false;
+        }
+        else if (Index < 0)
+        {
+          if ((TopIndex < 0) || (Part != TopName))
+          {
+            TopName = Part;
+            TopIndex = Names->IndexOf(Part);
+          }
+          Index = TopIndex;
+          Result = (Index >= 0);
+          if (Result)
+          {
+            RemoteName = SourceDir + Part;
+            LocalName = LocalNames->GetString(Index);
+          }
+        }
+        else
+        {
+          RemoteName = base::UnixIncludeTrailingBackslash(RemoteName) + Part;
+          LocalName = ::IncludeTrailingBackslash(LocalName) +
+            FTerminal->ChangeFileName(CopyParam, Part, osRemote, false);
+        }
+      }
+      return Result && (Index >= 0);
+    };
+
+    HANDLE LocalFileHandle = INVALID_HANDLE_VALUE;
+    std::unique_ptr<TSafeHandleStream> FileStream;
+    std::unique_ptr<TDownloadSessionAction> Action;
+    UnicodeString DestFileName;
+    TTarEntry FileEntry;
+    intptr_t FileIndex = -1;
+
+    auto CloseFile = [&]()
+    {
+      if (FileStream.get() != nullptr)
+      {
+        if (CopyParam->GetPreserveTime())
+        {
+          FILETIME WrTime = ::DateTimeToFileTime(::UnixToDateTime(FileEntry.MTime,
+            Data->GetDSTMode()), Data->GetDSTMode());
+          SetFileTime(LocalFileHandle, nullptr, &WrTime, &WrTime);
+        }
+        FileStream.reset();
+        SAFE_CLOSE_HANDLE(LocalFileHandle);
+        Action.reset();
+
+        try
+        {
+          DWORD NewAttrs = CopyParam->LocalFileAttrs(TRights(static_cast<uint16_t>(FileEntry.Mode & 07777)));
+          if (NewAttrs != 0)
+          {
+            FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(CANT_SET_ATTRS, DestFileName), "",
+            [&]()
+            {
+              DWORD LocalFileAttrs = FTerminal->GetLocalFileAttributes(ApiPath(DestFileName));
+              THROWOSIFFALSE((LocalFileAttrs != INVALID_FILE_ATTRIBUTES) &&
+                FTerminal->SetLocalFileAttributes(ApiPath(DestFileName), LocalFileAttrs | NewAttrs));
+            });
+          }
+        }
+        catch (ESkipFile &E)
+        {
+          Failed[FileIndex] = true;
+          TSuspendFileOperationProgress Suspend(OperationProgress);
+          if (!FTerminal->HandleException(&E))
+          {
+            throw;
+          }
+        }
+
+        FTerminal->LogFileDone(OperationProgress, DestFileName);
+      }
+    };
+
+    try__finally
+    {
+      SCOPE_EXIT
+      {
+        FileStream.reset();
+        SAFE_CLOSE_HANDLE(LocalFileHandle);
+      };
+
+      // Whatever goes wrong, the rest of the archive cannot be skipped
+      try
+      {
+        rde::vector<uint8_t> Buffer(TFileOperationProgressType::StaticBlockSize());
+        // Contents of excluded directory are skipped
+        UnicodeString ExcludedDir;
+        bool End = false;
+        while (!End)
+        {
+          const uint8_t *Block = nullptr;
+          intptr_t BlockLength = 0;
+          TTarToken Token;
+          while (!End && ((Token = Reader.Read(Block, BlockLength)) != ttNone))
+          {
+            switch (Token)
+            {
+            case ttEntry:
+              {
+                CloseFile();
+
+                const TTarEntry &Entry = Reader.GetEntry();
+                bool Dir = (Entry.Type == tetDirectory);
+                intptr_t Index = -1;
+                UnicodeString AbsoluteFileName;
+                UnicodeString LocalName;
+                try
+                {
+                  if (!MapName(Entry.Name, Index, AbsoluteFileName, LocalName))
+                  {
+                    // Same check as with scp (CVE-2019-6111)
+                    AbsoluteFileName = FSecureShell->ConvertInput(Entry.Name, CodePage);
+                    ThrowFileSkipped(nullptr, LoadStr(UNREQUESTED_FILE));
+                  }
+
+                  if (!ExcludedDir.IsEmpty() &&
+                      (AbsoluteFileName.SubString(1, ExcludedDir.Length()) == ExcludedDir))
+                  {
+                    break;
+                  }
+
+                  OperationProgress->SetFile(AbsoluteFileName, false);
+
+                  TFileMasks::TParams MaskParams;
+                  MaskParams.Size = Entry.Size;
+                  MaskParams.Modification = ::UnixToDateTime(Entry.MTime, Data->GetDSTMode());
+                  UnicodeString BaseFileName = FTerminal->GetBaseFileName(AbsoluteFileName);
+                  if (!CopyParam->AllowTransfer(BaseFileName, osRemote, Dir, MaskParams))
+                  {
+                    FTerminal->LogEvent(FORMAT("File \"%s\" excluded from transfer",
+                        AbsoluteFileName));
+                    ThrowSkipFileNull();
+                  }
+                  if (CopyParam->SkipTransfer(AbsoluteFileName, Dir))
+                  {
+                    OperationProgress->AddSkippedFileSize(MaskParams.Size);
+                    ThrowSkipFileNull();
+                  }
+
+                  FTerminal->LogFileDetails(AbsoluteFileName, MaskParams.Modification, MaskParams.Size);
+
+                  if (Dir)
+                  {
+                    DWORD LocalFileAttrs = FTerminal->GetLocalFileAttributes(ApiPath(LocalName));
+                    if (LocalFileAttrs == INVALID_FILE_ATTRIBUTES)
+                    {
+                      FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(CREATE_DIR_ERROR, LocalName), "",
+                      [&]()
+                      {
+                        THROWOSIFFALSE(::ForceDirectories(ApiPath(LocalName)));
+                      });
+                    }
+                    else if (FLAGCLEAR(LocalFileAttrs, faDirectory))
+                    {
+                      ThrowFileSkipped(nullptr, FMTLOAD(NOT_DIRECTORY_ERROR, LocalName));
+                    }
+                  }
+                  else if (Entry.Type == tetFile)
+                  {
+                    Action.reset(new TDownloadSessionAction(FTerminal->GetActionLog()));
+                    Action->SetFileName(AbsoluteFileName);
+                    Action->Destination(LocalName);
+
+                    if (!FTerminal->TerminalCreateLocalFile(LocalName, OperationProgress,
+                        false, true, &LocalFileHandle))
+                    {
+                      ThrowSkipFileNull();
+                    }
+                    FileStream.reset(new TSafeHandleStream(LocalFileHandle));
+                    DestFileName = LocalName;
+                    FileEntry = Entry;
+                    FileIndex = Index;
+
+                    OperationProgress->SetFileInProgress();
+                    OperationProgress->SetTransferSize(Entry.Size);
+                    OperationProgress->SetLocalSize(Entry.Size);
+                    OperationProgress->SetAsciiTransfer(false);
+                  }
+                  else if (Entry.Type == tetHardLink)
+                  {
+                    // Hard links (to files earlier in the archive) are made copies
+                    intptr_t LinkIndex = -1;
+                    UnicodeString LinkRemoteName;
+                    UnicodeString LinkLocalName;
+                    if (!MapName(Entry.LinkName, LinkIndex, LinkRemoteName, LinkLocalName) ||
+                        !::FileExists(ApiPath(LinkLocalName)))
+                    {
+                      ThrowFileSkipped(nullptr, FMTLOAD(FILE_NOT_EXISTS,
+                        FSecureShell->ConvertInput(Entry.LinkName, CodePage)));
+                    }
+                    FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(CREATE_FILE_ERROR, LocalName), "",
+                    [&]()
+                    {
+                      THROWOSIFFALSE(::CopyFile(ApiPath(LinkLocalName).c_str(), ApiPath(LocalName).c_str(), FALSE));
+                    });
+                    FTerminal->LogFileDone(OperationProgress, LocalName);
+                  }
+                  else
+                  {
+                    FTerminal->LogEvent(FORMAT("Special file \"%s\" skipped.", AbsoluteFileName));
+                    ThrowSkipFileNull();
+                  }
+                }
+                catch (ESkipFile &E)
+                {
+                  // Including the EFileSkipped, the error is shown, but the transfer goes on
+                  if (Action.get() != nullptr)
+                  {
+                    Action->Cancel();
+                    Action.reset();
+                  }
+                  if (Index >= 0)
+                  {
+                    Failed[Index] = true;
+                  }
+                  if (Dir)
+                  {
+                    ExcludedDir = base::UnixIncludeTrailingBackslash(AbsoluteFileName);
+                  }
+
+                  TSuspendFileOperationProgress Suspend(OperationProgress);
+                  if (isa<EFileSkipped>(&E))
+                  {
+                    TQueryParams QueryParams(qpAllowContinueOnError);
+                    if (FTerminal->QueryUserException(FMTLOAD(COPY_ERROR, AbsoluteFileName),
+                        &E, qaOK | qaAbort, &QueryParams, qtError) == qaAbort)
+                    {
+                      OperationProgress->SetCancel(csCancel);
+                    }
+                    FTerminal->GetLog()->AddException(&E);
+                  }
+                  else if (!FTerminal->HandleException(&E))
+                  {
+                    throw;
+                  }
+                }
+              }
+              break;
+
+            case ttData:
+              if (FileStream.get() != nullptr)
+              {
+                FileOperationLoopCustom(FTerminal, OperationProgress, False,
+                  FMTLOAD(WRITE_ERROR, DestFileName), "",
+                [&]()
+                {
+                  FileStream->WriteBuffer(Block, BlockLength);
+                });
+                OperationProgress->AddTransferred(BlockLength);
+                OperationProgress->AddLocallyUsed(BlockLength);
+              }
+              break;
+
+            case ttEnd:
+              CloseFile();
+              End = true;
+              break;
+
+            default:
+              DebugFail();
+              break;
+            }
+          }
+
+          if (!End)
+          {
+            if (OperationProgress->GetCancel())
+            {
+              throw Exception(MainInstructions(LoadStr(USER_TERMINATED)));
+            }
+            intptr_t Received = FSecureShell->ReceiveAvailable(Buffer.data(), static_cast<intptr_t>(Buffer.size()));
+            OperationProgress->ThrottleToCPSLimit(Received);
+            Reader.Feed(Buffer.data(), Received);
+          }
+        }
+      }
+      catch (Exception &E)
+      {
+        if (Action.get() != nullptr)
+        {
+          FTerminal->RollbackAction(*Action, OperationProgress, &E);
+        }
+        FTerminal->FatalError(&E, FMTLOAD(COPY_FATAL, OperationProgress->GetFileName()));
+      }
+    }
+    __finally
+    {
+#if 0
+      delete FileStream;
+      if (LocalFileHandle != INVALID_HANDLE_VALUE) CloseHandle(LocalFileHandle);
+#endif // #if 0
+    };
+
+    // tar pads the archive to its record size, the last line follows
+    RawByteString Rest = Reader.GetTrailer();
+    intptr_t Zeros = 0;
+    while ((Zeros < Rest.Length()) && (Rest.c_str()[Zeros] == '\0'))
+    {
+      ++Zeros;
+    }
+    Rest.Delete(1, Zeros);
+    while (Rest.IsEmpty())
+    {
+      FSecureShell->Receive(&Ch, 1);
+      if (Ch != '\0')
+      {
+        Rest += static_cast<char>(Ch);
+      }
+    }
+    UnicodeString Line = FSecureShell->ConvertInput(Rest, CodePage);
+    intptr_t P = Line.Pos(L"\n");
+    if (P > 0)
+    {
+      Line.SetLength(P - 1);
+    }
+    else
+    {
+      Line += FSecureShell->ReceiveLine();
+    }
+    bool IsLast = IsLastLine(Line);
+    // tar returns 1 for files changed while being read
+    ReadCommandOutput(coRaiseExcept | coIgnoreWarnings | (IsLast ? 0 : coWaitForLastLine), &Command);
+    Success = !OperationProgress->GetCancel();
+  }
+  __finally
+  {
+#if 0
+    for (int Index = 0; Index < Count; Index++)
+    {
+      OperationProgress->Finish(AFilesToCopy->Strings[Index],
+        Success && !Failed[Index], OnceDoneOperation);
+    }
+#endif // #if 0
+  };
+}
+
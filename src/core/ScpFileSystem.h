@@ -1,11 +1,13 @@
 
 #pragma once
 
+#include <rdestl/vector.h>
 #include <FileSystems.h>
 #include <CopyParam.h>
 
 class TCommandSet;
 class TSecureShell;
+struct TTarSourceItem;
 
 class TSCPFileSystem : public TCustomFileSystem
 {
@@ -79,6 +81,8 @@ public:
   virtual void LockFile(UnicodeString AFileName, const TRemoteFile *AFile) override;
   virtual void UnlockFile(UnicodeString AFileName, const TRemoteFile *AFile) override;
   virtual void UpdateFromMain(TCustomFileSystem *MainFileSystem) override;
+  virtual void BeginDirectoryTree() override;
+  virtual void EndDirectoryTree() override;
 
 protected:
 #if 0
@@ -100,6 +104,8 @@ private:
   UnicodeString FCachedDirectoryChange;
   bool FProcessingCommand;
   int FLsFullTime;
+  TAutoSwitch FTarTransfer;
+  bool FTarGzip;
   TCaptureOutputEvent FOnCaptureOutput;
   bool FScpFatalError;
 
@@ -134,6 +140,8 @@ private:
     const TRemoteFile *AFile,
     const TCopyParamType *CopyParam, bool &Success,
     TFileOperationProgressType *OperationProgress, intptr_t Params, intptr_t Level);
+  void SCPSinkDirectory(const TRemoteFile *AFile, UnicodeString TargetDir,
+    const TCopyParamType *CopyParam, TFileOperationProgressType *OperationProgress);
   void SCPSource(UnicodeString AFileName,
     const TRemoteFile *AFile,
     const UnicodeString TargetDir, const TCopyParamType *CopyParam, intptr_t Params,
@@ -156,5 +164,22 @@ private:
   static bool RemoveLastLine(UnicodeString &Line,
     intptr_t &ReturnCode, UnicodeString ALastLine = L"");
   UnicodeString InitOptionsStr(const TCopyParamType *CopyParam) const;
+
+  bool CanTarTransfer(const TStrings *AFilesToCopy, bool ToRemote,
+    const TCopyParamType *CopyParam, intptr_t Params,
+    TFileOperationProgressType *OperationProgress);
+  void DetectTar();
+  void TarStarted(UnicodeString Command);
+  void TarCopyToRemote(const TStrings *AFilesToCopy,
+    UnicodeString TargetDir, const TCopyParamType *CopyParam,
+    intptr_t Params, TFileOperationProgressType *OperationProgress,
+    TOnceDoneOperation &OnceDoneOperation);
+  void TarSource(UnicodeString AFileName, UnicodeString DestName, intptr_t Index,
+    const TSearchRecChecked &SearchRec, const TCopyParamType *CopyParam,
+    TFileOperationProgressType *OperationProgress, rde::vector<TTarSourceItem> &Items);
+  void TarCopyToLocal(const TStrings *AFilesToCopy,
+    UnicodeString TargetDir, const TCopyParamType *CopyParam,
+    intptr_t Params, TFileOperationProgressType *OperationProgress,
+    TOnceDoneOperation &OnceDoneOperation);
 };
 
@@ -47,6 +47,8 @@ TSecureShell::TSecureShell(TSessionUI *UI,
   FUtfStrings = false;
   FLastSendBufferUpdate = 0;
   FSendBuf = 0;
+  FOpenTicks = 0;
+  FHostKeyTicks = 0;
   FActive = false;
   FSessionInfoValid = false;
   FBackend = nullptr;
@@ -61,7 +63,7 @@ TSecureShell::TSecureShell(TSessionUI *UI,
   FOnCaptureOutput = nullptr;
   FOnReceive = nullptr;
   FSocket = INVALID_SOCKET;
-  FSocketEvent = ::CreateEvent(nullptr, false, false, nullptr);
+  FReactor = TSocketReactor::Create();
   FFrozen = false;
   FDataWhileFrozen = false;
   FSshVersion = 0;
@@ -78,7 +80,7 @@ TSecureShell::~TSecureShell()
   DebugAssert(FWaiting == 0);
   SetActive(false);
   ResetConnection();
-  SAFE_CLOSE_HANDLE(FSocketEvent);
+  SAFE_DESTROY(FReactor);
 }
 
 void TSecureShell::ResetConnection()
@@ -442,6 +444,8 @@ void TSecureShell::Open()
   FAuthenticated = false;
   FLastSendBufferUpdate = 0;
   FSendBuf = 0;
+  FOpenTicks = ::GetTickCount();
+  FHostKeyTicks = FOpenTicks;
 
   // do not use UTF-8 until decided otherwise (see TSCPFileSystem::DetectUtf())
   FUtfStrings = false;
@@ -510,6 +514,13 @@ void TSecureShell::Open()
   FAuthenticated = true;
   FUI->Information(LoadStr(STATUS_AUTHENTICATED), true);
 
+  // handshake timing, to compare costs of key exchange and authentication
+  // algorithms (logged above by PuTTY); includes network round trips and
+  // any time spent in prompts
+  DWORD Ticks = ::GetTickCount();
+  LogEvent(FORMAT("Connection and key exchange took %d ms, authentication took %d ms",
+    ToInt(FHostKeyTicks - FOpenTicks), ToInt(Ticks - FHostKeyTicks)));
+
   ResetSessionInfo();
 
   DebugAssert(!FSessionInfo.SshImplementation.IsEmpty());
@@ -1002,6 +1013,7 @@ void TSecureShell::GotHostKey()
   if (!FAuthenticating && !FAuthenticated)
   {
     FAuthenticating = true;
+    FHostKeyTicks = ::GetTickCount();
     if (!FSessionData->GetChangePassword())
     {
       FUI->Information(LoadStr(STATUS_AUTHENTICATE), true);
@@ -1224,6 +1236,18 @@ intptr_t TSecureShell::Receive(uint8_t *Buf, intptr_t Length)
   return Length;
 }
 
+// Returns what has been received already (up to MaxLength),
+// waits only if nothing has
+intptr_t TSecureShell::ReceiveAvailable(uint8_t *Buf, intptr_t MaxLength)
+{
+  intptr_t Length = std::min(PendLen, MaxLength);
+  if (Length <= 0)
+  {
+    Length = std::min(static_cast<intptr_t>(1), MaxLength);
+  }
+  return Receive(Buf, Length);
+}
+
 UnicodeString TSecureShell::ReceiveLine()
 {
   RawByteString Line;
@@ -1427,18 +1451,24 @@ void TSecureShell::SendNull()
   Send(&Null, 1);
 }
 
-void TSecureShell::SendLine(UnicodeString Line)
+RawByteString TSecureShell::ConvertOutput(UnicodeString Output) const
 {
-  CheckConnection();
-  RawByteString Str;
+  RawByteString Result;
   if (GetUtfStrings())
   {
-    Str = RawByteString(UTF8String(Line));
+    Result = RawByteString(UTF8String(Output));
   }
   else
   {
-    Str = RawByteString(AnsiString(::W2MB(Line.c_str(), static_cast<UINT>(FSessionData->GetCodePageAsNumber()))));
+    Result = RawByteString(AnsiString(::W2MB(Output.c_str(), static_cast<UINT>(FSessionData->GetCodePageAsNumber()))));
   }
+  return Result;
+}
+
+void TSecureShell::SendLine(UnicodeString Line)
+{
+  CheckConnection();
+  RawByteString Str = ConvertOutput(Line);
   Str += "\n";
 
   // FLog->Add(llInput, Line);
@@ -1627,7 +1657,7 @@ void TSecureShell::LogEvent(UnicodeString AStr)
   }
 }
 
-void TSecureShell::SocketEventSelect(SOCKET Socket, HANDLE Event, bool Startup)
+void TSecureShell::SocketEventSelect(SOCKET Socket, bool Startup)
 {
   int Events;
 
@@ -1645,7 +1675,7 @@ void TSecureShell::SocketEventSelect(SOCKET Socket, HANDLE Event, bool Startup)
     LogEvent(FORMAT("Selecting events %d for socket %d", ToInt(Events), ToInt(Socket)));
   }
 
-  if (::WSAEventSelect(Socket, static_cast<WSAEVENT>(Event), Events) == SOCKET_ERROR)
+  if (!FReactor->SelectEvents(Socket, Events))
   {
     if (GetConfiguration()->GetActualLogProtocol() >= 2)
     {
@@ -1654,7 +1684,7 @@ void TSecureShell::SocketEventSelect(SOCKET Socket, HANDLE Event, bool Startup)
 
     if (Startup)
     {
-      FatalError(FMTLOAD(EVENT_SELECT_ERROR, ::WSAGetLastError()));
+      FatalError(FMTLOAD(EVENT_SELECT_ERROR, FReactor->GetLastError()));
     }
   }
 }
@@ -1663,12 +1693,16 @@ void TSecureShell::UpdateSocket(SOCKET Value, bool Startup)
 {
   if (!FActive && !Startup)
   {
-    // no-op
     // Remove the branch eventually:
     // When TCP connection fails, PuTTY does not release the memory allocated for
     // socket. As a simple hack we call sk_tcp_close() in ssh.c to release the memory,
     // until they fix it better. Unfortunately sk_tcp_close calls do_select,
     // so we must filter that out.
+    // Still let the reactor forget the socket, it is being closed.
+    if (Value != INVALID_SOCKET)
+    {
+      FReactor->SelectEvents(Value, 0);
+    }
   }
   else
   {
@@ -1678,7 +1712,7 @@ void TSecureShell::UpdateSocket(SOCKET Value, bool Startup)
     // filter our "local proxy" connection, which have no socket
     if (Value != INVALID_SOCKET)
     {
-      SocketEventSelect(Value, FSocketEvent, Startup);
+      SocketEventSelect(Value, Startup);
     }
     else
     {
@@ -1705,7 +1739,7 @@ void TSecureShell::UpdatePortFwdSocket(SOCKET Value, bool Startup)
     LogEvent(FORMAT("Updating forwarding socket %d (%d)", ToInt(Value), ToInt(Startup)));
   }
 
-  SocketEventSelect(Value, FSocketEvent, Startup);
+  SocketEventSelect(Value, Startup);
 
   if (Startup)
   {
@@ -1797,7 +1831,7 @@ void inline TSecureShell::CheckConnection(int Message)
   }
 }
 
-void TSecureShell::PoolForData(WSANETWORKEVENTS &Events, intptr_t &Result)
+void TSecureShell::PoolForData(TNetworkEvents &Events, intptr_t &Result)
 {
   if (!GetActive())
   {
@@ -1839,7 +1873,7 @@ class TPoolForDataEvent : public TObject
 {
   NB_DISABLE_COPY(TPoolForDataEvent)
 public:
-  TPoolForDataEvent(TSecureShell *SecureShell, WSANETWORKEVENTS &Events) :
+  TPoolForDataEvent(TSecureShell *SecureShell, TNetworkEvents &Events) :
     FSecureShell(SecureShell),
     FEvents(Events)
   {
@@ -1852,7 +1886,7 @@ public:
 
 private:
   TSecureShell *FSecureShell;
-  WSANETWORKEVENTS &FEvents;
+  TNetworkEvents &FEvents;
 };
 
 void TSecureShell::WaitForData()
@@ -1873,7 +1907,7 @@ void TSecureShell::WaitForData()
       DebugAssert(FWaitingForData == 0);
       TAutoNestingCounter NestingCounter(FWaitingForData);
 
-      WSANETWORKEVENTS Events;
+      TNetworkEvents Events;
       ClearStruct(Events);
       TPoolForDataEvent Event(this, Events);
 
@@ -1911,7 +1945,7 @@ bool TSecureShell::SshFallbackCmd() const
   return ssh_fallback_cmd(FBackendHandle) != 0;
 }
 
-bool TSecureShell::EnumNetworkEvents(SOCKET Socket, WSANETWORKEVENTS &Events)
+bool TSecureShell::EnumNetworkEvents(SOCKET Socket, TNetworkEvents &Events)
 {
   if (GetConfiguration()->GetActualLogProtocol() >= 2)
   {
@@ -1919,25 +1953,16 @@ bool TSecureShell::EnumNetworkEvents(SOCKET Socket, WSANETWORKEVENTS &Events)
   }
 
   // see winplink.c
-  WSANETWORKEVENTS AEvents;
-  if (::WSAEnumNetworkEvents(Socket, nullptr, &AEvents) == 0)
+  long EventsBefore = Events.lNetworkEvents;
+  if (FReactor->EnumEvents(Socket, Events))
   {
     noise_ultralight(static_cast<uint32_t>(Socket));
-    noise_ultralight(AEvents.lNetworkEvents);
-
-    Events.lNetworkEvents |= AEvents.lNetworkEvents;
-    for (intptr_t Index = 0; Index < FD_MAX_EVENTS; ++Index)
-    {
-      if (AEvents.iErrorCode[Index] != 0)
-      {
-        Events.iErrorCode[Index] = AEvents.iErrorCode[Index];
-      }
-    }
+    noise_ultralight(Events.lNetworkEvents);
 
     if (GetConfiguration()->GetActualLogProtocol() >= 2)
     {
       LogEvent(FORMAT("Enumerated %d network events making %d cumulative events for socket %d",
-          ToInt(AEvents.lNetworkEvents), ToInt(Events.lNetworkEvents), ToInt(Socket)));
+          ToInt(Events.lNetworkEvents & ~EventsBefore), ToInt(Events.lNetworkEvents), ToInt(Socket)));
     }
   }
   else
@@ -1953,7 +1978,7 @@ bool TSecureShell::EnumNetworkEvents(SOCKET Socket, WSANETWORKEVENTS &Events)
     FLAGSET(Events.lNetworkEvents, FD_CLOSE);
 }
 
-void TSecureShell::HandleNetworkEvents(SOCKET Socket, WSANETWORKEVENTS &Events)
+void TSecureShell::HandleNetworkEvents(SOCKET Socket, TNetworkEvents &Events)
 {
   static const struct
   {
@@ -1991,7 +2016,7 @@ void TSecureShell::HandleNetworkEvents(SOCKET Socket, WSANETWORKEVENTS &Events)
 
 bool TSecureShell::ProcessNetworkEvents(SOCKET Socket)
 {
-  WSANETWORKEVENTS Events;
+  TNetworkEvents Events;
   ClearStruct(Events);
   bool Result = EnumNetworkEvents(Socket, Events);
   HandleNetworkEvents(Socket, Events);
@@ -1999,7 +2024,7 @@ bool TSecureShell::ProcessNetworkEvents(SOCKET Socket)
 }
 
 bool TSecureShell::EventSelectLoop(uintptr_t MSec, bool ReadEventRequired,
-  WSANETWORKEVENTS *Events)
+  TNetworkEvents *Events)
 {
   CheckConnection();
 
@@ -2023,33 +2048,31 @@ bool TSecureShell::EventSelectLoop(uintptr_t MSec, bool ReadEventRequired,
       {
         sfree(Handles);
       };
-      size_t n = static_cast<size_t>(HandleCount + 1);
-      Handles = sresize(Handles, n, HANDLE);
-      Handles[HandleCount] = FSocketEvent;
       intptr_t Timeout = static_cast<intptr_t>(MSec);
       if (toplevel_callback_pending())
       {
         Timeout = 0;
       }
 
-      uint32_t WaitResult;
+      TReactorWaitResult WaitResult;
+      intptr_t Signalled;
       do
       {
         uint32_t TimeoutStep = Min(GUIUpdateInterval, static_cast<uint32_t>(Timeout));
         Timeout -= TimeoutStep;
-        WaitResult = ::WaitForMultipleObjects(HandleCount + 1, Handles, FALSE, TimeoutStep);
+        WaitResult = FReactor->Wait(TimeoutStep, Handles, HandleCount, Signalled);
         FUI->ProcessGUI();
       }
-      while ((WaitResult == WAIT_TIMEOUT) && (Timeout > 0));
+      while ((WaitResult == rwTimeout) && (Timeout > 0));
 
-      if (WaitResult < WAIT_OBJECT_0 + HandleCount)
+      if (WaitResult == rwHandle)
       {
-        if (handle_got_event(Handles[WaitResult - WAIT_OBJECT_0]))
+        if (handle_got_event(Handles[Signalled]))
         {
           Result = true;
         }
       }
-      else if (WaitResult == WAIT_OBJECT_0 + HandleCount)
+      else if (WaitResult == rwNetwork)
       {
         if (GetConfiguration()->GetActualLogProtocol() >= 1)
         {
@@ -2080,7 +2103,7 @@ bool TSecureShell::EventSelectLoop(uintptr_t MSec, bool ReadEventRequired,
           }
         }
       }
-      else if (WaitResult == WAIT_TIMEOUT)
+      else if (WaitResult == rwTimeout)
       {
         if (GetConfiguration()->GetActualLogProtocol() >= 2)
         {
@@ -2095,7 +2118,7 @@ bool TSecureShell::EventSelectLoop(uintptr_t MSec, bool ReadEventRequired,
       {
         if (GetConfiguration()->GetActualLogProtocol() >= 2)
         {
-          LogEvent(FORMAT("Unknown waiting result %d", ToInt(WaitResult)));
+          LogEvent(FORMAT("Error waiting for network events %d", FReactor->GetLastError()));
         }
 
         MSec = 0;
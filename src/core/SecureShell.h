@@ -6,15 +6,13 @@
 #include "Configuration.h"
 #include "SessionData.h"
 #include "SessionInfo.h"
+#include "SocketReactor.h"
 
 #ifndef PuttyIntfH
 struct Backend;
 struct Conf;
 #endif
 
-struct _WSANETWORKEVENTS;
-typedef struct _WSANETWORKEVENTS WSANETWORKEVENTS;
-typedef UINT_PTR SOCKET;
 typedef rde::vector<SOCKET> TSockets;
 struct TPuttyTranslation;
 
@@ -38,7 +36,7 @@ public:
   virtual bool is(TObjectClassId Kind) const override { return (Kind == OBJECT_CLASS_TSecureShell) || TObject::is(Kind); }
 private:
   SOCKET FSocket;
-  HANDLE FSocketEvent;
+  TSocketReactor *FReactor;
   TSockets FPortFwdSockets;
   TSessionUI *FUI;
   TSessionData *FSessionData;
@@ -83,6 +81,8 @@ private:
   bool FUtfStrings;
   DWORD FLastSendBufferUpdate;
   intptr_t FSendBuf;
+  DWORD FOpenTicks;
+  DWORD FHostKeyTicks;
 
 public:
   static TCipher FuncToSsh1Cipher(const void *Cipher);
@@ -94,17 +94,17 @@ public:
   void WaitForData();
   void Discard();
   void FreeBackend();
-  void PoolForData(WSANETWORKEVENTS &Events, intptr_t &Result);
+  void PoolForData(TNetworkEvents &Events, intptr_t &Result);
   inline void CaptureOutput(TLogLineType Type,
     UnicodeString Line);
   void ResetConnection();
   void ResetSessionInfo();
-  void SocketEventSelect(SOCKET Socket, HANDLE Event, bool Startup);
-  bool EnumNetworkEvents(SOCKET Socket, WSANETWORKEVENTS &Events);
-  void HandleNetworkEvents(SOCKET Socket, WSANETWORKEVENTS &Events);
+  void SocketEventSelect(SOCKET Socket, bool Startup);
+  bool EnumNetworkEvents(SOCKET Socket, TNetworkEvents &Events);
+  void HandleNetworkEvents(SOCKET Socket, TNetworkEvents &Events);
   bool ProcessNetworkEvents(SOCKET Socket);
   bool EventSelectLoop(uintptr_t MSec, bool ReadEventRequired,
-    WSANETWORKEVENTS *Events);
+    TNetworkEvents *Events);
   void UpdateSessionInfo() const;
   bool GetReady() const;
   void DispatchSendBuffer(intptr_t BufSize);
@@ -112,6 +112,7 @@ public:
   uintptr_t TimeoutPrompt(TQueryParamsTimerEvent PoolEvent);
   bool TryFtp();
   UnicodeString ConvertInput(RawByteString Input, uintptr_t CodePage = CP_ACP) const;
+  RawByteString ConvertOutput(UnicodeString Output) const;
   void GetRealHost(UnicodeString &Host, intptr_t &Port) const;
   UnicodeString RetrieveHostKey(UnicodeString Host, intptr_t Port, const UnicodeString KeyType) const;
 
@@ -138,6 +139,7 @@ public:
   void Close();
   void KeepAlive();
   intptr_t Receive(uint8_t *Buf, intptr_t Length);
+  intptr_t ReceiveAvailable(uint8_t *Buf, intptr_t MaxLength);
   bool Peek(uint8_t *&Buf, intptr_t Length) const;
   UnicodeString ReceiveLine();
   void Send(const uint8_t *Buf, intptr_t Length);
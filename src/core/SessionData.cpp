@@ -223,6 +223,8 @@ void TSessionData::Default()
   SetTimeDifference(TDateTime(0.0));
   SetTimeDifferenceAuto(true);
   SetSCPLsFullTime(asAuto);
+  SetSCPTarTransfer(asAuto);
+  SetSCPTarCompression(false);
   SetNotUtf(asOn); // asAuto
 
   // SFTP
@@ -267,6 +269,7 @@ void TSessionData::Default()
   SetFtpDeleteFromCwd(asAuto);
   SetSslSessionReuse(true);
   SetTlsCertificateFile(L"");
+  SetWebDavLockDiscovery(false);
 
   SetFtpProxyLogonType(0); // none
 
@@ -359,6 +362,8 @@ void TSessionData::NonPersistant()
   PROPERTY(ListingCommand); \
   PROPERTY(IgnoreLsWarnings); \
   PROPERTY(SCPLsFullTime); \
+  PROPERTY(SCPTarTransfer); \
+  PROPERTY(SCPTarCompression); \
   \
   PROPERTY(TimeDifference); \
   PROPERTY(TimeDifferenceAuto); \
@@ -416,6 +421,7 @@ void TSessionData::NonPersistant()
   PROPERTY(FtpDeleteFromCwd); \
   PROPERTY(SslSessionReuse); \
   PROPERTY(TlsCertificateFile); \
+  PROPERTY(WebDavLockDiscovery); \
   \
   PROPERTY(FtpProxyLogonType); \
   \
@@ -672,6 +678,8 @@ void TSessionData::DoLoad(THierarchicalStorage *Storage, bool PuttyImport, bool
   SetIgnoreLsWarnings(Storage->ReadBool("IgnoreLsWarnings", GetIgnoreLsWarnings()));
   SetSCPLsFullTime(static_cast<TAutoSwitch>(Storage->ReadInteger("SCPLsFullTime", GetSCPLsFullTime())));
   SetScp1Compatibility(Storage->ReadBool("Scp1Compatibility", GetScp1Compatibility()));
+  SetSCPTarTransfer(static_cast<TAutoSwitch>(Storage->ReadInteger("SCPTarTransfer", GetSCPTarTransfer())));
+  SetSCPTarCompression(Storage->ReadBool("SCPTarCompression", GetSCPTarCompression()));
   SetTimeDifference(TDateTime(Storage->ReadFloat("TimeDifference", GetTimeDifference())));
   SetTimeDifferenceAuto(Storage->ReadBool("TimeDifferenceAuto", (GetTimeDifference() == TDateTime())));
   SetDeleteToRecycleBin(Storage->ReadBool("DeleteToRecycleBin", GetDeleteToRecycleBin()));
@@ -804,6 +812,7 @@ void TSessionData::DoLoad(THierarchicalStorage *Storage, bool PuttyImport, bool
   SetFtpHost(static_cast<TAutoSwitch>(Storage->ReadInteger("FtpHost", GetFtpHost())));
   SetSslSessionReuse(Storage->ReadBool("SslSessionReuse", GetSslSessionReuse()));
   SetTlsCertificateFile(Storage->ReadString("TlsCertificateFile", GetTlsCertificateFile()));
+  SetWebDavLockDiscovery(Storage->ReadBool("WebDavLockDiscovery", GetWebDavLockDiscovery()));
 
   SetFtpProxyLogonType(Storage->ReadInteger("FtpProxyLogonType", GetFtpProxyLogonType()));
 
@@ -1024,6 +1033,8 @@ void TSessionData::DoSave(THierarchicalStorage *Storage,
     WRITE_DATA(Bool, IgnoreLsWarnings);
     WRITE_DATA(Integer, SCPLsFullTime);
     WRITE_DATA(Bool, Scp1Compatibility);
+    WRITE_DATA(Integer, SCPTarTransfer);
+    WRITE_DATA(Bool, SCPTarCompression);
     // TimeDifferenceAuto is valid for FTP protocol only.
     // For other protocols it's typically true (default value),
     // but ignored so TimeDifference is still taken into account (SCP only actually)
@@ -1140,6 +1151,7 @@ void TSessionData::DoSave(THierarchicalStorage *Storage,
     WRITE_DATA(Integer, FtpDeleteFromCwd);
     WRITE_DATA(Bool, SslSessionReuse);
     WRITE_DATA(String, TlsCertificateFile);
+    WRITE_DATA(Bool, WebDavLockDiscovery);
 
     WRITE_DATA(Integer, FtpProxyLogonType);
 
@@ -4014,6 +4026,16 @@ void TSessionData::SetSCPLsFullTime(TAutoSwitch Value)
   SET_SESSION_PROPERTY(SCPLsFullTime);
 }
 
+void TSessionData::SetSCPTarTransfer(TAutoSwitch Value)
+{
+  SET_SESSION_PROPERTY(SCPTarTransfer);
+}
+
+void TSessionData::SetSCPTarCompression(bool Value)
+{
+  SET_SESSION_PROPERTY(SCPTarCompression);
+}
+
 void TSessionData::SetColor(intptr_t Value)
 {
   SET_SESSION_PROPERTY(Color);
@@ -4190,6 +4212,11 @@ void TSessionData::SetTlsCertificateFile(UnicodeString Value)
   SET_SESSION_PROPERTY(TlsCertificateFile);
 }
 
+void TSessionData::SetWebDavLockDiscovery(bool Value)
+{
+  SET_SESSION_PROPERTY(WebDavLockDiscovery);
+}
+
 void TSessionData::SetNotUtf(TAutoSwitch Value)
 {
   SET_SESSION_PROPERTY(NotUtf);
@@ -266,11 +266,14 @@ private:
   UnicodeString FRecycleBinPath;
   UnicodeString FPostLoginCommands;
   TAutoSwitch FSCPLsFullTime;
+  TAutoSwitch FSCPTarTransfer;
+  bool FSCPTarCompression;
   TAutoSwitch FFtpListAll;
   TAutoSwitch FFtpHost;
   TAutoSwitch FFtpDeleteFromCwd;
   bool FSslSessionReuse;
   UnicodeString FTlsCertificateFile;
+  bool FWebDavLockDiscovery;
   TAddressFamily FAddressFamily;
   UnicodeString FRekeyData;
   uintptr_t FRekeyTime;
@@ -416,11 +419,14 @@ public:
   void SetSFTPBug(TSftpBug Bug, TAutoSwitch Value);
   TAutoSwitch GetSFTPBug(TSftpBug Bug) const;
   void SetSCPLsFullTime(TAutoSwitch Value);
+  void SetSCPTarTransfer(TAutoSwitch Value);
+  void SetSCPTarCompression(bool Value);
   void SetFtpListAll(TAutoSwitch Value);
   void SetFtpHost(TAutoSwitch Value);
   void SetFtpDeleteFromCwd(TAutoSwitch Value);
   void SetSslSessionReuse(bool Value);
   void SetTlsCertificateFile(UnicodeString Value);
+  void SetWebDavLockDiscovery(bool Value);
   UnicodeString GetStorageKey() const;
   UnicodeString GetInternalStorageKey() const;
   UnicodeString GetSiteKey() const;
@@ -689,11 +695,14 @@ public:
   __property uintptr_t SFTPMaxPacketSize = { read = FSFTPMaxPacketSize, write = SetSFTPMaxPacketSize };
   __property TAutoSwitch SFTPBug[TSftpBug Bug]  = { read=GetSFTPBug, write=SetSFTPBug };
   __property TAutoSwitch SCPLsFullTime = { read = FSCPLsFullTime, write = SetSCPLsFullTime };
+  __property TAutoSwitch SCPTarTransfer = { read = FSCPTarTransfer, write = SetSCPTarTransfer };
+  __property bool SCPTarCompression = { read = FSCPTarCompression, write = SetSCPTarCompression };
   __property TAutoSwitch FtpListAll = { read = FFtpListAll, write = SetFtpListAll };
   __property TAutoSwitch FtpHost = { read = FFtpHost, write = SetFtpHost };
   __property TAutoSwitch FtpDeleteFromCwd = { read = FFtpDeleteFromCwd, write = SetFtpDeleteFromCwd };
   __property bool SslSessionReuse = { read = FSslSessionReuse, write = SetSslSessionReuse };
   __property UnicodeString TlsCertificateFile = { read=FTlsCertificateFile, write=SetTlsCertificateFile };
+  __property bool WebDavLockDiscovery = { read = FWebDavLockDiscovery, write = SetWebDavLockDiscovery };
   __property TDSTMode DSTMode = { read = FDSTMode, write = SetDSTMode };
   __property bool DeleteToRecycleBin = { read = FDeleteToRecycleBin, write = SetDeleteToRecycleBin };
   __property bool OverwrittenToRecycleBin = { read = FOverwrittenToRecycleBin, write = SetOverwrittenToRecycleBin };
@@ -820,6 +829,8 @@ public:
   intptr_t GetSFTPMinPacketSize() const { return FSFTPMinPacketSize; }
   intptr_t GetSFTPMaxPacketSize() const { return FSFTPMaxPacketSize; }
   TAutoSwitch GetSCPLsFullTime() const { return FSCPLsFullTime; }
+  TAutoSwitch GetSCPTarTransfer() const { return FSCPTarTransfer; }
+  bool GetSCPTarCompression() const { return FSCPTarCompression; }
   TAutoSwitch GetFtpListAll() const { return FFtpListAll; }
   TAutoSwitch GetFtpHost() const { return FFtpHost; }
   bool GetFtpDupFF() const { return FFtpDupFF; }
@@ -827,6 +838,7 @@ public:
   TAutoSwitch GetFtpDeleteFromCwd() const { return FFtpDeleteFromCwd; }
   bool GetSslSessionReuse() const { return FSslSessionReuse; }
   UnicodeString GetTlsCertificateFile() const { return FTlsCertificateFile; }
+  bool GetWebDavLockDiscovery() const { return FWebDavLockDiscovery; }
   TDSTMode GetDSTMode() const { return FDSTMode; }
   bool GetDeleteToRecycleBin() const { return FDeleteToRecycleBin; }
   bool GetOverwrittenToRecycleBin() const { return FOverwrittenToRecycleBin; }
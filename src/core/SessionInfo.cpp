@@ -1182,6 +1182,9 @@ void TSessionLog::DoAddStartupInfo(TSessionData *Data)
         Data->GetListingCommand(),
         BooleanToEngStr(Data->GetIgnoreLsWarnings()),
         BooleanToEngStr(Data->GetScp1Compatibility()));
+      ADF("Tar transfer: %s, Tar compression: %s",
+        EnumName(Data->GetSCPTarTransfer(), AutoSwitchNames),
+        BooleanToEngStr(Data->GetSCPTarCompression()));
     }
     if ((Data->GetFSProtocol() == fsSFTP) || (Data->GetFSProtocol() == fsSFTPonly))
     {
@@ -1281,6 +1284,8 @@ void TSessionLog::DoAddStartupInfo(TSessionData *Data)
     {
       ADF("Compression: %s",
         BooleanToEngStr(Data->GetCompression()));
+      ADF("Lock discovery: %s",
+        BooleanToEngStr(Data->GetWebDavLockDiscovery()));
     }
 
     AddSeparator();
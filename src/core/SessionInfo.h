@@ -51,7 +51,8 @@ enum TFSCapability
   fcModeChangingUpload, fcPreservingTimestampUpload, fcShellAnyCommand,
   fcSecondaryShell, fcRemoveCtrlZUpload, fcRemoveBOMUpload, fcMoveToQueue,
   fcLocking, fcPreservingTimestampDirs, fcResumeSupport,
-  fcChangePassword, fsSkipTransfer, fsParallelTransfers,
+  fcChangePassword, fsSkipTransfer, fsParallelTransfers, fsParallelFileTransfers,
+  fsDirectoryTree,
   fcCount,
 };
 
@@ -2322,6 +2322,8 @@ bool TSFTPFileSystem::IsCapable(intptr_t Capability) const
         FSupportsHardlink;
 
     case fcLocking:
+    case fsParallelFileTransfers:
+    case fsDirectoryTree:
       return false;
 
     case fcChangePassword:
@@ -6565,6 +6567,16 @@ void TSFTPFileSystem::UnlockFile(UnicodeString /*FileName*/, const TRemoteFile *
   DebugFail();
 }
 
+void TSFTPFileSystem::BeginDirectoryTree()
+{
+  DebugFail();
+}
+
+void TSFTPFileSystem::EndDirectoryTree()
+{
+  DebugFail();
+}
+
 void TSFTPFileSystem::UpdateFromMain(TCustomFileSystem * /*MainFileSystem*/)
 {
   // noop
@@ -99,6 +99,8 @@ public:
   virtual void LockFile(UnicodeString AFileName, const TRemoteFile *AFile) override;
   virtual void UnlockFile(UnicodeString AFileName, const TRemoteFile *AFile) override;
   virtual void UpdateFromMain(TCustomFileSystem *MainFileSystem) override;
+  virtual void BeginDirectoryTree() override;
+  virtual void EndDirectoryTree() override;
 
 protected:
   TSecureShell *FSecureShell;
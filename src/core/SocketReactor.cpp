@@ -0,0 +1,148 @@
+#include <vcl.h>
+#pragma hdrstop
+
+#include <Common.h>
+
+#include "SocketReactor.h"
+
+#ifndef AUTO_WINSOCK
+#include <winsock2.h>
+#endif
+
+TSocketReactor::TSocketReactor(TObjectClassId Kind) :
+  TObject(Kind),
+  FLastError(0)
+{
+}
+
+TSocketReactor::~TSocketReactor()
+{
+  DebugAssert(FSockets.empty());
+}
+
+bool TSocketReactor::SelectEvents(SOCKET Socket, long Events)
+{
+  bool Result = DoSelectEvents(Socket, Events);
+
+  TSockets::iterator it = FSockets.find(Socket);
+  if (Events != 0)
+  {
+    if (Result && (it == FSockets.end()))
+    {
+      FSockets.push_back(Socket);
+    }
+  }
+  else if (it != FSockets.end())
+  {
+    // forgotten even if the deselection failed (socket closed already)
+    FSockets.erase(it);
+  }
+  return Result;
+}
+
+bool TSocketReactor::EnumEvents(SOCKET Socket, TNetworkEvents &Events)
+{
+  TNetworkEvents AEvents;
+  ClearStruct(AEvents);
+  bool Result = DoEnumEvents(Socket, AEvents);
+  if (Result)
+  {
+    Events.lNetworkEvents |= AEvents.lNetworkEvents;
+    for (intptr_t Index = 0; Index < FD_MAX_EVENTS; ++Index)
+    {
+      if (AEvents.iErrorCode[Index] != 0)
+      {
+        Events.iErrorCode[Index] = AEvents.iErrorCode[Index];
+      }
+    }
+  }
+  return Result;
+}
+
+TReactorWaitResult TSocketReactor::Wait(uint32_t MSec,
+  const HANDLE *Handles, intptr_t HandleCount, intptr_t &Signalled)
+{
+  Signalled = -1;
+  return DoWait(MSec, Handles, HandleCount, Signalled);
+}
+
+// One event object for all registered sockets, see WSAEventSelect
+class TWinSocketReactor : public TSocketReactor
+{
+  NB_DISABLE_COPY(TWinSocketReactor)
+public:
+  TWinSocketReactor() :
+    TSocketReactor(OBJECT_CLASS_TSocketReactor)
+  {
+    FEvent = ::CreateEvent(nullptr, false, false, nullptr);
+  }
+
+  virtual ~TWinSocketReactor()
+  {
+    SAFE_CLOSE_HANDLE(FEvent);
+  }
+
+protected:
+  virtual bool DoSelectEvents(SOCKET Socket, long Events) override
+  {
+    bool Result = (::WSAEventSelect(Socket, static_cast<WSAEVENT>(FEvent), Events) != SOCKET_ERROR);
+    if (!Result)
+    {
+      FLastError = ::WSAGetLastError();
+    }
+    return Result;
+  }
+
+  virtual bool DoEnumEvents(SOCKET Socket, TNetworkEvents &Events) override
+  {
+    bool Result = (::WSAEnumNetworkEvents(Socket, nullptr, &Events) == 0);
+    if (!Result)
+    {
+      FLastError = ::WSAGetLastError();
+    }
+    return Result;
+  }
+
+  virtual TReactorWaitResult DoWait(uint32_t MSec,
+    const HANDLE *Handles, intptr_t HandleCount, intptr_t &Signalled) override
+  {
+    FHandles.clear();
+    FHandles.reserve(HandleCount + 1);
+    for (intptr_t Index = 0; Index < HandleCount; ++Index)
+    {
+      FHandles.push_back(Handles[Index]);
+    }
+    FHandles.push_back(FEvent);
+
+    TReactorWaitResult Result;
+    uint32_t WaitResult = ::WaitForMultipleObjects(static_cast<DWORD>(FHandles.size()), FHandles.data(), FALSE, MSec);
+    if (WaitResult < WAIT_OBJECT_0 + HandleCount)
+    {
+      Signalled = WaitResult - WAIT_OBJECT_0;
+      Result = rwHandle;
+    }
+    else if (WaitResult == WAIT_OBJECT_0 + HandleCount)
+    {
+      Result = rwNetwork;
+    }
+    else if (WaitResult == WAIT_TIMEOUT)
+    {
+      Result = rwTimeout;
+    }
+    else
+    {
+      FLastError = WaitResult;
+      Result = rwError;
+    }
+    return Result;
+  }
+
+private:
+  HANDLE FEvent;
+  rde::vector<HANDLE> FHandles;
+};
+
+TSocketReactor *TSocketReactor::Create()
+{
+  return new TWinSocketReactor();
+}
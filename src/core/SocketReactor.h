@@ -0,0 +1,57 @@
+#pragma once
+
+#include <rdestl/vector.h>
+#include <Classes.hpp>
+
+struct _WSANETWORKEVENTS;
+typedef struct _WSANETWORKEVENTS WSANETWORKEVENTS;
+typedef UINT_PTR SOCKET;
+typedef WSANETWORKEVENTS TNetworkEvents;
+
+enum TReactorWaitResult
+{
+  rwTimeout,
+  rwNetwork,
+  rwHandle,
+  rwError,
+};
+
+// Waits for network events on sockets of a session
+// (its main connection and port forwarding sockets)
+class NB_CORE_EXPORT TSocketReactor : public TObject
+{
+  NB_DISABLE_COPY(TSocketReactor)
+public:
+  static inline bool classof(const TObject *Obj) { return Obj->is(OBJECT_CLASS_TSocketReactor); }
+  virtual bool is(TObjectClassId Kind) const override { return (Kind == OBJECT_CLASS_TSocketReactor) || TObject::is(Kind); }
+public:
+  // Creates the reactor (WSAEventSelect based)
+  static TSocketReactor *Create();
+  virtual ~TSocketReactor();
+
+  // Events == 0 unregisters the socket
+  bool SelectEvents(SOCKET Socket, long Events);
+  // Merges events collected for the socket since the last call into Events
+  bool EnumEvents(SOCKET Socket, TNetworkEvents &Events);
+  // Waits for network event or any of additional Handles
+  TReactorWaitResult Wait(uint32_t MSec,
+    const HANDLE *Handles, intptr_t HandleCount, intptr_t &Signalled);
+
+  intptr_t GetSocketCount() const { return static_cast<intptr_t>(FSockets.size()); }
+  int GetLastError() const { return FLastError; }
+
+protected:
+  explicit TSocketReactor(TObjectClassId Kind);
+
+  virtual bool DoSelectEvents(SOCKET Socket, long Events) = 0;
+  virtual bool DoEnumEvents(SOCKET Socket, TNetworkEvents &Events) = 0;
+  virtual TReactorWaitResult DoWait(uint32_t MSec,
+    const HANDLE *Handles, intptr_t HandleCount, intptr_t &Signalled) = 0;
+
+  int FLastError;
+
+private:
+  typedef rde::vector<SOCKET> TSockets;
+
+  TSockets FSockets;
+};
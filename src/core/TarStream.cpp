@@ -0,0 +1,636 @@
+#include <vcl.h>
+#pragma hdrstop
+
+#include <Common.h>
+#include <zlib.h>
+
+#include "TarStream.h"
+
+#define TAR_BLOCK 512
+#define TAR_NAME_LEN 100
+#define TAR_LONG_LINK "././@LongLink"
+// Output of inflate is walked in chunks of this size,
+// so that highly compressible data do not inflate to memory at once
+#define TAR_INFLATE_CHUNK (256 * 1024)
+// Long names and pax extended headers are collected in memory whole,
+// larger ones are rejected
+#define TAR_MAX_META (1024 * 1024)
+
+// ustar header field offsets and sizes
+#define TH_NAME 0
+#define TH_MODE 100
+#define TH_UID 108
+#define TH_GID 116
+#define TH_SIZE 124
+#define TH_MTIME 136
+#define TH_CHKSUM 148
+#define TH_TYPE 156
+#define TH_LINKNAME 157
+#define TH_MAGIC 257
+#define TH_VERSION 263
+#define TH_PREFIX 345
+
+static int64_t TarPadding(int64_t Size)
+{
+  return (TAR_BLOCK - (Size % TAR_BLOCK)) % TAR_BLOCK;
+}
+
+static void Append(rde::vector<uint8_t> &Buffer, const uint8_t *Data, size_t Length)
+{
+  size_t Offset = Buffer.size();
+  Buffer.resize(Offset + Length);
+  if (Length > 0)
+  {
+    memmove(&Buffer[Offset], Data, Length);
+  }
+}
+
+static char LastChar(const RawByteString &Str)
+{
+  return Str.IsEmpty() ? '\0' : Str.c_str()[Str.Length() - 1];
+}
+
+static void FormatNumber(uint8_t *Field, intptr_t Len, int64_t Value)
+{
+  // Octal with terminating NUL, if it fits, base-256 otherwise (GNU/star)
+  int64_t Limit = static_cast<int64_t>(1) << (3 * (Len - 1));
+  if ((Value >= 0) && (Value < Limit))
+  {
+    Field[Len - 1] = '\0';
+    for (intptr_t Index = Len - 2; Index >= 0; --Index)
+    {
+      Field[Index] = static_cast<uint8_t>('0' + (Value & 7));
+      Value >>= 3;
+    }
+  }
+  else
+  {
+    for (intptr_t Index = Len - 1; Index > 0; --Index)
+    {
+      Field[Index] = static_cast<uint8_t>(Value & 0xFF);
+      Value >>= 8;
+    }
+    Field[0] = 0x80;
+  }
+}
+
+static int64_t ParseNumber(const uint8_t *Field, intptr_t Len)
+{
+  int64_t Result = 0;
+  if (FLAGSET(Field[0], 0x80))
+  {
+    // Base-256, negative values (0x40) are not supported
+    if (FLAGSET(Field[0], 0x40))
+    {
+      throw Exception(L"Invalid tar header");
+    }
+    Result = Field[0] & 0x3F;
+    for (intptr_t Index = 1; Index < Len; ++Index)
+    {
+      if (Result > (INT64_MAX >> 8))
+      {
+        throw Exception(L"Invalid tar header");
+      }
+      Result = (Result << 8) | Field[Index];
+    }
+  }
+  else
+  {
+    intptr_t Index = 0;
+    while ((Index < Len) && (Field[Index] == ' '))
+    {
+      ++Index;
+    }
+    while ((Index < Len) && (Field[Index] >= '0') && (Field[Index] <= '7'))
+    {
+      Result = (Result << 3) | (Field[Index] - '0');
+      ++Index;
+    }
+  }
+  return Result;
+}
+
+static RawByteString ParseString(const uint8_t *Field, intptr_t Len)
+{
+  intptr_t Length = 0;
+  while ((Length < Len) && (Field[Length] != '\0'))
+  {
+    ++Length;
+  }
+  return RawByteString(reinterpret_cast<const char *>(Field), Length);
+}
+
+static uint32_t Checksum(const uint8_t *Block)
+{
+  uint32_t Result = 0;
+  for (intptr_t Index = 0; Index < TAR_BLOCK; ++Index)
+  {
+    bool InChecksum = (Index >= TH_CHKSUM) && (Index < TH_CHKSUM + 8);
+    Result += InChecksum ? ' ' : Block[Index];
+  }
+  return Result;
+}
+
+static RawByteString HeaderName(const TTarEntry &Entry)
+{
+  RawByteString Result = Entry.Name;
+  if ((Entry.Type == tetDirectory) && !Result.IsEmpty() && (LastChar(Result) != '/'))
+  {
+    Result += '/';
+  }
+  return Result;
+}
+
+TTarEntry::TTarEntry() :
+  Type(tetFile),
+  Size(0),
+  MTime(0),
+  Mode(0)
+{
+}
+
+int64_t TarEntrySize(const TTarEntry &Entry)
+{
+  int64_t Result = TAR_BLOCK;
+  intptr_t NameLength = HeaderName(Entry).Length();
+  if (NameLength > TAR_NAME_LEN)
+  {
+    // GNU long name entry, NUL terminated
+    Result += TAR_BLOCK + NameLength + 1 + TarPadding(NameLength + 1);
+  }
+  if (Entry.Type == tetFile)
+  {
+    Result += Entry.Size + TarPadding(Entry.Size);
+  }
+  return Result;
+}
+
+TTarWriter::TTarWriter() :
+  FDataRemaining(0),
+  FPadding(0)
+{
+}
+
+uint8_t *TTarWriter::AddBlocks(intptr_t Count)
+{
+  size_t Offset = FOutput.size();
+  FOutput.resize(Offset + Count * TAR_BLOCK);
+  uint8_t *Result = &FOutput[Offset];
+  memset(Result, 0, Count * TAR_BLOCK);
+  return Result;
+}
+
+void TTarWriter::AddZeros(int64_t Count)
+{
+  size_t Offset = FOutput.size();
+  FOutput.resize(Offset + static_cast<size_t>(Count));
+  memset(&FOutput[Offset], 0, static_cast<size_t>(Count));
+}
+
+void TTarWriter::AddHeader(const RawByteString &Name, char Type, int64_t Size, int64_t MTime, uint32_t Mode,
+  const RawByteString &LinkName)
+{
+  uint8_t *Block = AddBlocks(1);
+  memmove(Block + TH_NAME, Name.c_str(), std::min(Name.Length(), static_cast<intptr_t>(TAR_NAME_LEN)));
+  FormatNumber(Block + TH_MODE, 8, Mode);
+  FormatNumber(Block + TH_UID, 8, 0);
+  FormatNumber(Block + TH_GID, 8, 0);
+  FormatNumber(Block + TH_SIZE, 12, Size);
+  FormatNumber(Block + TH_MTIME, 12, MTime);
+  Block[TH_TYPE] = static_cast<uint8_t>(Type);
+  memmove(Block + TH_LINKNAME, LinkName.c_str(), std::min(LinkName.Length(), static_cast<intptr_t>(TAR_NAME_LEN)));
+  memmove(Block + TH_MAGIC, "ustar", 6);
+  memmove(Block + TH_VERSION, "00", 2);
+  // Six octal digits, NUL and space
+  FormatNumber(Block + TH_CHKSUM, 7, Checksum(Block));
+  Block[TH_CHKSUM + 7] = ' ';
+}
+
+void TTarWriter::AddEntry(const TTarEntry &Entry)
+{
+  DebugAssert((FDataRemaining == 0) && (FPadding == 0));
+  RawByteString Name = HeaderName(Entry);
+  if (Name.Length() > TAR_NAME_LEN)
+  {
+    intptr_t Length = Name.Length() + 1;
+    AddHeader(TAR_LONG_LINK, 'L', Length, 0, 0, RawByteString());
+    size_t Offset = FOutput.size();
+    AddZeros(Length + TarPadding(Length));
+    memmove(&FOutput[Offset], Name.c_str(), Name.Length());
+  }
+  char Type;
+  int64_t Size = 0;
+  switch (Entry.Type)
+  {
+  case tetFile:
+    Type = '0';
+    Size = Entry.Size;
+    break;
+  case tetDirectory:
+    Type = '5';
+    break;
+  case tetHardLink:
+    Type = '1';
+    break;
+  default:
+    DebugFail();
+    Type = '0';
+    break;
+  }
+  AddHeader(Name, Type, Size, Entry.MTime, Entry.Mode & 07777, Entry.LinkName);
+  FDataRemaining = Size;
+  FPadding = TarPadding(Size);
+}
+
+void TTarWriter::AddData(const uint8_t *Data, intptr_t Length)
+{
+  DebugAssert(Length <= FDataRemaining);
+  Length = static_cast<intptr_t>(std::min(static_cast<int64_t>(Length), FDataRemaining));
+  Append(FOutput, Data, Length);
+  FDataRemaining -= Length;
+}
+
+void TTarWriter::EndEntry()
+{
+  AddZeros(FDataRemaining + FPadding);
+  FDataRemaining = 0;
+  FPadding = 0;
+}
+
+void TTarWriter::AddFiller(int64_t Size)
+{
+  DebugAssert((Size >= TAR_BLOCK) && (Size % TAR_BLOCK == 0));
+  // A global pax header with a single "comment" record,
+  // which extracting side is required to ignore
+  int64_t DataSize = Size - TAR_BLOCK;
+  AddHeader("pax_global_header", 'g', DataSize, 0, 0, RawByteString());
+  if (DataSize > 0)
+  {
+    size_t Offset = FOutput.size();
+    AddZeros(DataSize);
+    // Record length includes its own digits
+    AnsiString Prefix(FORMAT("%lld comment=", DataSize));
+    memmove(&FOutput[Offset], Prefix.c_str(), Prefix.Length());
+    memset(&FOutput[Offset + Prefix.Length()], 'x', static_cast<size_t>(DataSize - Prefix.Length() - 1));
+    FOutput[Offset + static_cast<size_t>(DataSize) - 1] = '\n';
+  }
+}
+
+void TTarWriter::Finish()
+{
+  DebugAssert((FDataRemaining == 0) && (FPadding == 0));
+  AddBlocks(TarEndSize / TAR_BLOCK);
+}
+
+TTarReader::TTarReader(bool Compressed) :
+  FCompressed(Compressed),
+  FZStream(nullptr),
+  FStreamEnd(false),
+  FInputPos(0),
+  FState(rsHeader),
+  FRemaining(0),
+  FPadding(0),
+  FMetaType(0),
+  FPaxSize(-1)
+{
+  if (FCompressed)
+  {
+    FZStream = new z_stream;
+    memset(FZStream, 0, sizeof(*FZStream));
+    // gzip only
+    if (inflateInit2(FZStream, 15 + 16) != Z_OK)
+    {
+      delete FZStream;
+      FZStream = nullptr;
+      throw Exception(L"Cannot initialize decompression");
+    }
+  }
+}
+
+TTarReader::~TTarReader()
+{
+  if (FZStream != nullptr)
+  {
+    inflateEnd(FZStream);
+    delete FZStream;
+  }
+}
+
+void TTarReader::Feed(const uint8_t *Data, intptr_t Length)
+{
+  rde::vector<uint8_t> &Buffer =
+    (FCompressed ? (FStreamEnd ? FTrailer : FRaw) : ((FState == rsEnd) ? FTrailer : FInput));
+  Append(Buffer, Data, Length);
+}
+
+void TTarReader::Compact()
+{
+  if (FInputPos > 0)
+  {
+    FInput.erase(FInput.begin(), FInput.begin() + FInputPos);
+    FInputPos = 0;
+  }
+}
+
+bool TTarReader::Inflate()
+{
+  bool Result = false;
+  if (FCompressed && !FStreamEnd && !FRaw.empty())
+  {
+    Compact();
+    size_t Offset = FInput.size();
+    FInput.resize(Offset + TAR_INFLATE_CHUNK);
+    FZStream->next_in = FRaw.data();
+    FZStream->avail_in = static_cast<uInt>(FRaw.size());
+    FZStream->next_out = &FInput[Offset];
+    FZStream->avail_out = TAR_INFLATE_CHUNK;
+    int Res = inflate(FZStream, Z_NO_FLUSH);
+    FInput.resize(Offset + TAR_INFLATE_CHUNK - FZStream->avail_out);
+    size_t Consumed = FRaw.size() - FZStream->avail_in;
+    FRaw.erase(FRaw.begin(), FRaw.begin() + Consumed);
+    if (Res == Z_STREAM_END)
+    {
+      FStreamEnd = true;
+      FTrailer = FRaw;
+      FRaw.clear();
+    }
+    else if ((Res != Z_OK) && (Res != Z_BUF_ERROR))
+    {
+      throw Exception(FORMAT("Decompression failed (%d)", Res));
+    }
+    Result = (FInput.size() > Offset) || FStreamEnd;
+  }
+  return Result;
+}
+
+bool TTarReader::ParseHeader(const uint8_t *Block)
+{
+  bool Result = false;
+  if (ParseNumber(Block + TH_CHKSUM, 8) != Checksum(Block))
+  {
+    throw Exception(L"Invalid tar header checksum");
+  }
+
+  char Type = static_cast<char>(Block[TH_TYPE]);
+  int64_t Size = ParseNumber(Block + TH_SIZE, 12);
+  int64_t MTime = ParseNumber(Block + TH_MTIME, 12);
+  if ((Size < 0) || (MTime < 0))
+  {
+    throw Exception(L"Invalid tar header");
+  }
+  switch (Type)
+  {
+  case 'L': // GNU long name
+  case 'K': // GNU long link name
+  case 'x': // pax extended header
+    if (Size > TAR_MAX_META)
+    {
+      throw Exception(L"Invalid tar extended header");
+    }
+    FState = rsMeta;
+    FMetaType = Type;
+    FMeta.clear();
+    FRemaining = Size;
+    FPadding = TarPadding(Size);
+    break;
+
+  case 'g': // pax global header
+    FState = rsSkip;
+    FRemaining = Size;
+    FPadding = TarPadding(Size);
+    break;
+
+  default:
+    Result = true;
+    {
+      FEntry = TTarEntry();
+      if (!FLongName.IsEmpty())
+      {
+        FEntry.Name = FLongName;
+      }
+      else
+      {
+        FEntry.Name = ParseString(Block + TH_NAME, TAR_NAME_LEN);
+        RawByteString Prefix = ParseString(Block + TH_PREFIX, 155);
+        if ((memcmp(Block + TH_MAGIC, "ustar", 5) == 0) && !Prefix.IsEmpty())
+        {
+          FEntry.Name = Prefix + "/" + FEntry.Name;
+        }
+      }
+      FEntry.LinkName = !FLongLinkName.IsEmpty() ? FLongLinkName : ParseString(Block + TH_LINKNAME, TAR_NAME_LEN);
+      if (FPaxSize >= 0)
+      {
+        Size = FPaxSize;
+      }
+      FLongName = RawByteString();
+      FLongLinkName = RawByteString();
+      FPaxSize = -1;
+
+      switch (Type)
+      {
+      case '0':
+      case '\0':
+      case '7':
+        FEntry.Type = tetFile;
+        break;
+      case '5':
+        FEntry.Type = tetDirectory;
+        Size = 0;
+        break;
+      case '1':
+        FEntry.Type = tetHardLink;
+        Size = 0;
+        break;
+      default:
+        FEntry.Type = tetOther;
+        break;
+      }
+      while ((FEntry.Name.Length() > 1) && (LastChar(FEntry.Name) == '/'))
+      {
+        FEntry.Name.SetLength(FEntry.Name.Length() - 1);
+      }
+      FEntry.Size = Size;
+      FEntry.MTime = MTime;
+      FEntry.Mode = static_cast<uint32_t>(ParseNumber(Block + TH_MODE, 8));
+      FState = (FEntry.Type == tetFile) ? rsData : rsSkip;
+      FRemaining = Size;
+      FPadding = TarPadding(Size);
+    }
+    break;
+  }
+  return Result;
+}
+
+void TTarReader::ProcessMeta()
+{
+  if ((FMetaType == 'L') || (FMetaType == 'K'))
+  {
+    RawByteString &Name = (FMetaType == 'L') ? FLongName : FLongLinkName;
+    Name = ParseString(FMeta.data(), static_cast<intptr_t>(FMeta.size()));
+  }
+  else
+  {
+    // Records of "<length> <keyword>=<value>\n"
+    size_t Pos = 0;
+    while (Pos < FMeta.size())
+    {
+      const char *Record = reinterpret_cast<const char *>(&FMeta[Pos]);
+      size_t Length = 0;
+      size_t Index = 0;
+      while ((Pos + Index < FMeta.size()) && (Record[Index] >= '0') && (Record[Index] <= '9') &&
+             (Length <= FMeta.size()))
+      {
+        Length = Length * 10 + (Record[Index] - '0');
+        ++Index;
+      }
+      if ((Length <= Index) || (Pos + Length > FMeta.size()) || (Record[Index] != ' '))
+      {
+        throw Exception(L"Invalid tar extended header");
+      }
+      const char *KeyStart = Record + Index + 1;
+      const char *Equals = static_cast<const char *>(memchr(KeyStart, '=', Record + Length - KeyStart));
+      if (Equals != nullptr)
+      {
+        RawByteString Key(KeyStart, Equals - KeyStart);
+        // Without the trailing newline
+        RawByteString Val(Equals + 1, Record + Length - 1 - (Equals + 1));
+        if (Key == "path")
+        {
+          FLongName = Val;
+        }
+        else if (Key == "linkpath")
+        {
+          FLongLinkName = Val;
+        }
+        else if (Key == "size")
+        {
+          FPaxSize = 0;
+          for (const char *Digit = Val.c_str(); (*Digit >= '0') && (*Digit <= '9'); ++Digit)
+          {
+            if (FPaxSize > (INT64_MAX - (*Digit - '0')) / 10)
+            {
+              throw Exception(L"Invalid tar extended header");
+            }
+            FPaxSize = FPaxSize * 10 + (*Digit - '0');
+          }
+        }
+      }
+      Pos += Length;
+    }
+  }
+}
+
+TTarToken TTarReader::Read(const uint8_t *&Data, intptr_t &Length)
+{
+  while (true)
+  {
+    size_t Available = FInput.size() - FInputPos;
+    switch (FState)
+    {
+    case rsHeader:
+      if (Available >= TAR_BLOCK)
+      {
+        const uint8_t *Block = &FInput[FInputPos];
+        FInputPos += TAR_BLOCK;
+        bool Zero = true;
+        for (intptr_t Index = 0; Zero && (Index < TAR_BLOCK); ++Index)
+        {
+          Zero = (Block[Index] == 0);
+        }
+        if (Zero)
+        {
+          // The second zero block and the padding to the record size
+          // are not needed, they are discarded with whatever follows
+          // (uncompressed) or they are the rest of the compressed stream
+          FState = rsEnd;
+          if (!FCompressed)
+          {
+            Append(FTrailer, FInput.data() + FInputPos, FInput.size() - FInputPos);
+          }
+          FInput.clear();
+          FInputPos = 0;
+        }
+        else if (ParseHeader(Block))
+        {
+          Data = nullptr;
+          Length = 0;
+          return ttEntry;
+        }
+        continue;
+      }
+      break;
+
+    case rsData:
+    case rsSkip:
+      if (FRemaining == 0)
+      {
+        FState = rsPadding;
+        continue;
+      }
+      else if (Available > 0)
+      {
+        size_t Count = static_cast<size_t>(std::min(static_cast<int64_t>(Available), FRemaining));
+        Data = &FInput[FInputPos];
+        Length = static_cast<intptr_t>(Count);
+        FInputPos += Count;
+        FRemaining -= Count;
+        if (FState == rsData)
+        {
+          return ttData;
+        }
+        continue;
+      }
+      break;
+
+    case rsPadding:
+      {
+        size_t Count = static_cast<size_t>(std::min(static_cast<int64_t>(Available), FPadding));
+        FInputPos += Count;
+        FPadding -= Count;
+        if (FPadding == 0)
+        {
+          FState = rsHeader;
+          continue;
+        }
+      }
+      break;
+
+    case rsMeta:
+      if (Available > 0)
+      {
+        size_t Count = static_cast<size_t>(std::min(static_cast<int64_t>(Available), FRemaining));
+        Append(FMeta, &FInput[FInputPos], Count);
+        FInputPos += Count;
+        FRemaining -= Count;
+      }
+      if (FRemaining == 0)
+      {
+        ProcessMeta();
+        FState = rsPadding;
+        continue;
+      }
+      break;
+
+    case rsEnd:
+      // Discard the rest of the decompressed stream
+      FInput.clear();
+      FInputPos = 0;
+      if (!FCompressed || FStreamEnd)
+      {
+        return ttEnd;
+      }
+      break;
+    }
+
+    if (!Inflate())
+    {
+      Compact();
+      return ttNone;
+    }
+  }
+}
+
+RawByteString TTarReader::GetTrailer() const
+{
+  return RawByteString(reinterpret_cast<const char *>(FTrailer.data()), static_cast<intptr_t>(FTrailer.size()));
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <rdestl/vector.h>
+#include <Classes.hpp>
+
+struct z_stream_s;
+
+// Minimal tar archive (POSIX ustar with GNU long names) writer and reader
+// used by SCP to transfer whole directory trees as a single stream,
+// instead of a request/acknowledgement round trip per file.
+// Names are in the encoding of the remote shell, '/' separated.
+
+enum TTarEntryType
+{
+  tetFile,
+  tetDirectory,
+  tetHardLink,
+  tetOther,
+};
+
+struct NB_CORE_EXPORT TTarEntry
+{
+  TTarEntry();
+
+  RawByteString Name;
+  // Target of a hard link (relative to the archive root)
+  RawByteString LinkName;
+  TTarEntryType Type;
+  int64_t Size;
+  // Unix time
+  int64_t MTime;
+  uint32_t Mode;
+};
+
+// Size of the end-of-archive marker
+const int64_t TarEndSize = 2 * 512;
+
+// Bytes the entry (its header(s) and data) takes in the archive
+NB_CORE_EXPORT int64_t TarEntrySize(const TTarEntry &Entry);
+
+class NB_CORE_EXPORT TTarWriter
+{
+  CUSTOM_MEM_ALLOCATION_IMPL
+  NB_DISABLE_COPY(TTarWriter)
+public:
+  TTarWriter();
+
+  // Data of files follow with AddData, and each entry is closed with EndEntry
+  void AddEntry(const TTarEntry &Entry);
+  void AddData(const uint8_t *Data, intptr_t Length);
+  // Pads the data to the block boundary. Data missing to the size
+  // announced in the header (file shrunk meanwhile) are filled with zeros.
+  void EndEntry();
+  // Takes the space of an entry (TarEntrySize) that cannot be sent after all,
+  // with an extended header ignored by the extracting side
+  void AddFiller(int64_t Size);
+  void Finish();
+
+  // Output produced so far, to be sent and discarded
+  const uint8_t *GetOutput() const { return FOutput.data(); }
+  intptr_t GetOutputSize() const { return static_cast<intptr_t>(FOutput.size()); }
+  void DiscardOutput() { FOutput.clear(); }
+  // Remaining data of the current entry
+  int64_t GetDataRemaining() const { return FDataRemaining; }
+
+private:
+  rde::vector<uint8_t> FOutput;
+  int64_t FDataRemaining;
+  int64_t FPadding;
+
+  uint8_t *AddBlocks(intptr_t Count);
+  void AddHeader(const RawByteString &Name, char Type, int64_t Size, int64_t MTime, uint32_t Mode,
+    const RawByteString &LinkName);
+  void AddZeros(int64_t Count);
+};
+
+enum TTarToken
+{
+  // More input is needed (Feed)
+  ttNone,
+  // New entry, see GetEntry
+  ttEntry,
+  // Block of data of the current entry
+  ttData,
+  // End of the archive (and of the compressed stream)
+  ttEnd,
+};
+
+// Push parser, data received are passed to Feed and the archive
+// is then walked with Read, until it returns ttNone.
+class NB_CORE_EXPORT TTarReader
+{
+  CUSTOM_MEM_ALLOCATION_IMPL
+  NB_DISABLE_COPY(TTarReader)
+public:
+  explicit TTarReader(bool Compressed);
+  ~TTarReader();
+
+  void Feed(const uint8_t *Data, intptr_t Length);
+  // Data are valid until the next call to Read or Feed
+  TTarToken Read(const uint8_t *&Data, intptr_t &Length);
+  const TTarEntry &GetEntry() const { return FEntry; }
+  // Any input that followed the archive (and its compressed stream)
+  RawByteString GetTrailer() const;
+
+private:
+  enum TState { rsHeader, rsData, rsSkip, rsPadding, rsMeta, rsEnd };
+
+  bool FCompressed;
+  z_stream_s *FZStream;
+  bool FStreamEnd;
+  rde::vector<uint8_t> FRaw;
+  rde::vector<uint8_t> FInput;
+  size_t FInputPos;
+  rde::vector<uint8_t> FTrailer;
+  TState FState;
+  int64_t FRemaining;
+  int64_t FPadding;
+  char FMetaType;
+  rde::vector<uint8_t> FMeta;
+  RawByteString FLongName;
+  RawByteString FLongLinkName;
+  int64_t FPaxSize;
+  TTarEntry FEntry;
+
+  bool Inflate();
+  void Compact();
+  bool ParseHeader(const uint8_t *Block);
+  void ProcessMeta();
+};
@@ -838,7 +838,14 @@ TParallelOperation::TParallelOperation(TOperationSide Side) :
   FProbablyEmpty(false),
   FClients(0),
   FMainOperationProgress(nullptr),
-  FSide(Side)
+  FSide(Side),
+  FPartObject(nullptr),
+  FPartSize(0),
+  FPartOffset(0),
+  FPartSegmentSize(0),
+  FPartsStarted(0),
+  FPartsDone(0),
+  FPartFailed(false)
 {
   DebugAssert((Side == osLocal) || (Side == osRemote));
 }
@@ -988,6 +995,169 @@ void TParallelOperation::Done(UnicodeString FileName, bool Dir, bool Success)
   }
 }
 
+void TParallelOperation::DonePart(TTerminal *Terminal, bool Success)
+{
+  bool Complete = false;
+  bool Failed = false;
+  UnicodeString FileName;
+  UnicodeString DestFullName;
+  intptr_t Parts = 0;
+  bool PreserveTime = false;
+  TDateTime Modification;
+  DWORD NewAttrs = 0;
+
+  {
+    TGuard Guard(*FSection.get());
+
+    if (DebugAlwaysTrue(FPartObject != nullptr))
+    {
+      FPartsDone++;
+      if (!Success)
+      {
+        FPartFailed = true;
+      }
+
+      // The last connection to finish its segment completes the file
+      if ((FPartsDone == FPartsStarted) && !HasPendingPart())
+      {
+        Complete = true;
+        Failed = FPartFailed;
+        FileName = FPartFileName;
+        DestFullName = FPartDestFullName;
+        Parts = FPartsStarted;
+        if (!Failed)
+        {
+          const TRemoteFile *File = DebugNotNull(dyn_cast<TRemoteFile>(FPartObject));
+          PreserveTime = FCopyParam->GetPreserveTime();
+          Modification = File->GetModification();
+          NewAttrs = FCopyParam->LocalFileAttrs(*File->GetRights());
+        }
+        // Released already, so that other connections can start
+        // with the next file meanwhile
+        FPartObject = nullptr;
+      }
+    }
+  }
+
+  // No other connection works with the file anymore,
+  // so it is completed without holding the lock
+  if (Complete)
+  {
+    if (Failed)
+    {
+      Terminal->LogEvent(FORMAT("Download of \"%s\" in segments failed, deleting \"%s\".", FileName, DestFullName));
+      ::RemoveFile(ApiPath(DestFullName));
+    }
+    else
+    {
+      if (PreserveTime)
+      {
+        // Each connection has set the timestamp using its own handle,
+        // but the segments written later by other connections have updated it
+        HANDLE Handle = Terminal->TerminalCreateLocalFile(DestFullName, GENERIC_WRITE,
+          FILE_SHARE_READ | FILE_SHARE_WRITE, OPEN_EXISTING, 0);
+        if (Handle != INVALID_HANDLE_VALUE)
+        {
+          // As TFTPFileSystem::PreserveDownloadFileTime and TWebDAVFileSystem::Sink respectively
+          TDSTMode DSTMode =
+            (Terminal->GetSessionData()->GetFSProtocol() == fsFTP) ? dstmUnix : Terminal->GetSessionData()->GetDSTMode();
+          FILETIME WrTime = ::DateTimeToFileTime(Modification, DSTMode);
+          ::SetFileTime(Handle, nullptr, nullptr, &WrTime);
+          SAFE_CLOSE_HANDLE(Handle);
+        }
+      }
+
+      // Not set by the segments, as a read-only file could not be opened by the next one
+      DWORD LocalFileAttrs = Terminal->GetLocalFileAttributes(ApiPath(DestFullName));
+      if ((LocalFileAttrs != INVALID_FILE_ATTRIBUTES) && ((NewAttrs & LocalFileAttrs) != NewAttrs))
+      {
+        Terminal->SetLocalFileAttributes(ApiPath(DestFullName), (LocalFileAttrs | NewAttrs));
+      }
+      Terminal->LogEvent(FORMAT("Download of \"%s\" in %d segments done.", FileName, Parts));
+    }
+  }
+}
+
+bool TParallelOperation::HasPendingPart() const
+{
+  return (FPartObject != nullptr) && !FPartFailed && (FPartOffset < FPartSize);
+}
+
+bool TParallelOperation::StartParts(TTerminal *Terminal, UnicodeString FileName, TObject *Object, UnicodeString TargetDir)
+{
+  bool Result = false;
+  const TRemoteFile *File = dyn_cast<TRemoteFile>(Object);
+  int64_t SegmentSize = Terminal->GetConfiguration()->GetParallelDownloadSegmentSize();
+  // Only one file at a time, the others are downloaded whole meanwhile
+  if ((FSide == osRemote) && (FPartObject == nullptr) && (File != nullptr) &&
+      (SegmentSize > 0) && (File->GetSize() >= 2 * SegmentSize) &&
+      Terminal->GetIsCapable(fsParallelFileTransfers))
+  {
+    TFileMasks::TParams MaskParams;
+    MaskParams.Size = File->GetSize();
+    MaskParams.Modification = File->GetModification();
+    UnicodeString BaseFileName = Terminal->GetBaseFileName(FileName);
+    UnicodeString DestFileName =
+      Terminal->ChangeFileName(FCopyParam, base::UnixExtractFileName(FileName), osRemote, true);
+
+    // Leave anything unusual to the regular download of the whole file.
+    // With a move, each segment would delete the source file.
+    if (FLAGCLEAR(FParams, cpDelete) &&
+        FCopyParam->AllowTransfer(BaseFileName, osRemote, false, MaskParams) &&
+        !FCopyParam->SkipTransfer(FileName, false) &&
+        !FCopyParam->UseAsciiTransfer(BaseFileName, osRemote, MaskParams) &&
+        ::ExtractFilePath(DestFileName).IsEmpty())
+    {
+      UnicodeString DestFullName = ::IncludeTrailingBackslash(TargetDir) + DestFileName;
+      // Fails for existing files, so there is no overwrite or resume to take care of.
+      // The file is allocated in its full size, so that the segments can be written in place.
+      HANDLE Handle = Terminal->TerminalCreateLocalFile(DestFullName, GENERIC_WRITE, 0, CREATE_NEW, FILE_ATTRIBUTE_NORMAL);
+      if (Handle != INVALID_HANDLE_VALUE)
+      {
+        LARGE_INTEGER Size;
+        Size.QuadPart = File->GetSize();
+        bool Allocated =
+          (::SetFilePointerEx(Handle, Size, nullptr, FILE_BEGIN) != FALSE) &&
+          (::SetEndOfFile(Handle) != FALSE);
+        SAFE_CLOSE_HANDLE(Handle);
+        if (!Allocated)
+        {
+          Terminal->LogEvent(FORMAT("Cannot allocate \"%s\", downloading the whole file.", DestFullName));
+          ::RemoveFile(ApiPath(DestFullName));
+        }
+        else
+        {
+          FPartFileName = FileName;
+          FPartObject = Object;
+          FPartTargetDir = TargetDir;
+          FPartDestFullName = DestFullName;
+          FPartSize = File->GetSize();
+          FPartOffset = 0;
+          FPartSegmentSize = SegmentSize;
+          FPartsStarted = 0;
+          FPartsDone = 0;
+          FPartFailed = false;
+          Terminal->LogEvent(FORMAT("Downloading \"%s\" in segments of %s bytes.", FileName, ::Int64ToStr(SegmentSize)));
+          Result = true;
+        }
+      }
+    }
+  }
+  return Result;
+}
+
+TCopyParamType *TParallelOperation::GetNextPart()
+{
+  DebugAssert(HasPendingPart());
+  TCopyParamType *Result = new TCopyParamType(*FCopyParam);
+  int64_t Size = std::min(FPartSegmentSize, FPartSize - FPartOffset);
+  Result->SetPartOffset(FPartOffset);
+  Result->SetPartSize(Size);
+  FPartOffset += Size;
+  FPartsStarted++;
+  return Result;
+}
+
 bool TParallelOperation::CheckEnd(TCollectedFileList *Files)
 {
   bool Result = (FIndex >= Files->GetCount());
@@ -999,10 +1169,26 @@ bool TParallelOperation::CheckEnd(TCollectedFileList *Files)
   return Result;
 }
 
-intptr_t TParallelOperation::GetNext(TTerminal *Terminal, UnicodeString &FileName, TObject *&Object, UnicodeString &TargetDir, bool &Dir, bool &Recursed)
+intptr_t TParallelOperation::GetNext(TTerminal *Terminal, UnicodeString &FileName, TObject *&Object, UnicodeString &TargetDir, bool &Dir, bool &Recursed,
+  TCopyParamType *&CustomCopyParam)
 {
   TGuard Guard(*FSection.get());
   intptr_t Result = 1;
+  CustomCopyParam = nullptr;
+
+  // Remaining segments of a file take precedence over the next files
+  if (HasPendingPart())
+  {
+    FileName = FPartFileName;
+    Object = FPartObject;
+    TargetDir = FPartTargetDir;
+    Dir = false;
+    Recursed = true;
+    CustomCopyParam = GetNextPart();
+    FProbablyEmpty = (FFileList->GetCount() == 0) && !HasPendingPart();
+    return Result;
+  }
+
   TCollectedFileList *Files;
   do
   {
@@ -1095,13 +1281,17 @@ intptr_t TParallelOperation::GetNext(TTerminal *Terminal, UnicodeString &FileNam
 
         FDirectories.insert(TDirectories::value_type(FileName, DirectoryData));
       }
+      else if (StartParts(Terminal, FileName, Object, TargetDir))
+      {
+        CustomCopyParam = GetNextPart();
+      }
 
       FIndex++;
       CheckEnd(Files);
     }
   }
 
-  FProbablyEmpty = (FFileList->GetCount() == 0);
+  FProbablyEmpty = (FFileList->GetCount() == 0) && !HasPendingPart();
 
   return Result;
 }
@@ -1154,6 +1344,7 @@ TTerminal::TTerminal(TObjectClassId Kind) :
   FRememberedPasswordTried(false),
   FRememberedTunnelPasswordTried(false),
   FNesting(0),
+  FDirectoryTreeLevel(0),
   FLastProgressLogged(0),
   FMultipleDestinationFiles(false),
   FReadCurrentDirectoryPending(false),
@@ -3869,6 +4060,27 @@ TRemoteFileList *TTerminal::DoReadDirectoryListing(UnicodeString ADirectory, boo
   return FileList.release();
 }
 
+void TTerminal::BeginDirectoryTree()
+{
+  // Recursive operations nest (e.g. size calculation within synchronization),
+  // the tree is read for the outermost one only
+  if ((FDirectoryTreeLevel == 0) && GetIsCapable(fsDirectoryTree))
+  {
+    FFileSystem->BeginDirectoryTree();
+  }
+  FDirectoryTreeLevel++;
+}
+
+void TTerminal::EndDirectoryTree()
+{
+  DebugAssert(FDirectoryTreeLevel > 0);
+  FDirectoryTreeLevel--;
+  if ((FDirectoryTreeLevel == 0) && (FFileSystem != nullptr) && GetIsCapable(fsDirectoryTree))
+  {
+    FFileSystem->EndDirectoryTree();
+  }
+}
+
 void TTerminal::ProcessDirectory(UnicodeString ADirName,
   TProcessFileEvent CallBackFunc, void *Param, bool UseCache, bool IgnoreErrors)
 {
@@ -4738,7 +4950,21 @@ bool TTerminal::CalculateFilesSize(const TStrings *AFileList,
   Param->Stats = &Stats;
   Param->AllowDirs = AllowDirs;
   Param->Result = true;
-  ProcessFiles(AFileList, foCalculateSize, nb::bind(&TTerminal::DoCalculateFileSize, this), Param.get());
+  BeginDirectoryTree();
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      EndDirectoryTree();
+    };
+    ProcessFiles(AFileList, foCalculateSize, nb::bind(&TTerminal::DoCalculateFileSize, this), Param.get());
+  }
+  __finally
+  {
+#if 0
+    EndDirectoryTree();
+#endif // #if 0
+  };
   Size = Param->Size;
   return Param->Result;
 }
@@ -5888,8 +6114,20 @@ TSynchronizeChecklist *TTerminal::SynchronizeCollect(UnicodeString LocalDirector
   FUseBusyCursor = false;
 
   std::unique_ptr<TSynchronizeChecklist> Checklist(new TSynchronizeChecklist());
+  bool Recurse = FLAGCLEAR(Params, spNoRecurse);
+  if (Recurse)
+  {
+    BeginDirectoryTree();
+  }
   try__catch
   {
+    SCOPE_EXIT
+    {
+      if (Recurse)
+      {
+        EndDirectoryTree();
+      }
+    };
     DoSynchronizeCollectDirectory(LocalDirectory, RemoteDirectory, Mode,
       CopyParam, Params, OnSynchronizeDirectory, Options, sfFirstLevel,
       Checklist.get());
@@ -6762,7 +7000,21 @@ void TTerminal::FilesFind(UnicodeString Directory, const TFileMasks &FileMask,
 
   Params.LoopDetector.RecordVisitedDirectory(Directory);
 
-  DoFilesFind(Directory, Params, Directory);
+  BeginDirectoryTree();
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      EndDirectoryTree();
+    };
+    DoFilesFind(Directory, Params, Directory);
+  }
+  __finally
+  {
+#if 0
+    EndDirectoryTree();
+#endif // #if 0
+  };
 }
 
 void TTerminal::SpaceAvailable(UnicodeString APath,
@@ -6942,8 +7194,11 @@ intptr_t TTerminal::CopyToParallel(TParallelOperation *ParallelOperation, TFileO
   UnicodeString TargetDir;
   bool Dir;
   bool Recursed;
+  TCopyParamType *CustomCopyParam;
 
-  intptr_t Result = ParallelOperation->GetNext(this, FileName, Object, TargetDir, Dir, Recursed);
+  intptr_t Result = ParallelOperation->GetNext(this, FileName, Object, TargetDir, Dir, Recursed, CustomCopyParam);
+  // Copy parameters with a segment of the file to download
+  std::unique_ptr<TCopyParamType> PartCopyParam(CustomCopyParam);
   if (Result > 0)
   {
     std::unique_ptr<TStrings> FilesToCopy(new TStringList());
@@ -6969,19 +7224,28 @@ intptr_t TTerminal::CopyToParallel(TParallelOperation *ParallelOperation, TFileO
       SCOPE_EXIT
       {
         bool Success = (Prev < OperationProgress->GetFilesFinishedSuccessfully());
-        ParallelOperation->Done(FileName, Dir, Success);
+        if (PartCopyParam.get() != nullptr)
+        {
+          ParallelOperation->DonePart(this, Success);
+        }
+        else
+        {
+          ParallelOperation->Done(FileName, Dir, Success);
+        }
         FOperationProgress = nullptr;
       };
+      const TCopyParamType *CopyParam =
+        (PartCopyParam.get() != nullptr) ? PartCopyParam.get() : ParallelOperation->GetCopyParam();
       FOperationProgress = OperationProgress;
       if (ParallelOperation->GetSide() == osLocal)
       {
         FFileSystem->CopyToRemote(
-          FilesToCopy.get(), TargetDir, ParallelOperation->GetCopyParam(), Params, OperationProgress, OnceDoneOperation);
+          FilesToCopy.get(), TargetDir, CopyParam, Params, OperationProgress, OnceDoneOperation);
       }
       else if (DebugAlwaysTrue(ParallelOperation->GetSide() == osRemote))
       {
         FFileSystem->CopyToLocal(
-          FilesToCopy.get(), TargetDir, ParallelOperation->GetCopyParam(), Params, OperationProgress, OnceDoneOperation);
+          FilesToCopy.get(), TargetDir, CopyParam, Params, OperationProgress, OnceDoneOperation);
       }
     }
     __finally
@@ -274,6 +274,7 @@ public:
   friend class TCallbackGuard;
   friend class TSecondaryTerminal;
   friend class TRetryOperationLoop;
+  friend class TParallelOperation;
 
 private:
   TSessionData *FSessionData;
@@ -341,6 +342,7 @@ private:
   bool FRememberedPasswordTried;
   bool FRememberedTunnelPasswordTried;
   intptr_t FNesting;
+  intptr_t FDirectoryTreeLevel;
   UnicodeString FFingerprintScanned;
   DWORD FLastProgressLogged;
   TRemoteDirectory *FOldFiles;
@@ -416,6 +418,8 @@ protected:
   void ProcessDirectory(UnicodeString ADirName,
     TProcessFileEvent CallBackFunc, void *Param = nullptr, bool UseCache = false,
     bool IgnoreErrors = false);
+  void BeginDirectoryTree();
+  void EndDirectoryTree();
   void AnnounceFileListOperation();
   UnicodeString TranslateLockedPath(UnicodeString APath, bool Lock);
   void ReadDirectory(TRemoteFileList *AFileList);
@@ -1149,8 +1153,9 @@ public:
   void RemoveClient();
   intptr_t GetNext(
     TTerminal *Terminal, UnicodeString &FileName, TObject *&Object, UnicodeString &TargetDir,
-    bool &Dir, bool &Recursed);
+    bool &Dir, bool &Recursed, TCopyParamType *&CustomCopyParam);
   void Done(UnicodeString FileName, bool Dir, bool Success);
+  void DonePart(TTerminal *Terminal, bool Success);
 
 #if 0
   __property TOperationSide Side = { read = FSide };
@@ -1189,8 +1194,22 @@ private:
   TFileOperationProgressType *FMainOperationProgress;
   TOperationSide FSide;
   UnicodeString FMainName;
+  // File downloaded in segments, each by a different connection
+  UnicodeString FPartFileName;
+  TObject *FPartObject;
+  UnicodeString FPartTargetDir;
+  UnicodeString FPartDestFullName;
+  int64_t FPartSize;
+  int64_t FPartOffset;
+  int64_t FPartSegmentSize;
+  intptr_t FPartsStarted;
+  intptr_t FPartsDone;
+  bool FPartFailed;
 
   bool CheckEnd(TCollectedFileList *Files);
+  bool HasPendingPart() const;
+  bool StartParts(TTerminal *Terminal, UnicodeString FileName, TObject *Object, UnicodeString TargetDir);
+  TCopyParamType *GetNextPart();
 };
 
 NB_CORE_EXPORT UnicodeString GetSessionUrl(const TTerminal *Terminal, bool WithUserName = false);
@@ -0,0 +1,207 @@
+#include <vcl.h>
+#pragma hdrstop
+
+#include <Common.h>
+#include <rdestl/vector.h>
+
+#include "TlsSessionCache.h"
+#include "CoreMain.h"
+#include "Configuration.h"
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+// Enough for all servers a single process connects to typically,
+// the least recently stored session is dropped beyond that
+#define MAX_SESSIONS 64
+
+class TTlsSessionCache
+{
+  NB_DISABLE_COPY(TTlsSessionCache)
+public:
+  TTlsSessionCache() {}
+
+  SSL_SESSION *Get(const char *Host, int Port, const SSL *Ssl, const X509 *ClientCert);
+  void Put(const char *Host, int Port, const SSL *Ssl, const X509 *ClientCert, SSL_SESSION *Session);
+  void Remove(const char *Host, int Port);
+
+private:
+  struct TEntry
+  {
+    CUSTOM_MEM_ALLOCATION_IMPL
+    AnsiString Key;
+    RawByteString Session;
+  };
+  typedef rde::vector<TEntry> TEntries;
+
+  TCriticalSection FSection;
+  TEntries FEntries;
+
+  static AnsiString GetHostKey(const char *Host, int Port);
+  static AnsiString GetKey(const char *Host, int Port, const SSL *Ssl, const X509 *ClientCert);
+  static bool IsEnabled();
+  intptr_t FindEntry(const AnsiString &Key) const;
+  void RemoveEntry(const AnsiString &Key);
+};
+
+AnsiString TTlsSessionCache::GetHostKey(const char *Host, int Port)
+{
+  return AnsiString(Host) + AnsiString(FORMAT(":%d|", Port));
+}
+
+AnsiString TTlsSessionCache::GetKey(const char *Host, int Port, const SSL *Ssl, const X509 *ClientCert)
+{
+  // TLS versions allowed, both stacks restrict them with SSL_OP_NO_* options
+  unsigned long Protocols = (Ssl != nullptr) ? (SSL_get_options(Ssl) & SSL_OP_NO_SSL_MASK) : 0;
+  AnsiString Result = GetHostKey(Host, Port) + AnsiString(FORMAT("%lx|", Protocols));
+  if (ClientCert != nullptr)
+  {
+    unsigned char Digest[EVP_MAX_MD_SIZE];
+    unsigned int DigestLen = 0;
+    if (X509_digest(ClientCert, EVP_sha256(), Digest, &DigestLen))
+    {
+      Result += AnsiString(BytesToHex(Digest, DigestLen, false));
+    }
+    else
+    {
+      // no way to tell the identity, never share the session
+      Result = AnsiString();
+    }
+  }
+  return Result;
+}
+
+bool TTlsSessionCache::IsEnabled()
+{
+  TConfiguration *Configuration = GetConfiguration();
+  return (Configuration == nullptr) || Configuration->GetTlsSessionCache();
+}
+
+intptr_t TTlsSessionCache::FindEntry(const AnsiString &Key) const
+{
+  for (intptr_t Index = 0; Index < static_cast<intptr_t>(FEntries.size()); Index++)
+  {
+    if (FEntries[Index].Key == Key)
+    {
+      return Index;
+    }
+  }
+  return -1;
+}
+
+SSL_SESSION *TTlsSessionCache::Get(const char *Host, int Port, const SSL *Ssl, const X509 *ClientCert)
+{
+  SSL_SESSION *Result = nullptr;
+  AnsiString Key;
+  if ((Host != nullptr) && (*Host != '\0') && IsEnabled())
+  {
+    Key = GetKey(Host, Port, Ssl, ClientCert);
+  }
+  if (!Key.IsEmpty())
+  {
+    RawByteString Session;
+    {
+      TGuard Guard(FSection);
+      intptr_t Index = FindEntry(Key);
+      if (Index >= 0)
+      {
+        Session = FEntries[Index].Session;
+      }
+    }
+
+    if (!Session.IsEmpty())
+    {
+      const unsigned char *Data = reinterpret_cast<const unsigned char *>(Session.c_str());
+      Result = d2i_SSL_SESSION(nullptr, &Data, static_cast<long>(Session.Length()));
+      // Do not offer sessions the server has surely discarded already
+      if ((Result != nullptr) &&
+          (SSL_SESSION_get_time(Result) + SSL_SESSION_get_timeout(Result) <= static_cast<long>(time(nullptr))))
+      {
+        SSL_SESSION_free(Result);
+        Result = nullptr;
+        RemoveEntry(Key);
+      }
+    }
+  }
+  return Result;
+}
+
+void TTlsSessionCache::Put(const char *Host, int Port, const SSL *Ssl, const X509 *ClientCert, SSL_SESSION *Session)
+{
+  AnsiString Key;
+  if ((Host != nullptr) && (*Host != '\0') && (Session != nullptr) && IsEnabled())
+  {
+    Key = GetKey(Host, Port, Ssl, ClientCert);
+  }
+  if (!Key.IsEmpty())
+  {
+    int Length = i2d_SSL_SESSION(Session, nullptr);
+    if (Length > 0)
+    {
+      RawByteString Data;
+      unsigned char *Buffer = reinterpret_cast<unsigned char *>(Data.SetLength(Length));
+      i2d_SSL_SESSION(Session, &Buffer);
+
+      TGuard Guard(FSection);
+      intptr_t Index = FindEntry(Key);
+      if (Index >= 0)
+      {
+        FEntries.erase(FEntries.begin() + Index);
+      }
+      else if (FEntries.size() >= MAX_SESSIONS)
+      {
+        FEntries.erase(FEntries.begin());
+      }
+      TEntry Entry;
+      Entry.Key = Key;
+      Entry.Session = Data;
+      FEntries.push_back(Entry);
+    }
+  }
+}
+
+void TTlsSessionCache::RemoveEntry(const AnsiString &Key)
+{
+  TGuard Guard(FSection);
+  intptr_t Index = FindEntry(Key);
+  if (Index >= 0)
+  {
+    FEntries.erase(FEntries.begin() + Index);
+  }
+}
+
+void TTlsSessionCache::Remove(const char *Host, int Port)
+{
+  if ((Host != nullptr) && (*Host != '\0'))
+  {
+    // sessions of all TLS versions and client certificates
+    AnsiString HostKey = GetHostKey(Host, Port);
+    TGuard Guard(FSection);
+    for (intptr_t Index = static_cast<intptr_t>(FEntries.size()) - 1; Index >= 0; Index--)
+    {
+      if (FEntries[Index].Key.SubString(1, HostKey.Length()) == HostKey)
+      {
+        FEntries.erase(FEntries.begin() + Index);
+      }
+    }
+  }
+}
+
+static TTlsSessionCache TlsSessionCache;
+
+SSL_SESSION *cached_ssl_session_get(const char *Host, int Port,
+  const SSL *Ssl, const X509 *ClientCert)
+{
+  return TlsSessionCache.Get(Host, Port, Ssl, ClientCert);
+}
+
+void cached_ssl_session_put(const char *Host, int Port,
+  const SSL *Ssl, const X509 *ClientCert, SSL_SESSION *Session)
+{
+  TlsSessionCache.Put(Host, Port, Ssl, ClientCert, Session);
+}
+
+void cached_ssl_session_remove(const char *Host, int Port)
+{
+  TlsSessionCache.Remove(Host, Port);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+typedef struct ssl_session_st SSL_SESSION;
+typedef struct ssl_st SSL;
+typedef struct x509_st X509;
+
+// Process-wide cache of client TLS sessions keyed by host and port,
+// shared by FileZilla (FTPS) and neon (WebDAV over HTTPS), so that
+// new connections to the same server (secondary sessions, queue connections,
+// reconnects) do an abbreviated handshake.
+// A session is offered only to connections allowing the same TLS versions
+// (taken from the options of Ssl) and using the same client certificate
+// (ClientCert, NULL if none), so a connection never resumes a session
+// authenticated with another identity or negotiated with a version it disallows.
+// Sessions are kept serialized, so that no OpenSSL object outlives its owner.
+// Returns a new session to be released with SSL_SESSION_free() or NULL.
+extern "C" SSL_SESSION *cached_ssl_session_get(const char *Host, int Port,
+  const SSL *Ssl, const X509 *ClientCert);
+// Stores a session of an established connection to the host
+extern "C" void cached_ssl_session_put(const char *Host, int Port,
+  const SSL *Ssl, const X509 *ClientCert, SSL_SESSION *Session);
+// Forgets all sessions of the host, to be called when the handshake fails
+extern "C" void cached_ssl_session_remove(const char *Host, int Port);
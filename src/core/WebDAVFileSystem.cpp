@@ -78,6 +78,7 @@ static const int HttpUnauthorized = 401;
 
 #define DAV_PROP_NAMESPACE "DAV:"
 #define MODDAV_PROP_NAMESPACE "http://apache.org/dav/props/"
+#define CALENDARSERVER_PROP_NAMESPACE "http://calendarserver.org/ns/"
 #define PROP_CONTENT_LENGTH "getcontentlength"
 #define PROP_LAST_MODIFIED "getlastmodified"
 #define PROP_CREATIONDATE "creationdate"
@@ -88,6 +89,69 @@ static const int HttpUnauthorized = 401;
 #define PROP_EXECUTABLE "executable"
 #define PROP_OWNER "owner"
 #define PROP_DISPLAY_NAME "displayname"
+#define PROP_ETAG "getetag"
+#define PROP_LOCK_DISCOVERY "lockdiscovery"
+#define PROP_CTAG "getctag"
+#define PROP_SYNC_TOKEN "sync-token"
+
+// Properties read by ParsePropResultSet. Requesting them by name rather than
+// with allprop keeps servers from sending all their dead properties,
+// which are often large (SharePoint, Nextcloud).
+#define FILE_PROPS \
+  { DAV_PROP_NAMESPACE, PROP_CONTENT_LENGTH }, \
+  { DAV_PROP_NAMESPACE, PROP_LAST_MODIFIED }, \
+  { DAV_PROP_NAMESPACE, PROP_CREATIONDATE }, \
+  { DAV_PROP_NAMESPACE, PROP_RESOURCE_TYPE }, \
+  { DAV_PROP_NAMESPACE, PROP_HIDDEN }, \
+  { DAV_PROP_NAMESPACE, PROP_OWNER }, \
+  { DAV_PROP_NAMESPACE, PROP_DISPLAY_NAME }, \
+  { DAV_PROP_NAMESPACE, PROP_ETAG }, \
+  { MODDAV_PROP_NAMESPACE, PROP_EXECUTABLE }
+
+static const ne_propname FileProps[] =
+{
+  FILE_PROPS,
+  { nullptr, nullptr },
+};
+
+// Properties changing whenever anything in the collection changes.
+// Unlike these, getetag of a collection does not change with its members
+// on many servers (e.g. with mod_dav, when a file is overwritten).
+#define VALIDATOR_PROPS \
+  { CALENDARSERVER_PROP_NAMESPACE, PROP_CTAG }, \
+  { DAV_PROP_NAMESPACE, PROP_SYNC_TOKEN }
+
+static const ne_propname ValidatorProps[] =
+{
+  VALIDATOR_PROPS,
+  { nullptr, nullptr },
+};
+
+// For servers that provide the validators, so that the listing can be revalidated later
+static const ne_propname ValidatedListingProps[] =
+{
+  FILE_PROPS,
+  VALIDATOR_PROPS,
+  { nullptr, nullptr },
+};
+
+// With lock discovery registered (ne_lock_register_discovery).
+// Many servers compute lockdiscovery expensively, so it is asked for
+// only once the user works with locks (or with WebDavLockDiscovery session option).
+static const ne_propname LockingListingProps[] =
+{
+  FILE_PROPS,
+  { DAV_PROP_NAMESPACE, PROP_LOCK_DISCOVERY },
+  { nullptr, nullptr },
+};
+
+static const ne_propname ValidatedLockingListingProps[] =
+{
+  FILE_PROPS,
+  { DAV_PROP_NAMESPACE, PROP_LOCK_DISCOVERY },
+  VALIDATOR_PROPS,
+  { nullptr, nullptr },
+};
 
 static std::unique_ptr<TCriticalSection> DebugSection(TraceInitPtr(new TCriticalSection));
 
@@ -264,7 +328,11 @@ TWebDAVFileSystem::TWebDAVFileSystem(TTerminal *ATerminal) :
   FPortNumber(0),
   FIgnoreAuthenticationFailure(iafNo),
   FAuthenticationRetry(false),
-  FNtlmAuthenticationFailed(false)
+  FNtlmAuthenticationFailed(false),
+  FDirectoryValidators(dvUnknown),
+  FDirectoryTreeMode(false),
+  FDirectoryTreeUnsupported(false),
+  FLockDiscovery(false)
 {
 }
 
@@ -282,6 +350,9 @@ void TWebDAVFileSystem::FileTransferProgress(int64_t /*TransferSize*/, int64_t /
 TWebDAVFileSystem::~TWebDAVFileSystem()
 {
   UnregisterFromDebug();
+  // Noop for secondary sessions
+  NeonRemoveConnectionPoolOwner(FTerminal);
+  DiscardDirectoryTree();
 
   {
     TGuard Guard(FNeonLockStoreSection);
@@ -310,6 +381,12 @@ void TWebDAVFileSystem::Open()
   }
 
   RegisterForDebug();
+  FLockDiscovery = FTerminal->GetSessionData()->GetWebDavLockDiscovery();
+  if (FTerminal->GetPasswordSource() == FTerminal)
+  {
+    // Let our secondary sessions share their connections
+    NeonAddConnectionPoolOwner(FTerminal);
+  }
 
   FCurrentDirectory.Clear();
   FHasTrailingSlash = false;
@@ -421,6 +498,11 @@ void TWebDAVFileSystem::InitSession(ne_session_s *Session)
 
   ne_set_connect_timeout(FNeonSession, ToInt(Data->GetTimeout()));
 
+  ne_set_session_flag(Session, NE_SESSFLAG_COMPRESS, GetConfiguration()->GetWebDAVCompression() ? 1 : 0);
+  // Larger socket reads and body blocks than neon's default 8 KB,
+  // so that fast links are not bound by per-call overhead
+  ne_set_io_buffer_size(Session, static_cast<size_t>(GetConfiguration()->GetWebDAVBufferSize()));
+
   ne_set_session_private(Session, SESSION_FS_KEY, this);
 }
 
@@ -480,6 +562,15 @@ void TWebDAVFileSystem::NeonOpen(UnicodeString &CorrectedUrl, UnicodeString Url)
   ne_hook_post_send(FNeonSession, NeonPostSend, this);
   ne_hook_post_headers(FNeonSession, NeonPostHeaders, this);
 
+  if (NeonTakePooledConnection(FNeonSession, FTerminal->GetPasswordSource()))
+  {
+    FTerminal->LogEvent(L"Reusing connection of a closed session.");
+    if (Ssl)
+    {
+      CollectTLSSessionInfo();
+    }
+  }
+
   TAutoFlag Flag(FInitialHandshake);
   ExchangeCapabilities(Path.c_str(), CorrectedUrl);
 }
@@ -575,6 +666,15 @@ void TWebDAVFileSystem::CloseNeonSession()
 void TWebDAVFileSystem::Close()
 {
   DebugAssert(FActive);
+  if (FTerminal->GetPasswordSource() == FTerminal)
+  {
+    NeonRemoveConnectionPoolOwner(FTerminal);
+  }
+  else if (FNeonSession != nullptr)
+  {
+    // Keep the connection alive for the next secondary session of the same main session
+    NeonPoolConnection(FNeonSession, FTerminal->GetPasswordSource());
+  }
   CloseNeonSession();
   FTerminal->Closed();
   FActive = false;
@@ -715,7 +815,9 @@ bool TWebDAVFileSystem::IsCapable(intptr_t Capability) const
   case fcResolveSymlink:
   case fsSkipTransfer:
   case fsParallelTransfers:
+  case fsParallelFileTransfers:
   case fcRemoteCopy:
+  case fsDirectoryTree:
     return true;
 
   case fcUserGroupListing:
@@ -881,6 +983,27 @@ struct TReadFileData
   TRemoteFileList *FileList;
 };
 
+struct TReadTreeData
+{
+  CUSTOM_MEM_ALLOCATION_IMPL
+  TWebDAVFileSystem *FileSystem;
+  UnicodeString Root;
+};
+
+static const ne_propname *GetListingProps(bool LockDiscovery, bool Validators)
+{
+  const ne_propname *Result;
+  if (LockDiscovery)
+  {
+    Result = Validators ? ValidatedLockingListingProps : LockingListingProps;
+  }
+  else
+  {
+    Result = Validators ? ValidatedListingProps : FileProps;
+  }
+  return Result;
+}
+
 int TWebDAVFileSystem::ReadDirectoryInternal(
   UnicodeString APath, TRemoteFileList *AFileList)
 {
@@ -890,21 +1013,30 @@ int TWebDAVFileSystem::ReadDirectoryInternal(
   Data.FileList = AFileList;
   ClearNeonError();
   ne_propfind_handler *PropFindHandler = ne_propfind_create(FNeonSession, PathToNeon(APath), NE_DEPTH_ONE);
-  void *DiscoveryContext = ne_lock_register_discovery(PropFindHandler);
+  void *DiscoveryContext = FLockDiscovery ? ne_lock_register_discovery(PropFindHandler) : nullptr;
   int Result;
   try__finally
   {
     SCOPE_EXIT
     {
-      ne_lock_discovery_free(DiscoveryContext);
+      if (DiscoveryContext != nullptr)
+      {
+        ne_lock_discovery_free(DiscoveryContext);
+      }
       ne_propfind_destroy(PropFindHandler);
     };
-    Result = ne_propfind_allprop(PropFindHandler, NeonPropsResult, &Data);
+    // NeonPropsResult is called, and the file added to the list,
+    // as soon as each response is parsed
+    const ne_propname *Props = GetListingProps(FLockDiscovery, (FDirectoryValidators == dvSupported));
+    Result = ne_propfind_named(PropFindHandler, Props, NeonPropsResult, &Data);
   }
   __finally
   {
 #if 0
-    ne_lock_discovery_free(DiscoveryContext);
+    if (DiscoveryContext != nullptr)
+    {
+      ne_lock_discovery_free(DiscoveryContext);
+    }
     ne_propfind_destroy(PropFindHandler);
 #endif // #if 0
   };
@@ -943,12 +1075,201 @@ void TWebDAVFileSystem::ReadDirectory(TRemoteFileList *AFileList)
   UnicodeString Path = DirectoryPath(AFileList->GetDirectory());
   TOperationVisualizer Visualizer(FTerminal->GetUseBusyCursor());
 
-  int NeonStatus = ReadDirectoryInternal(Path, AFileList);
-  if (IsValidRedirect(NeonStatus, Path))
+  bool FromTree = FDirectoryTreeMode && ReadDirectoryFromTree(Path, AFileList);
+
+  // Listing cached by a previous read of the directory, possibly invalidated since,
+  // can be reused, if the server confirms that the directory has not changed
+  bool Revalidated = false;
+  if (!FromTree &&
+      FTerminal->GetSessionData()->GetCacheDirectories() && (FDirectoryValidators != dvUnsupported))
   {
-    NeonStatus = ReadDirectoryInternal(Path, AFileList);
+    UnicodeString CachedValidator = FTerminal->FDirectoryCache->GetFileListValidator(AFileList->GetDirectory());
+    // The first listing also probes, if the server supports the validators at all
+    if (!CachedValidator.IsEmpty() || (FDirectoryValidators == dvUnknown))
+    {
+      UnicodeString Validator = ReadDirectoryValidator(Path);
+      Revalidated =
+        !CachedValidator.IsEmpty() && (Validator == CachedValidator) &&
+        FTerminal->FDirectoryCache->GetValidFileList(AFileList->GetDirectory(), Validator, AFileList);
+    }
   }
-  CheckStatus(NeonStatus);
+
+  if (Revalidated)
+  {
+    AFileList->FTimestamp = Now();
+    FTerminal->LogEvent(L"Directory has not changed, using cached content.");
+  }
+  else if (!FromTree)
+  {
+    int NeonStatus = ReadDirectoryInternal(Path, AFileList);
+    if (IsValidRedirect(NeonStatus, Path))
+    {
+      NeonStatus = ReadDirectoryInternal(Path, AFileList);
+    }
+    CheckStatus(NeonStatus);
+  }
+}
+
+UnicodeString TWebDAVFileSystem::ReadDirectoryValidator(UnicodeString APath)
+{
+  UnicodeString Result;
+  ClearNeonError();
+  int NeonStatus =
+    ne_simple_propfind(FNeonSession, PathToNeon(APath), NE_DEPTH_ZERO, ValidatorProps,
+      NeonValidatorResult, &Result);
+  // Any error is reported by the actual listing
+  if (NeonStatus == NE_OK)
+  {
+    if (!Result.IsEmpty())
+    {
+      FDirectoryValidators = dvSupported;
+    }
+    else if (FDirectoryValidators == dvUnknown)
+    {
+      FTerminal->LogEvent(L"Server does not provide collection tags, cached directories will not be revalidated.");
+      FDirectoryValidators = dvUnsupported;
+    }
+  }
+  return Result;
+}
+
+bool TWebDAVFileSystem::ReadDirectoryFromTree(UnicodeString APath, TRemoteFileList *AFileList)
+{
+  UnicodeString Root = base::UnixExcludeTrailingBackslash(GetAbsolutePath(APath, false));
+  TDirectoryTree::iterator Iter = FDirectoryTree.find(Root);
+  if ((Iter == FDirectoryTree.end()) && !FDirectoryTreeUnsupported)
+  {
+    // Subdirectory missing in a tree already read was either created since,
+    // or the server has not sent the whole tree, do not ask for it again
+    bool InTree = false;
+    for (intptr_t Index = 0; !InTree && (Index < static_cast<intptr_t>(FDirectoryTreeRoots.size())); ++Index)
+    {
+      InTree = base::UnixIsChildPath(FDirectoryTreeRoots[Index], Root);
+    }
+
+    if (!InTree)
+    {
+      ReadDirectoryTree(APath, Root);
+      Iter = FDirectoryTree.find(Root);
+    }
+  }
+
+  bool Result = (Iter != FDirectoryTree.end());
+  if (Result)
+  {
+    // The recursive operation reads each directory once,
+    // so the files can be moved rather than copied
+    std::unique_ptr<TRemoteFileList> TreeList(Iter->second);
+    FDirectoryTree.erase(Root);
+    TreeList->SetOwnsObjects(false);
+    for (intptr_t Index = 0; Index < TreeList->GetCount(); ++Index)
+    {
+      AFileList->AddFile(TreeList->GetFile(Index));
+    }
+    AFileList->SetValidator(TreeList->GetValidator());
+  }
+  return Result;
+}
+
+void TWebDAVFileSystem::ReadDirectoryTree(UnicodeString APath, UnicodeString ARoot)
+{
+  FTerminal->LogEvent(FORMAT("Reading whole directory tree \"%s\".", ARoot));
+  TReadTreeData Data;
+  Data.FileSystem = this;
+  Data.Root = ARoot;
+  ClearNeonError();
+  ne_propfind_handler *PropFindHandler = ne_propfind_create(FNeonSession, PathToNeon(APath), NE_DEPTH_INFINITE);
+  void *DiscoveryContext = FLockDiscovery ? ne_lock_register_discovery(PropFindHandler) : nullptr;
+  int NeonStatus;
+  try__finally
+  {
+    SCOPE_EXIT
+    {
+      if (DiscoveryContext != nullptr)
+      {
+        ne_lock_discovery_free(DiscoveryContext);
+      }
+      ne_propfind_destroy(PropFindHandler);
+    };
+    const ne_propname *Props = GetListingProps(FLockDiscovery, (FDirectoryValidators == dvSupported));
+    NeonStatus = ne_propfind_named(PropFindHandler, Props, NeonTreeResult, &Data);
+  }
+  __finally
+  {
+#if 0
+    if (DiscoveryContext != nullptr)
+    {
+      ne_lock_discovery_free(DiscoveryContext);
+    }
+    ne_propfind_destroy(PropFindHandler);
+#endif // #if 0
+  };
+
+  if (NeonStatus == NE_OK)
+  {
+    FDirectoryTreeRoots.push_back(ARoot);
+  }
+  else
+  {
+    // What was received of the tree may be incomplete
+    DiscardDirectoryTree();
+    // Redirect is resolved by the regular listing, and the tree is tried for the next directory
+    if (NeonStatus != NE_REDIRECT)
+    {
+      // Typically 403 with DAV:propfind-finite-depth precondition (RFC 4918, 9.1)
+      FTerminal->LogEvent(FORMAT("Server does not allow reading whole directory tree (%s), reading directories one by one.", GetNeonError()));
+      FDirectoryTreeUnsupported = true;
+    }
+  }
+}
+
+TRemoteFileList *TWebDAVFileSystem::GetDirectoryTreeList(UnicodeString APath)
+{
+  TRemoteFileList *Result;
+  TDirectoryTree::iterator Iter = FDirectoryTree.find(APath);
+  if (Iter != FDirectoryTree.end())
+  {
+    Result = Iter->second;
+  }
+  else
+  {
+    Result = new TRemoteFileList();
+    Result->SetDirectory(APath);
+    FDirectoryTree.insert(TDirectoryTree::value_type(APath, Result));
+  }
+  return Result;
+}
+
+void TWebDAVFileSystem::DiscardDirectoryTree()
+{
+  for (TDirectoryTree::iterator Iter = FDirectoryTree.begin(); Iter != FDirectoryTree.end(); ++Iter)
+  {
+    delete Iter->second;
+  }
+  FDirectoryTree.clear();
+  FDirectoryTreeRoots.clear();
+}
+
+UnicodeString TWebDAVFileSystem::GetDirectoryValidator(const ne_prop_result_set *Results)
+{
+  UnicodeString Result;
+  const char *Value = GetNeonProp(Results, PROP_CTAG, CALENDARSERVER_PROP_NAMESPACE);
+  if (Value == nullptr)
+  {
+    Value = GetNeonProp(Results, PROP_SYNC_TOKEN);
+  }
+  if (Value != nullptr)
+  {
+    Result = StrFromNeon(Value);
+  }
+  return Result;
+}
+
+void TWebDAVFileSystem::NeonValidatorResult(
+  void *UserData, const ne_uri * /*Uri*/, const ne_prop_result_set *Results)
+{
+  UnicodeString &Validator = *static_cast<UnicodeString *>(UserData);
+  Validator = GetDirectoryValidator(Results);
 }
 
 void TWebDAVFileSystem::ReadSymlink(TRemoteFile * /*SymlinkFile*/,
@@ -976,6 +1297,8 @@ void TWebDAVFileSystem::NeonPropsResult(
     if (base::UnixSamePath(Path, FileListPath))
     {
       Path = base::UnixIncludeTrailingBackslash(base::UnixIncludeTrailingBackslash(Path) + L"..");
+      // Empty, unless ValidatedListingProps were requested
+      Data.FileList->SetValidator(GetDirectoryValidator(Results));
     }
     std::unique_ptr<TRemoteFile> File(new TRemoteFile());
     File->SetTerminal(Data.FileSystem->FTerminal);
@@ -988,6 +1311,37 @@ void TWebDAVFileSystem::NeonPropsResult(
   }
 }
 
+void TWebDAVFileSystem::NeonTreeResult(
+  void *UserData, const ne_uri *Uri, const ne_prop_result_set *Results)
+{
+  UnicodeString Path = StrFromNeon(PathUnescape(Uri->path).c_str());
+  UnicodeString FullPath = base::UnixExcludeTrailingBackslash(Path);
+
+  TReadTreeData &Data = *static_cast<TReadTreeData *>(UserData);
+  TWebDAVFileSystem *FileSystem = Data.FileSystem;
+  bool Collection = base::UnixSamePath(Path, Data.Root);
+  if (!Collection)
+  {
+    // Entry of the parent collection listing
+    std::unique_ptr<TRemoteFile> File(new TRemoteFile());
+    File->SetTerminal(FileSystem->FTerminal);
+    FileSystem->ParsePropResultSet(File.get(), Path, Results);
+    Collection = File->GetIsDirectory();
+    FileSystem->GetDirectoryTreeList(base::UnixExtractFileDir(FullPath))->AddFile(File.release());
+  }
+
+  if (Collection)
+  {
+    // Parent directory entry of the collection's own listing, as with Depth: 1 (NeonPropsResult)
+    TRemoteFileList *FileList = FileSystem->GetDirectoryTreeList(FullPath);
+    FileList->SetValidator(GetDirectoryValidator(Results));
+    std::unique_ptr<TRemoteFile> File(new TRemoteFile());
+    File->SetTerminal(FileSystem->FTerminal);
+    FileSystem->ParsePropResultSet(File.get(), base::UnixIncludeTrailingBackslash(base::UnixIncludeTrailingBackslash(Path) + L".."), Results);
+    FileList->AddFile(File.release());
+  }
+}
+
 const char *TWebDAVFileSystem::GetNeonProp(
   const ne_prop_result_set *Results, const char *Name, const char *NameSpace)
 {
@@ -1080,6 +1434,12 @@ void TWebDAVFileSystem::ParsePropResultSet(TRemoteFile *AFile,
     AFile->SetDisplayName(StrFromNeon(DisplayName));
   }
 
+  const char *ETag = GetNeonProp(Results, PROP_ETAG);
+  if (ETag != nullptr)
+  {
+    AFile->SetETag(StrFromNeon(ETag));
+  }
+
   const UnicodeString RightsDelimiter(L", ");
   UnicodeString HumanRights;
 
@@ -1143,7 +1503,7 @@ intptr_t TWebDAVFileSystem::CustomReadFileInternal(UnicodeString AFileName,
   Data.FileList = nullptr;
   ClearNeonError();
   int Result =
-    ne_simple_propfind(FNeonSession, PathToNeon(AFileName), NE_DEPTH_ZERO, nullptr,
+    ne_simple_propfind(FNeonSession, PathToNeon(AFileName), NE_DEPTH_ZERO, FileProps,
       NeonPropsResult, &Data);
   if (Result == NE_OK)
   {
@@ -1975,6 +2335,11 @@ void TWebDAVFileSystem::NeonPreSend(
     // We do not know yet of any server that fails when the header is used,
     // so it's added unconditionally.
     ne_buffer_zappend(Header, "Translate: f\r\n");
+
+    if (!FileSystem->FDownloadIfRange.IsEmpty())
+    {
+      ne_buffer_concat(Header, "If-Range: ", FileSystem->FDownloadIfRange.c_str(), "\r\n", nullptr);
+    }
   }
 
   const UnicodeString ContentTypeHeaderPrefix(L"Content-Type: ");
@@ -2191,7 +2556,9 @@ int TWebDAVFileSystem::NeonBodyReader(void *UserData, const char *Buf, size_t Le
       // GET responses (with file contents).
       // But this won't work when downloading text files that have text
       // content type on their own, hence the additional not-downloading test.
+      // Compressed responses are decoded only later by the reader of the request
       if (!FileSystem->FDownloading &&
+        (ne_get_response_header(Request, "Content-Encoding") == nullptr) &&
         ((ne_strcasecmp(ContentType.type, "text") == 0) ||
           media_type_is_xml(&ContentType)))
       {
@@ -2294,7 +2661,15 @@ void TWebDAVFileSystem::Sink(UnicodeString AFileName,
   else
   {
     FTerminal->LogEvent(FORMAT("Copying \"%s\" to local directory started.", AFileName));
-    if (::FileExists(ApiPath(DestFullName)))
+    // Segment of a file downloaded in parallel,
+    // the file was already created by TParallelOperation
+    bool Part = (CopyParam->GetPartSize() >= 0);
+    if (Part)
+    {
+      FTerminal->LogEvent(FORMAT("Downloading segment at offset %s of %s bytes.",
+        ::Int64ToStr(CopyParam->GetPartOffset()), ::Int64ToStr(CopyParam->GetPartSize())));
+    }
+    else if (::FileExists(ApiPath(DestFullName)))
     {
       int64_t Size = 0;
       int64_t MTime = 0;
@@ -2316,7 +2691,7 @@ void TWebDAVFileSystem::Sink(UnicodeString AFileName,
     }
 
     // Suppose same data size to transfer as to write
-    OperationProgress->SetTransferSize(AFile->GetSize());
+    OperationProgress->SetTransferSize(Part ? CopyParam->GetPartSize() : AFile->GetSize());
     OperationProgress->SetLocalSize(OperationProgress->GetTransferSize());
 
     DWORD LocalFileAttrs = INVALID_FILE_ATTRIBUTES;
@@ -2342,14 +2717,25 @@ void TWebDAVFileSystem::Sink(UnicodeString AFileName,
     FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(TRANSFER_ERROR, AFileName), "",
     [&]()
     {
-      HANDLE LocalFileHandle = FTerminal->TerminalCreateLocalFile(DestFullName,
+      HANDLE LocalFileHandle;
+      if (Part)
+      {
+        // Other segments are written to the same file concurrently
+        LocalFileHandle = FTerminal->TerminalCreateLocalFile(DestFullName,
+          GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, OPEN_EXISTING, 0);
+      }
+      else
+      {
+        LocalFileHandle = FTerminal->TerminalCreateLocalFile(DestFullName,
           GENERIC_WRITE, 0, FLAGSET(AParams, cpNoConfirmation) ? CREATE_ALWAYS : CREATE_NEW, 0);
+      }
       if (LocalFileHandle == INVALID_HANDLE_VALUE)
       {
         ThrowSkipFileNull();
       }
 
-      bool DeleteLocalFile = true;
+      // For segments, the file is deleted by TParallelOperation, once all segments finish
+      bool DeleteLocalFile = !Part;
 
       int FD = -1;
       try__finally
@@ -2386,10 +2772,45 @@ void TWebDAVFileSystem::Sink(UnicodeString AFileName,
         TAutoFlag DownloadingFlag(FDownloading);
 
         ClearNeonError();
-        CheckStatus(ne_get(FNeonSession, PathToNeon(AFileName), FD));
+        if (Part)
+        {
+          if (_lseeki64(FD, CopyParam->GetPartOffset(), SEEK_SET) < 0)
+          {
+            ThrowSkipFileNull();
+          }
+
+          // Makes the server respond with the whole file (what we reject),
+          // if it has changed since it was listed,
+          // so that all segments come from the same version of the file.
+          // Weak tags cannot be used for ranges.
+          UnicodeString ETag = AFile->GetETag();
+          if (!ETag.IsEmpty() && !StartsStr(L"W/", ETag))
+          {
+            FDownloadIfRange = StrToNeon(ETag);
+          }
+          else
+          {
+            FTerminal->LogEvent(L"No entity tag, cannot make sure that all segments are from the same version of the file.");
+          }
+          SCOPE_EXIT
+          {
+            FDownloadIfRange = RawByteString();
+          };
+
+          ne_content_range Range;
+          Range.start = CopyParam->GetPartOffset();
+          Range.end = CopyParam->GetPartOffset() + CopyParam->GetPartSize() - 1;
+          Range.total = 0;
+          CheckStatus(ne_get_range(FNeonSession, PathToNeon(AFileName), &Range, FD));
+        }
+        else
+        {
+          CheckStatus(ne_get(FNeonSession, PathToNeon(AFileName), FD));
+        }
         DeleteLocalFile = false;
 
-        if (CopyParam->GetPreserveTime())
+        // For segments, the timestamp is set by TParallelOperation once the whole file is downloaded
+        if (!Part && CopyParam->GetPreserveTime())
         {
           TDateTime Modification = AFile->GetModification();
           FILETIME WrTime = DateTimeToFileTime(Modification, FTerminal->GetSessionData()->GetDSTMode());
@@ -2429,7 +2850,8 @@ void TWebDAVFileSystem::Sink(UnicodeString AFileName,
       LocalFileAttrs = faArchive;
     }
     DWORD NewAttrs = CopyParam->LocalFileAttrs(*AFile->GetRights());
-    if ((NewAttrs & LocalFileAttrs) != NewAttrs)
+    // For segments, attributes are set by TParallelOperation once the whole file is downloaded
+    if (!Part && ((NewAttrs & LocalFileAttrs) != NewAttrs))
     {
       FileOperationLoopCustom(FTerminal, OperationProgress, True, FMTLOAD(CANT_SET_ATTRS, DestFullName), "",
       [&]()
@@ -2849,6 +3271,7 @@ void TWebDAVFileSystem::GetSupportedChecksumAlgs(TStrings * /*Algs*/)
 
 void TWebDAVFileSystem::LockFile(UnicodeString /*AFileName*/, const TRemoteFile *AFile)
 {
+  RequireLockDiscovery();
   ClearNeonError();
   struct ne_lock *Lock = ne_lock_create();
   try__finally
@@ -2898,6 +3321,17 @@ void TWebDAVFileSystem::RequireLockStore()
   }
 }
 
+void TWebDAVFileSystem::RequireLockDiscovery()
+{
+  // Once the user works with locks, show lock state of files in listings.
+  // Until then, the lock state is discovered only for the file being unlocked.
+  if (!FLockDiscovery)
+  {
+    FTerminal->LogEvent(L"Enabling lock discovery in directory listings.");
+    FLockDiscovery = true;
+  }
+}
+
 void TWebDAVFileSystem::LockResult(void *UserData, const struct ne_lock *Lock,
   const ne_uri * /*Uri*/, const ne_status * /*Status*/)
 {
@@ -2931,6 +3365,7 @@ void TWebDAVFileSystem::DiscardLock(RawByteString APath)
 
 void TWebDAVFileSystem::UnlockFile(UnicodeString AFileName, const TRemoteFile *AFile)
 {
+  RequireLockDiscovery();
   ClearNeonError();
   struct ne_lock *Lock = ne_lock_create();
   try__finally
@@ -2996,6 +3431,18 @@ void TWebDAVFileSystem::UnlockFile(UnicodeString AFileName, const TRemoteFile *A
   };
 }
 
+void TWebDAVFileSystem::BeginDirectoryTree()
+{
+  DebugAssert(!FDirectoryTreeMode && FDirectoryTree.empty());
+  FDirectoryTreeMode = true;
+}
+
+void TWebDAVFileSystem::EndDirectoryTree()
+{
+  FDirectoryTreeMode = false;
+  DiscardDirectoryTree();
+}
+
 void TWebDAVFileSystem::UpdateFromMain(TCustomFileSystem *AMainFileSystem)
 {
   TWebDAVFileSystem *MainFileSystem = dyn_cast<TWebDAVFileSystem>(AMainFileSystem);
@@ -5,6 +5,7 @@
 #include <ne_utils.h>
 #include <ne_string.h>
 #include <ne_request.h>
+#include <rdestl/map.h>
 #include <FileSystems.h>
 
 struct TWebDAVCertificateData;
@@ -88,6 +89,8 @@ public:
   virtual void LockFile(UnicodeString AFileName, const TRemoteFile *AFile) override;
   virtual void UnlockFile(UnicodeString AFileName, const TRemoteFile *AFile) override;
   virtual void UpdateFromMain(TCustomFileSystem *AMainFileSystem) override;
+  virtual void BeginDirectoryTree() override;
+  virtual void EndDirectoryTree() override;
 
   void NeonDebug(UnicodeString Message);
 
@@ -127,6 +130,8 @@ protected:
   void ClearNeonError();
   static void NeonPropsResult(
     void *UserData, const ne_uri *Uri, const ne_prop_result_set_s *Results);
+  static void NeonTreeResult(
+    void *UserData, const ne_uri *Uri, const ne_prop_result_set_s *Results);
   void ParsePropResultSet(TRemoteFile *AFile,
     UnicodeString APath, const ne_prop_result_set_s *Results);
   void TryOpenDirectory(UnicodeString ADirectory);
@@ -150,11 +155,14 @@ protected:
   bool CancelTransfer();
   UnicodeString GetNeonError() const;
   static void NeonQuotaResult(void *UserData, const ne_uri *Uri, const ne_prop_result_set_s *Results);
+  static void NeonValidatorResult(void *UserData, const ne_uri *Uri, const ne_prop_result_set_s *Results);
+  static UnicodeString GetDirectoryValidator(const ne_prop_result_set_s *Results);
   static const char *GetNeonProp(const ne_prop_result_set_s *Results,
     const char *Name, const char *NameSpace = nullptr);
   static void LockResult(void *UserData, const struct ne_lock *Lock,
     const ne_uri *Uri, const ne_status *Status);
   void RequireLockStore();
+  void RequireLockDiscovery();
   static void InitSslSession(ssl_st *Ssl, ne_session *Session);
   void InitSslSessionImpl(ssl_st *Ssl) const;
   void NeonAddAuthentication(bool UseNegotiate);
@@ -173,6 +181,8 @@ private:
   bool FStoredPasswordTried;
   bool FUploading;
   bool FDownloading;
+  // Entity tag the downloaded segment has to match
+  RawByteString FDownloadIfRange;
   UnicodeString FUploadMimeType;
   ne_session_s *FNeonSession;
   ne_lock_store_s *FNeonLockStore;
@@ -190,6 +200,17 @@ private:
   UnicodeString FLastAuthorizationProtocol;
   bool FAuthenticationRetry;
   bool FNtlmAuthenticationFailed;
+  // Whether the server provides ctag or sync-token of collections
+  enum TDirectoryValidators { dvUnknown, dvSupported, dvUnsupported } FDirectoryValidators;
+  // Listings of subtrees read with Depth: infinity during a recursive operation,
+  // by absolute path, each is handed over to the first read of the directory
+  typedef rde::map<UnicodeString, TRemoteFileList *> TDirectoryTree;
+  TDirectoryTree FDirectoryTree;
+  TUnicodeStringVector FDirectoryTreeRoots;
+  bool FDirectoryTreeMode;
+  bool FDirectoryTreeUnsupported;
+  // Whether listings ask for lockdiscovery
+  bool FLockDiscovery;
 
   void CustomReadFile(UnicodeString AFileName,
     TRemoteFile *&AFile, TRemoteFile *ALinkedByFile);
@@ -203,6 +224,11 @@ private:
   UnicodeString GetRedirectUrl() const;
   UnicodeString ParsePathFromUrl(UnicodeString Url) const;
   int ReadDirectoryInternal(UnicodeString APath, TRemoteFileList *AFileList);
+  UnicodeString ReadDirectoryValidator(UnicodeString APath);
+  bool ReadDirectoryFromTree(UnicodeString APath, TRemoteFileList *AFileList);
+  void ReadDirectoryTree(UnicodeString APath, UnicodeString ARoot);
+  TRemoteFileList *GetDirectoryTreeList(UnicodeString APath);
+  void DiscardDirectoryTree();
   int RenameFileInternal(UnicodeString AFileName, UnicodeString ANewName);
   int CopyFileInternal(UnicodeString AFileName, UnicodeString ANewName);
   bool IsValidRedirect(intptr_t NeonStatus, UnicodeString &APath) const;
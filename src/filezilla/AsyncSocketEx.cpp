@@ -10,6 +10,7 @@
 #include "AsyncSocketEx.h"
 
 #include "AsyncSocketExLayer.h"
+#include <ResolverCache.h>
 
 #ifndef GWL_USERDATA
 #define GWL_USERDATA        (-21)
@@ -299,6 +300,14 @@ public:
                 if (pSocket->TryNextProtocol())
                                     break;
               }
+              if (!nErrorCode)
+              {
+                // Let the resolver cache know which address family works
+                SOCKADDR_STORAGE Peer;
+                int PeerLen = sizeof(Peer);
+                if (!getpeername(pSocket->m_SocketData.hSocket, (LPSOCKADDR)&Peer, &PeerLen))
+                  cached_addrinfo_connected((LPSOCKADDR)&Peer);
+              }
               pSocket->SetState(connected);
             }
             else if (pSocket->GetState() == attached && !nErrorCode)
@@ -877,7 +886,7 @@ void CAsyncSocketEx::Close()
   }
   if (m_SocketData.addrInfo)
   {
-    if (p_freeaddrinfo) p_freeaddrinfo(m_SocketData.addrInfo);
+    cached_freeaddrinfo(m_SocketData.addrInfo);
     m_SocketData.addrInfo = 0;
     m_SocketData.nextAddr = 0;
   }
@@ -1101,7 +1110,7 @@ BOOL CAsyncSocketEx::Connect(LPCTSTR lpszHostAddress, UINT nHostPort)
 
     if (m_SocketData.addrInfo)
     {
-      if (p_freeaddrinfo) p_freeaddrinfo(m_SocketData.addrInfo);
+      cached_freeaddrinfo(m_SocketData.addrInfo);
       m_SocketData.addrInfo = 0;
       m_SocketData.nextAddr = 0;
     }
@@ -1115,7 +1124,7 @@ BOOL CAsyncSocketEx::Connect(LPCTSTR lpszHostAddress, UINT nHostPort)
     hints.ai_family = m_SocketData.nFamily;
     hints.ai_socktype = SOCK_STREAM;
     _snprintf(port, 9, "%lu", nHostPort);
-    error = p_getaddrinfo ? p_getaddrinfo(T2CA(lpszHostAddress), port, &hints, &m_SocketData.addrInfo) : 1;
+    error = cached_getaddrinfo(T2CA(lpszHostAddress), port, &hints, &m_SocketData.addrInfo);
     if (error)
       return FALSE;
 
@@ -1194,7 +1203,7 @@ BOOL CAsyncSocketEx::Connect(LPCTSTR lpszHostAddress, UINT nHostPort)
 
     if (!m_SocketData.nextAddr)
     {
-      if (p_freeaddrinfo) p_freeaddrinfo(m_SocketData.addrInfo);
+      cached_freeaddrinfo(m_SocketData.addrInfo);
       m_SocketData.nextAddr = 0;
       m_SocketData.addrInfo = 0;
     }
@@ -1677,7 +1686,7 @@ bool CAsyncSocketEx::TryNextProtocol()
 
   if (!m_SocketData.nextAddr)
   {
-    if (p_freeaddrinfo) p_freeaddrinfo(m_SocketData.addrInfo);
+    cached_freeaddrinfo(m_SocketData.addrInfo);
     m_SocketData.nextAddr = 0;
     m_SocketData.addrInfo = 0;
   }
@@ -10,6 +10,7 @@
 #include "AsyncSocketExLayer.h"
 
 #include "AsyncSocketEx.h"
+#include <ResolverCache.h>
 
 #define WM_SOCKETEX_NOTIFY (WM_USER+3)
 
@@ -193,7 +194,7 @@ void CAsyncSocketExLayer::CloseNext()
 {
   if (m_addrInfo)
   {
-    if (p_freeaddrinfo) p_freeaddrinfo(m_addrInfo);
+    cached_freeaddrinfo(m_addrInfo);
   }
   m_nextAddr = 0;
   m_addrInfo = 0;
@@ -322,7 +323,7 @@ BOOL CAsyncSocketExLayer::ConnectNext(LPCTSTR lpszHostAddress, UINT nHostPort)
     int error;
     char port[10];
 
-    if (p_freeaddrinfo) p_freeaddrinfo(m_addrInfo);
+    cached_freeaddrinfo(m_addrInfo);
     m_nextAddr = 0;
     m_addrInfo = 0;
 
@@ -331,7 +332,7 @@ BOOL CAsyncSocketExLayer::ConnectNext(LPCTSTR lpszHostAddress, UINT nHostPort)
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags = 0;
     _snprintf(port, 9, "%lu", nHostPort);
-    error = p_getaddrinfo ? p_getaddrinfo(T2CA(lpszHostAddress), port, &hints, &res0) : 1;
+    error = cached_getaddrinfo(T2CA(lpszHostAddress), port, &hints, &res0);
     if (error)
       return FALSE;
 
@@ -409,7 +410,7 @@ BOOL CAsyncSocketExLayer::ConnectNext(LPCTSTR lpszHostAddress, UINT nHostPort)
     }
     else
     {
-      if (p_freeaddrinfo) p_freeaddrinfo(res0);
+      cached_freeaddrinfo(res0);
     }
 
     if (INVALID_SOCKET == m_pOwnerSocket->GetSocketHandle())
@@ -960,7 +961,7 @@ bool CAsyncSocketExLayer::TryNextProtocol()
 
   if (!m_nextAddr)
   {
-    if (p_freeaddrinfo) p_freeaddrinfo(m_addrInfo);
+    cached_freeaddrinfo(m_addrInfo);
     m_nextAddr = 0;
     m_addrInfo = 0;
   }
@@ -9,6 +9,7 @@
 #include "stdafx.h"
 #include "AsyncSslSocketLayer.h"
 #include <TextsCore.h>
+#include <TlsSessionCache.h>
 
 #include <openssl/x509v3.h>
 #include <openssl/err.h>
@@ -54,6 +55,7 @@ CAsyncSslSocketLayer::CAsyncSslSocketLayer()
   m_Main = NULL;
   m_sessionid = NULL;
   m_sessionreuse = true;
+  m_sessionCachePort = 0;
 
   FCertificate = NULL;
   FPrivateKey = NULL;
@@ -768,7 +770,24 @@ int CAsyncSslSocketLayer::InitSSLConnection(bool clientMode,
   }
   else
   {
-    SSL_set_session(m_ssl, NULL);
+    SSL_SESSION * cachedsession = NULL;
+    if (clientMode && (m_Main == NULL) && m_sessionreuse && !m_sessionCacheHost.empty())
+    {
+      cachedsession = cached_ssl_session_get(m_sessionCacheHost.c_str(), m_sessionCachePort, m_ssl, FCertificate);
+    }
+    if ((cachedsession != NULL) && SSL_set_session(m_ssl, cachedsession))
+    {
+      LogSocketMessageRaw(FZ_LOG_INFO, L"Trying reuse TLS session ID of previous connection");
+    }
+    else
+    {
+      SSL_set_session(m_ssl, NULL);
+    }
+    if (cachedsession != NULL)
+    {
+      // SSL_set_session holds its own reference
+      SSL_SESSION_free(cachedsession);
+    }
   }
   if (clientMode)
   {
@@ -897,6 +916,21 @@ void CAsyncSslSocketLayer::ResetSslSession()
   m_sCriticalSection.Unlock();
 }
 
+void CAsyncSslSocketLayer::SetSessionCacheHost(const CString & host, int port)
+{
+  USES_CONVERSION;
+  m_sessionCacheHost = T2CA(host);
+  m_sessionCachePort = port;
+}
+
+void CAsyncSslSocketLayer::UncacheSession()
+{
+  if ((m_Main == NULL) && !m_sessionCacheHost.empty())
+  {
+    cached_ssl_session_remove(m_sessionCacheHost.c_str(), m_sessionCachePort);
+  }
+}
+
 bool CAsyncSslSocketLayer::IsUsingSSL()
 {
   return m_bUseSSL;
@@ -1141,6 +1175,7 @@ void CAsyncSslSocketLayer::apps_ssl_info_callback(const SSL *s, int where, int r
       if (!pLayer->m_bFailureSent)
       {
         pLayer->m_bFailureSent=TRUE;
+        pLayer->UncacheSession();
         pLayer->DoLayerCallback(LAYERCALLBACK_LAYERSPECIFIC, SSL_FAILURE, pLayer->m_bSslEstablished ? SSL_FAILURE_UNKNOWN : SSL_FAILURE_ESTABLISH);
       }
     }
@@ -1158,6 +1193,7 @@ void CAsyncSslSocketLayer::apps_ssl_info_callback(const SSL *s, int where, int r
         if (!pLayer->m_bFailureSent)
         {
           pLayer->m_bFailureSent=TRUE;
+          pLayer->UncacheSession();
           pLayer->DoLayerCallback(LAYERCALLBACK_LAYERSPECIFIC, SSL_FAILURE, pLayer->m_bSslEstablished ? SSL_FAILURE_UNKNOWN : SSL_FAILURE_ESTABLISH);
         }
       }
@@ -1593,10 +1629,16 @@ void CAsyncSslSocketLayer::SetNotifyReply(int nID, int nCode, int result)
       m_bFailureSent = TRUE;
       DoLayerCallback(LAYERCALLBACK_LAYERSPECIFIC, SSL_FAILURE, SSL_FAILURE_CERTREJECTED);
     }
+    UncacheSession();
     TriggerEvent(FD_CLOSE, 0, TRUE);
     return;
   }
   m_bSslEstablished = TRUE;
+  // Only sessions with a certificate accepted are offered to other connections
+  if ((m_Main == NULL) && m_sessionreuse && !m_sessionCacheHost.empty())
+  {
+    cached_ssl_session_put(m_sessionCacheHost.c_str(), m_sessionCachePort, m_ssl, FCertificate, SSL_get0_session(m_ssl));
+  }
   PrintSessionInfo();
   DoLayerCallback(LAYERCALLBACK_LAYERSPECIFIC, SSL_INFO, SSL_INFO_ESTABLISHED);
 
@@ -152,6 +152,10 @@ public:
     CAsyncSslSocketLayer * main,
     bool sessionreuse, int minTlsVersion, int maxTlsVersion,
     void * pContext = 0);
+  // The TLS session of a connection not reusing a session of another
+  // connection is shared with later connections to the same host,
+  // see TlsSessionCache.h
+  void SetSessionCacheHost(const CString & host, int port);
 
   // Send raw text, useful to send a confirmation after the ssl connection
   // has been initialized
@@ -177,6 +181,7 @@ private:
   int InitSSL();
   void UnloadSSL();
   void PrintLastErrorMsg();
+  void UncacheSession();
 
   void TriggerEvents();
 
@@ -219,6 +224,8 @@ private:
   SSL_SESSION * m_sessionid;
   bool m_sessionreuse;
   CAsyncSslSocketLayer * m_Main;
+  std::string m_sessionCacheHost;
+  int m_sessionCachePort;
 
   // Data channels for encrypted/unencrypted data
   BIO* m_nbio; // Network side, sends/receives encrypted data
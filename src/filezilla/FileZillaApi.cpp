@@ -308,6 +308,25 @@ int CFileZillaApi::CustomCommand(CString ACommand)
   return m_pMainThread->LastOperationSuccessful()?FZ_REPLY_OK:FZ_REPLY_ERROR;
 }
 
+int CFileZillaApi::PipelineCommands(CString ACommands)
+{
+  //Check if call allowed
+  if (!m_bInitialized)
+    return FZ_REPLY_NOTINITIALIZED;
+  if (IsConnected()==FZ_REPLY_NOTCONNECTED)
+    return FZ_REPLY_NOTCONNECTED;
+  if (IsBusy()==FZ_REPLY_BUSY)
+    return FZ_REPLY_BUSY;
+  if (ACommands==L"")
+    return FZ_REPLY_INVALIDPARAM;
+
+  t_command command;
+  command.id=FZ_COMMAND_PIPELINE;
+  command.param1=ACommands;
+  m_pMainThread->Command(command);
+  return m_pMainThread->LastOperationSuccessful()?FZ_REPLY_OK:FZ_REPLY_ERROR;
+}
+
 int CFileZillaApi::Delete(CString FileName, const CServerPath &path, bool filenameOnly)
 {
   //Check if call allowed
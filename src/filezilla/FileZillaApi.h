@@ -86,6 +86,8 @@ CUSTOM_MEM_ALLOCATION_IMPL
 #define FZ_COMMAND_MAKEDIR    0x0100
 #define FZ_COMMAND_CHMOD    0x0200
 #define FZ_COMMAND_LISTFILE    0x0400
+#define FZ_COMMAND_PIPELINE    0x0800
+// Sends new-line separated commands in t_command::param1 at once
 
 #define FZ_MSG_OFFSET 16
 #define FZ_MSG_OFFSETMASK 0xFFFF
@@ -249,6 +251,7 @@ public:
   void SetDebugLevel(int nDebugLevel);
 
   int CustomCommand(CString ACommand);
+  int PipelineCommands(CString ACommands);
   int Delete(CString FileName, const CServerPath & path, bool filenameOnly);
   int RemoveDir(CString DirName, const CServerPath & path = CServerPath());
   int Rename(CString oldName, CString newName, const CServerPath & path = CServerPath(), const CServerPath & newPath = CServerPath());
@@ -219,6 +219,12 @@ bool TFileZillaIntf::CustomCommand(const wchar_t * Command)
   return Check(FFileZillaApi->CustomCommand(Command), L"customcommand");
 }
 
+bool TFileZillaIntf::PipelineCommands(const wchar_t * Commands)
+{
+  DebugAssert(FFileZillaApi != NULL);
+  return Check(FFileZillaApi->PipelineCommands(Commands), L"pipelinecommands");
+}
+
 bool TFileZillaIntf::MakeDir(const wchar_t* APath)
 {
   DebugAssert(FFileZillaApi != NULL);
@@ -273,7 +279,7 @@ bool TFileZillaIntf::ListFile(const wchar_t * FileName, const wchar_t * APath)
 
 bool TFileZillaIntf::FileTransfer(const wchar_t * LocalFile,
   const wchar_t * RemoteFile, const wchar_t * RemotePath, bool Get, int64_t Size,
-  int Type, void * UserData)
+  int Type, void * UserData, int64_t PartOffset, int64_t PartSize)
 {
   t_transferfile Transfer;
 
@@ -286,6 +292,8 @@ bool TFileZillaIntf::FileTransfer(const wchar_t * LocalFile,
   // 1 = ascii, 2 = binary
   Transfer.nType = Type;
   Transfer.nUserData = UserData;
+  Transfer.partoffset = PartOffset;
+  Transfer.partsize = PartSize;
 
   return Check(FFileZillaApi->FileTransfer(Transfer), L"filetransfer");
 }
@@ -546,6 +554,32 @@ bool TFileZillaIntf::HandleMessage(WPARAM wParam, LPARAM lParam)
   return Result;
 }
 
+void TFileZillaIntf::DiscardMessage(WPARAM wParam, LPARAM lParam)
+{
+  // Releases a message superseded by a later one without handling it,
+  // only transfer status messages are ever discarded
+  DebugAssert(FZ_MSG_ID(wParam) == FZ_MSG_TRANSFERSTATUS);
+  delete reinterpret_cast<t_ffam_transferstatus *>(lParam);
+}
+
+bool TFileZillaIntf::IsSupersededMessage(WPARAM wParam, LPARAM lParam,
+  WPARAM NextWParam, LPARAM NextLParam) const
+{
+  // A transfer status carries absolute figures, so it is superseded
+  // by a following status of the same transfer
+  bool Result = false;
+  if ((FZ_MSG_ID(wParam) == FZ_MSG_TRANSFERSTATUS) && (lParam != 0) &&
+      (FZ_MSG_ID(NextWParam) == FZ_MSG_TRANSFERSTATUS) && (NextLParam != 0))
+  {
+    const t_ffam_transferstatus * Status = reinterpret_cast<const t_ffam_transferstatus *>(lParam);
+    const t_ffam_transferstatus * NextStatus = reinterpret_cast<const t_ffam_transferstatus *>(NextLParam);
+    Result =
+      (Status->transferid == NextStatus->transferid) &&
+      (Status->bFileTransfer == NextStatus->bFileTransfer);
+  }
+  return Result;
+}
+
 bool TFileZillaIntf::CheckError(intptr_t /*ReturnCode*/, const wchar_t * /*Context*/)
 {
   return false;
@@ -192,6 +192,7 @@ public:
   bool ListFile(const wchar_t * FileName, const wchar_t * APath);
 
   bool CustomCommand(const wchar_t * Command);
+  bool PipelineCommands(const wchar_t * Commands);
 
   bool MakeDir(const wchar_t* APath);
   bool Chmod(int Value, const wchar_t* FileName, const wchar_t* APath);
@@ -201,13 +202,16 @@ public:
     const wchar_t* APath, const wchar_t* ANewPath);
 
   bool FileTransfer(const wchar_t * LocalFile, const wchar_t * RemoteFile,
-    const wchar_t * RemotePath, bool Get, int64_t Size, int Type, void * UserData);
+    const wchar_t * RemotePath, bool Get, int64_t Size, int Type, void * UserData,
+    int64_t PartOffset = 0, int64_t PartSize = -1);
 
   virtual const wchar_t * Option(intptr_t OptionID) const = 0;
   virtual intptr_t OptionVal(intptr_t OptionID) const = 0;
 
   void SetDebugLevel(TLogLevel Level);
   bool HandleMessage(WPARAM wParam, LPARAM lParam);
+  void DiscardMessage(WPARAM wParam, LPARAM lParam);
+  bool IsSupersededMessage(WPARAM wParam, LPARAM lParam, WPARAM NextWParam, LPARAM NextLParam) const;
 
 protected:
   bool FZPostMessage(WPARAM wParam, LPARAM lParam);
@@ -32,7 +32,7 @@
 #define OPTION_SPEEDLIMIT_DOWNLOAD_VALUE 88
 #define OPTION_SPEEDLIMIT_UPLOAD_VALUE 89
 #define OPTION_TRANSFERIP 100
-#ifdef MPEXT_NO_ZLIB
+#ifndef MPEXT_NO_ZLIB
 #define OPTION_MODEZ_USE 110
 #define OPTION_MODEZ_LEVEL 111
 #endif
@@ -52,5 +52,7 @@
 #define OPTION_MPEXT_HOST 1009
 #define OPTION_MPEXT_NODELAY 1010
 #define OPTION_MPEXT_NOLIST 1011
+#define OPTION_MPEXT_TRANSFERBUFFERSIZE 1012
+#define OPTION_MPEXT_PREFETCHPASV 1013
 
 #endif // FileZillaOptH
@@ -14,6 +14,7 @@
 #include <TextsFileZilla.h>
 #include <FileZillaOpt.h>
 #include <nbutils.h>
+#include <BandwidthLimiter.h>
 
 class CFtpControlSocket::CFileTransferData : public CFtpControlSocket::t_operation::COpData
 {
@@ -31,6 +32,7 @@ public:
     bUseAbsolutePaths = FALSE;
     bTriedPortPasvOnce = FALSE;
     askOnResumeFail = false;
+    partComplete = false;
 #ifndef MPEXT_NO_ZLIB
     newZlibLevel = 0;
 #endif
@@ -64,6 +66,8 @@ public:
   int newZlibLevel;
 #endif
   bool askOnResumeFail;
+  // All data of the segment were received and the data connection was closed
+  bool partComplete;
 };
 
 class CFtpControlSocket::CLogonData:public CFtpControlSocket::t_operation::COpData
@@ -153,12 +157,7 @@ public:
 /////////////////////////////////////////////////////////////////////////////
 // CFtpControlSocket
 
-rde::list<CFtpControlSocket::t_ActiveList> CFtpControlSocket::m_InstanceList[2];
-
-CTime CFtpControlSocket::m_CurrentTransferTime[2] = { CTime::GetCurrentTime(), CTime::GetCurrentTime() };
-_int64 CFtpControlSocket::m_CurrentTransferLimit[2] = {0, 0};
-
-CCriticalSection CFtpControlSocket::m_SpeedLimitSync;
+TBandwidthLimiter CFtpControlSocket::m_SpeedLimiter[2];
 
 #define BUFSIZE 16384
 
@@ -182,6 +181,8 @@ CFtpControlSocket::CFtpControlSocket(CMainThread *pMainThread, CFileZillaTools *
 
   m_pTransferSocket=0;
   m_pDataFile=0;
+  m_pSpeedReservation[download] = NULL;
+  m_pSpeedReservation[upload] = NULL;
   srand( (unsigned)time( NULL ) );
   m_bKeepAliveActive=FALSE;
   m_bCheckForTimeout=TRUE;
@@ -203,7 +204,11 @@ CFtpControlSocket::CFtpControlSocket(CMainThread *pMainThread, CFileZillaTools *
   m_ListFileSize = 0;
   m_isFileZilla = false;
   m_awaitsReply = false;
-  m_skipReply = false;
+  m_skipReplies = 0;
+  m_pipeliningConfirmed = false;
+  m_nPasvPrefetch = PASVPREFETCH_NONE;
+  m_pasvPrefetchTick = 0;
+  m_transferType = 0;
 
   m_sendBuffer = 0;
   m_sendBufferLen = 0;
@@ -535,6 +540,7 @@ void CFtpControlSocket::Connect(t_server &server)
       DoClose(FZ_REPLY_CRITICALERROR);
       return;
     }
+    m_pSslLayer->SetSessionCacheHost(m_CurrentServer.host, m_CurrentServer.port);
     int res = m_pSslLayer->InitSSLConnection(true, NULL,
       GetOptionVal(OPTION_MPEXT_SSLSESSIONREUSE) != FALSE,
       GetOptionVal(OPTION_MPEXT_MIN_TLS_VERSION),
@@ -661,6 +667,7 @@ void CFtpControlSocket::LogOnToServer(BOOL bSkipReply /*=FALSE*/)
         DoClose(FZ_REPLY_CRITICALERROR);
         return;
       }
+      m_pSslLayer->SetSessionCacheHost(m_CurrentServer.host, m_CurrentServer.port);
       int res = m_pSslLayer->InitSSLConnection(true, NULL,
         GetOptionVal(OPTION_MPEXT_SSLSESSIONREUSE) != FALSE,
         GetOptionVal(OPTION_MPEXT_MIN_TLS_VERSION),
@@ -1376,7 +1383,9 @@ void CFtpControlSocket::ProcessReply()
   if (m_RecvBuffer.empty())
     return;
 
-  if (m_awaitsReply)
+  // While the PASV/EPSV sent ahead is queued behind the transfer command,
+  // its reply is still outstanding after this one (see PrefetchPasv)
+  if (m_awaitsReply && (m_nPasvPrefetch != PASVPREFETCH_QUEUED))
   {
     if (m_sendBuffer)
       TriggerEvent(FD_WRITE);
@@ -1387,11 +1396,40 @@ void CFtpControlSocket::ProcessReply()
   if ( reply == L"" )
     return;
 
-  // After Cancel, we might have to skip a reply
-  if (m_skipReply)
+  int code = GetReplyCode();
+  if ((m_nPasvPrefetch == PASVPREFETCH_SENT) || (m_nPasvPrefetch == PASVPREFETCH_AWAITED) ||
+      (m_nPasvPrefetch == PASVPREFETCH_DISCARD))
   {
-    m_skipReply = false;
+    // Reply to PASV/EPSV sent ahead, see PrefetchPasv
+    if (m_nPasvPrefetch == PASVPREFETCH_DISCARD)
+      m_nPasvPrefetch = PASVPREFETCH_NONE;
+    else if ((m_nPasvPrefetch == PASVPREFETCH_AWAITED) && (m_Operation.nOpMode&CSMODE_TRANSFER))
+    {
+      m_nPasvPrefetch = PASVPREFETCH_NONE;
+      FileTransfer(0);
+    }
+    else if (code == 2)
+    {
+      m_pasvPrefetchReply = m_RecvBuffer.front();
+      m_pasvPrefetchTick = GetTickCount();
+      m_nPasvPrefetch = PASVPREFETCH_RECEIVED;
+    }
+    else
+      m_nPasvPrefetch = PASVPREFETCH_NONE;
+    if (!m_RecvBuffer.empty())
+      m_RecvBuffer.pop_front();
+    return;
+  }
+  // The final reply to the transfer command the PASV/EPSV was sent after
+  bool prefetchQueued = (m_nPasvPrefetch == PASVPREFETCH_QUEUED) && (code >= 2);
+
+  // After Cancel, we might have to skip a reply (or more with pipelining)
+  if (m_skipReplies > 0)
+  {
+    m_skipReplies--;
     m_RecvBuffer.pop_front();
+    if (prefetchQueued && (m_nPasvPrefetch == PASVPREFETCH_QUEUED))
+      m_nPasvPrefetch = PASVPREFETCH_SENT;
     return;
   }
 
@@ -1402,6 +1440,8 @@ void CFtpControlSocket::ProcessReply()
   }
   else if (m_Operation.nOpMode&CSMODE_CONNECT)
     LogOnToServer();
+  else if ((m_Operation.nOpMode == CSMODE_COMMAND) && m_Operation.pData)
+    PipelineCommands(NULL);
   else if (m_Operation.nOpMode& (CSMODE_COMMAND|CSMODE_CHMOD) )
   {
     if (GetReplyCode()== 2 || GetReplyCode()== 3)
@@ -1426,6 +1466,9 @@ void CFtpControlSocket::ProcessReply()
   else if (m_Operation.nOpMode&CSMODE_RENAME)
     Rename(L"", L"", CServerPath(), CServerPath());
 
+  if (prefetchQueued && (m_nPasvPrefetch == PASVPREFETCH_QUEUED))
+    m_nPasvPrefetch = PASVPREFETCH_SENT;
+
   if (!m_RecvBuffer.empty())
     m_RecvBuffer.pop_front();
 }
@@ -1480,6 +1523,23 @@ BOOL CFtpControlSocket::Send(CString str)
 {
   USES_CONVERSION;
 
+  if (m_nPasvPrefetch != PASVPREFETCH_NONE)
+  {
+    // Any other data connection setup makes the prefetched one obsolete
+    CString cmd = str.Left(4);
+    if (!cmd.CompareNoCase(L"PASV") || !cmd.CompareNoCase(L"EPSV") ||
+        !cmd.CompareNoCase(L"PORT") || !cmd.CompareNoCase(L"EPRT"))
+    {
+      if (m_nPasvPrefetch == PASVPREFETCH_RECEIVED)
+        m_nPasvPrefetch = PASVPREFETCH_NONE;
+      else if ((m_nPasvPrefetch == PASVPREFETCH_SENT) || (m_nPasvPrefetch == PASVPREFETCH_AWAITED))
+        m_nPasvPrefetch = PASVPREFETCH_DISCARD;
+    }
+  }
+  // Known again only once FileTransfer gets a positive reply
+  if (!str.Left(5).CompareNoCase(L"TYPE "))
+    m_transferType = 0;
+
   ShowStatus(str, FZ_LOG_COMMAND);
   str += L"\r\n";
   int res = 0;
@@ -1497,7 +1557,7 @@ BOOL CFtpControlSocket::Send(CString str)
     WideCharToMultiByte(CP_UTF8, 0, unicode, -1, utf8, len + 1, 0, 0);
 
     size_t sendLen = strlen(utf8);
-    if (!m_awaitsReply && !m_sendBuffer)
+    if ((!m_awaitsReply || IsPipelining()) && !m_sendBuffer)
       res = CAsyncSocketEx::Send(utf8, (int)strlen(utf8));
     else
       res = -2;
@@ -1544,7 +1604,7 @@ BOOL CFtpControlSocket::Send(CString str)
     WideCharToMultiByte(m_nCodePage, 0, unicode, -1, utf8, len + 1, 0, 0);
 
     size_t sendLen = strlen(utf8);
-    if (!m_awaitsReply && !m_sendBuffer)
+    if ((!m_awaitsReply || IsPipelining()) && !m_sendBuffer)
       res = CAsyncSocketEx::Send(utf8, (int)strlen(utf8));
     else
       res = -2;
@@ -1582,7 +1642,7 @@ BOOL CFtpControlSocket::Send(CString str)
     LPCSTR lpszAsciiSend = T2CA(str);
 
     size_t sendLen = strlen(lpszAsciiSend);
-    if (!m_awaitsReply && !m_sendBuffer)
+    if ((!m_awaitsReply || IsPipelining()) && !m_sendBuffer)
       res = CAsyncSocketEx::Send(lpszAsciiSend, (int)strlen(lpszAsciiSend), 0, m_CurrentServer.iDupFF);
     else
       res = -2;
@@ -1599,7 +1659,7 @@ BOOL CFtpControlSocket::Send(CString str)
       if (!m_sendBuffer)
       {
         m_sendBuffer = nb::chcalloc(sendLen - res);
-        memcpy(m_sendBuffer, lpszAsciiSend, sendLen - res);
+        memcpy(m_sendBuffer, lpszAsciiSend + res, sendLen - res);
         m_sendBufferLen = sendLen - res;
       }
       else
@@ -1662,7 +1722,11 @@ void CFtpControlSocket::DoClose(int nError /*=0*/)
   m_ListFile = "";
 
   m_awaitsReply = false;
-  m_skipReply = false;
+  m_skipReplies = 0;
+  m_pipeliningConfirmed = false;
+  m_nPasvPrefetch = PASVPREFETCH_NONE;
+  m_pasvPrefetchReply = "";
+  m_transferType = 0;
 
   nb_free(m_sendBuffer);
   m_sendBuffer = 0;
@@ -1703,6 +1767,14 @@ void CFtpControlSocket::CheckForTimeout()
     ShowTimeoutError(IDS_CONTROL_CONNECTION);
     DoClose();
   }
+  else if (IsPipelineProbeStalled())
+  {
+    // The server answered the first pipelined command only, it most likely
+    // discarded the others, do not wait the full timeout for them
+    LogMessage(FZ_LOG_WARNING, L"No reply to pipelined commands, giving up waiting");
+    ShowTimeoutError(IDS_CONTROL_CONNECTION);
+    DoClose();
+  }
 }
 
 void CFtpControlSocket::FtpCommand(LPCTSTR pCommand)
@@ -1711,6 +1783,100 @@ void CFtpControlSocket::FtpCommand(LPCTSTR pCommand)
   Send(pCommand);
 }
 
+class CFtpControlSocket::CPipelineData : public CFtpControlSocket::t_operation::COpData
+{
+public:
+  CPipelineData() : nCommands(0), nReplies(0) {}
+  virtual ~CPipelineData() {}
+  int nCommands;
+  int nReplies;
+};
+
+void CFtpControlSocket::PipelineCommands(LPCTSTR pCommands)
+{
+  // Commands separated by new-lines are sent at once, without waiting
+  // for replies of the previous ones. The replies are matched in order,
+  // the operation completes once all of them arrive.
+  // Codes of the individual replies are up to the caller to collect from the log.
+  if (pCommands)
+  {
+    DebugAssert(m_Operation.nOpMode==CSMODE_NONE);
+    DebugAssert(!m_Operation.pData);
+    m_Operation.nOpMode=CSMODE_COMMAND;
+    CPipelineData *pData=new CPipelineData;
+    m_Operation.pData=pData;
+
+    CString commands=pCommands;
+    int pos=0;
+    CString command=commands.Tokenize(L"\n", pos);
+    while (pos>=0)
+    {
+      if (!Send(command))
+        return;
+      pData->nCommands++;
+      command=commands.Tokenize(L"\n", pos);
+    }
+    if (!pData->nCommands)
+      ResetOperation(FZ_REPLY_OK);
+  }
+  else
+  {
+    CPipelineData *pData=static_cast<CPipelineData *>(m_Operation.pData);
+    // 1yz preliminary replies are followed by the final one,
+    // only the final replies are counted (and collected by the caller)
+    if (GetReplyCode() >= 2)
+      pData->nReplies++;
+    if (pData->nReplies>=pData->nCommands)
+    {
+      m_pipeliningConfirmed = true;
+      ResetOperation(FZ_REPLY_OK);
+    }
+    else
+      // there are still replies outstanding
+      m_awaitsReply = true;
+  }
+}
+
+bool CFtpControlSocket::IsPipelining() const
+{
+  return (m_Operation.nOpMode==CSMODE_COMMAND) && (m_Operation.pData!=NULL);
+}
+
+// How long to wait for the further replies to the first batch of pipelined
+// commands on a connection, once the first reply arrived (s)
+#define PIPELINE_PROBE_TIMEOUT 5
+
+bool CFtpControlSocket::IsPipelineProbeStalled() const
+{
+  bool result = false;
+  if (IsPipelining() && !m_pipeliningConfirmed)
+  {
+    const CPipelineData *pData=static_cast<const CPipelineData *>(m_Operation.pData);
+    CTimeSpan span=CTime::GetCurrentTime()-m_LastRecvTime;
+    result = (pData->nReplies > 0) && (span.GetTotalSeconds() >= PIPELINE_PROBE_TIMEOUT);
+  }
+  return result;
+}
+
+// How long is the prefetched passive mode reply considered usable (ms)
+#define PASVPREFETCH_MAXAGE 10000
+
+void CFtpControlSocket::PrefetchPasv(bool transferReplyPending)
+{
+  // Sent as soon as the data connection of the current transfer is done,
+  // without waiting for the transfer reply, so that the next transfer
+  // finds the passive mode reply already received.
+  // The server processes the commands in order.
+  if (m_nPasvPrefetch != PASVPREFETCH_NONE)
+    return;
+  bool awaitsReply = m_awaitsReply;
+  m_awaitsReply = false;
+  if (!Send((GetFamily() == AF_INET) ? L"PASV" : L"EPSV"))
+    return;
+  m_awaitsReply = m_awaitsReply || awaitsReply;
+  m_nPasvPrefetch = transferReplyPending ? PASVPREFETCH_QUEUED : PASVPREFETCH_SENT;
+}
+
 bool CFtpControlSocket::UsingMlsd()
 {
   return
@@ -2900,6 +3066,10 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
         return;
       }
       pData->nGotTransferEndReply |= 2;
+      if (m_pTransferSocket->m_transferdata.bPart && (m_pTransferSocket->m_transferdata.transferleft <= 0))
+        pData->partComplete = true;
+      if (pData->bPasv && GetOptionVal(OPTION_MPEXT_PREFETCHPASV))
+        PrefetchPasv(!(pData->nGotTransferEndReply & 1));
       if (m_Operation.nOpState!=FILETRANSFER_WAITFINISH)
         return;
       else
@@ -2951,6 +3121,13 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
     pData->transferdata.bResume = FALSE;
     pData->transferdata.bResumeAppend = FALSE;
     pData->transferdata.bType = (pData->transferfile.nType == 1) ? TRUE : FALSE;
+    if (pData->transferfile.get && (pData->transferfile.partsize >= 0))
+    {
+      // Other segments of the file are downloaded by other connections
+      pData->transferdata.transfersize = pData->transferfile.partsize;
+      pData->transferdata.transferleft = pData->transferfile.partsize;
+      pData->transferdata.bPart = TRUE;
+    }
 
     CServerPath path;
     DebugCheck(m_pOwner->GetCurrentPath(path));
@@ -3500,6 +3677,8 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
     case FILETRANSFER_TYPE:
       if (code!=2 && code!=3)
         nReplyError = FZ_REPLY_ERROR;
+      else
+        m_transferType = (pData->transferfile.nType==1) ? L'A' : L'I';
       m_Operation.nOpState = NeedModeCommand() ? FILETRANSFER_MODE : (NeedOptsCommand() ? FILETRANSFER_OPTS : FILETRANSFER_PORTPASV);
       break;
     case FILETRANSFER_WAIT:
@@ -3653,7 +3832,7 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
           DebugCheck(m_pTransferSocket->AsyncSelect() != FALSE);
         }
 
-        if (pData->transferdata.bResume)
+        if (pData->transferdata.bResume || (pData->transferdata.bPart && (pData->transferfile.partoffset > 0)))
           m_Operation.nOpState = FILETRANSFER_REST;
         else
           m_Operation.nOpState = FILETRANSFER_RETRSTOR;
@@ -3672,7 +3851,11 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
         }
         if (pData->transferfile.get)
         {
-          if (pData->transferdata.bResume && pData->transferdata.localFileHandle==INVALID_HANDLE_VALUE)
+          if (pData->transferdata.bPart)
+            // The file was created in its full size by the caller,
+            // segments are written in place, concurrently with each other
+            res = m_pDataFile->Open(pData->transferfile.localfile,CFile::modeCreate|CFile::modeWrite|CFile::modeNoTruncate|CFile::shareDenyNone);
+          else if (pData->transferdata.bResume && pData->transferdata.localFileHandle==INVALID_HANDLE_VALUE)
             res = m_pDataFile->Open(pData->transferfile.localfile,CFile::modeCreate|CFile::modeWrite|CFile::modeNoTruncate|CFile::shareDenyWrite);
           else if (pData->transferdata.localFileHandle==INVALID_HANDLE_VALUE)
             res = m_pDataFile->Open(pData->transferfile.localfile,CFile::modeWrite|CFile::modeCreate|CFile::shareDenyWrite);
@@ -3752,6 +3935,8 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
           }
           else if (pData->pFileSize)
             pData->transferdata.transfersize=*pData->pFileSize;
+          if (pData->transferdata.bPart)
+            pData->transferdata.transfersize=pData->transferfile.partsize;
           pData->transferdata.transferleft=pData->transferdata.transfersize;
         }
       }
@@ -3769,7 +3954,19 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
         if (code==3 || code==2)
         {
           LONG high = 0;
-          if (pData->transferfile.get)
+          if (pData->transferdata.bPart)
+          {
+            LONG low = static_cast<LONG>(pData->transferfile.partoffset&0xFFFFFFFF);
+            high = static_cast<LONG>(pData->transferfile.partoffset>>32);
+            if (SetFilePointer((HANDLE)m_pDataFile->m_hFile, low, &high, FILE_BEGIN)==0xFFFFFFFF && GetLastError()!=NO_ERROR)
+            {
+              ShowStatus(IDS_ERRORMSG_SETFILEPOINTER, FZ_LOG_ERROR);
+              nReplyError = FZ_REPLY_ERROR;
+            }
+            else
+              m_Operation.nOpState = FILETRANSFER_RETRSTOR;
+          }
+          else if (pData->transferfile.get)
           {
             pData->transferdata.transferleft = pData->transferdata.transfersize - GetLength64(*m_pDataFile);
             if (SetFilePointer((HANDLE)m_pDataFile->m_hFile, 0, &high, FILE_END)==0xFFFFFFFF && GetLastError()!=NO_ERROR)
@@ -3787,7 +3984,8 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
         }
         else
         {
-          if (code==5 && GetReply()[1]==L'0')
+          // Segment cannot be downloaded without resume support
+          if (code==5 && GetReply()[1]==L'0' && !pData->transferdata.bPart)
           {
             if (pData->transferfile.get)
             {
@@ -3920,13 +4118,32 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
           break;
         }
         else if (code!=2 && code!=3)
-          nReplyError = FZ_REPLY_ERROR;
+        {
+          // Servers typically reply 426 or 451 to RETR, when we close
+          // the data connection at the end of the segment
+          if (pData->partComplete ||
+              (m_pTransferSocket && m_pTransferSocket->m_transferdata.bPart && (m_pTransferSocket->m_transferdata.transferleft <= 0)))
+          {
+            LogMessage(FZ_LOG_INFO, L"Segment complete, ignoring error reply to aborted transfer");
+            pData->nGotTransferEndReply |= 1;
+          }
+          else
+            nReplyError = FZ_REPLY_ERROR;
+        }
         else
         {
           pData->nGotTransferEndReply |= 1;
         }
       }
-      if (pData->nGotTransferEndReply==3)
+      if ((pData->nGotTransferEndReply==3) && pData->transferdata.bPart && !pData->partComplete)
+      {
+        // The server ended the transfer or closed the data connection
+        // before the whole segment was received, the pre-allocated
+        // file would be left with a gap
+        LogMessage(FZ_LOG_WARNING, L"Segment ended before all its data were received");
+        nReplyError = FZ_REPLY_ERROR;
+      }
+      else if (pData->nGotTransferEndReply==3)
       {
           // Not really sure about a reason for the m_pDataFile condition here
           TransferFinished(m_pDataFile != NULL);
@@ -3947,6 +4164,16 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
   /////////////////
   //Send commands//
   /////////////////
+  if ((m_Operation.nOpState == FILETRANSFER_TYPE) &&
+      GetOptionVal(OPTION_MPEXT_PREFETCHPASV) &&
+      (m_transferType == ((pData->transferfile.nType==1) ? L'A' : L'I')))
+  {
+    // Already in effect since the previous transfer,
+    // done only along with the passive mode prefetch, so that
+    // the command sequence is unchanged when the option is off
+    m_Operation.nOpState = NeedModeCommand() ? FILETRANSFER_MODE : (NeedOptsCommand() ? FILETRANSFER_OPTS : FILETRANSFER_PORTPASV);
+  }
+
   BOOL bError=FALSE;
   switch(m_Operation.nOpState)
   {
@@ -4246,6 +4473,27 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
   case FILETRANSFER_PORTPASV:
     if (pData->bPasv)
     {
+      if ((m_nPasvPrefetch == PASVPREFETCH_SENT) || (m_nPasvPrefetch == PASVPREFETCH_AWAITED))
+      {
+        // Wait for the reply to PASV/EPSV sent during the previous transfer,
+        // ProcessReply passes it here
+        m_nPasvPrefetch = PASVPREFETCH_AWAITED;
+        break;
+      }
+      else if (m_nPasvPrefetch == PASVPREFETCH_RECEIVED)
+      {
+        m_nPasvPrefetch = PASVPREFETCH_NONE;
+        // Servers close unused passive ports after a while
+        if (GetTickCount() - m_pasvPrefetchTick < PASVPREFETCH_MAXAGE)
+        {
+          LogMessage(FZ_LOG_INFO, L"Using passive mode reply received during the previous transfer");
+          m_RecvBuffer.push_front(m_pasvPrefetchReply);
+          FileTransfer(0);
+          if (!m_RecvBuffer.empty())
+            m_RecvBuffer.pop_front();
+          return;
+        }
+      }
       if (!Send((GetFamily() == AF_INET) ? L"PASV" : L"EPSV"))
         bError=TRUE;
     }
@@ -4402,6 +4650,8 @@ void CFtpControlSocket::FileTransfer(t_transferfile *transferfile/*=0*/,BOOL bFi
     {
       CString command;
       int64_t transferoffset =
+        pData->transferdata.bPart ?
+          pData->transferfile.partoffset :
         pData->transferfile.get ?
           GetLength64(*m_pDataFile) :
           pData->transferdata.transfersize-pData->transferdata.transferleft;
@@ -4594,23 +4844,32 @@ void CFtpControlSocket::Cancel(BOOL bQuit/*=FALSE*/)
   else if (nOpMode & CSMODE_LIST)
   {
     if (m_Operation.nOpState == LIST_WAITFINISH)
-      m_skipReply = true;
+      m_skipReplies = 1;
     ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_CANCEL);
   }
   else if (nOpMode & CSMODE_TRANSFER)
   {
     if (m_Operation.nOpState == FILETRANSFER_WAITFINISH || m_Operation.nOpState == FILETRANSFER_LIST_WAITFINISH)
-      m_skipReply = true;
+      m_skipReplies = 1;
     ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_CANCEL | FZ_REPLY_ABORTED);
   }
+  else if (IsPipelining())
+  {
+    CPipelineData *pData=static_cast<CPipelineData *>(m_Operation.pData);
+    m_skipReplies = pData->nCommands - pData->nReplies;
+    ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_CANCEL);
+  }
   else if (nOpMode != CSMODE_NONE)
     ResetOperation(FZ_REPLY_ERROR | FZ_REPLY_CANCEL);
 
   if (nOpMode != CSMODE_NONE && !bQuit)
     ShowStatus(IDS_ERRORMSG_INTERRUPTED, FZ_LOG_ERROR);
 
-  if (m_awaitsReply)
-    m_skipReply = true;
+  // The reply to PASV/EPSV sent ahead is recognized by ProcessReply on its own
+  if (m_awaitsReply && !m_skipReplies &&
+      (m_nPasvPrefetch != PASVPREFETCH_SENT) && (m_nPasvPrefetch != PASVPREFETCH_AWAITED) &&
+      (m_nPasvPrefetch != PASVPREFETCH_DISCARD))
+    m_skipReplies = 1;
 }
 
 void CFtpControlSocket::TransfersocketListenFinished(unsigned int ip, unsigned short port)
@@ -4672,6 +4931,10 @@ void CFtpControlSocket::ResetOperation(int nSuccessful /*=FALSE*/)
   if (nSuccessful & FZ_REPLY_CRITICALERROR)
     nSuccessful |= FZ_REPLY_ERROR;
 
+  // Nobody waits for the prefetched passive mode reply anymore
+  if (m_nPasvPrefetch == PASVPREFETCH_AWAITED)
+    m_nPasvPrefetch = PASVPREFETCH_SENT;
+
   if (m_pTransferSocket)
     delete m_pTransferSocket;
   m_pTransferSocket=0;
@@ -5047,6 +5310,13 @@ int CFtpControlSocket::CheckOverwriteFile()
 
   CFileTransferData *pData = reinterpret_cast<CFileTransferData *>(m_Operation.pData);
 
+  if (pData->transferdata.bPart)
+  {
+    // The file was created for all segments by the caller
+    m_Operation.nOpState = FILETRANSFER_TYPE;
+    return 0;
+  }
+
   int nReplyError = 0;
   CFileStatus64 status;
   BOOL res = FALSE;
@@ -5952,178 +6222,80 @@ int CFtpControlSocket::OnLayerCallback(rde::list<t_callbackMsg>& callbacks)
   return 0;
 }
 
-_int64 CFtpControlSocket::GetSpeedLimit(CTime &time, int valType, int valValue)
+_int64 CFtpControlSocket::GetSpeedLimit(int valType, int valValue)
 {
   int type = GetOptionVal(valType);
 
   if ( type == 1)
     return ( _int64)GetOptionVal(valValue) * 1024;
 
-  return ( _int64)1000000000000;  // I hope that when there will be something with 1000GB/s then I'll change it :)
+  return 0;
 }
 
-_int64 CFtpControlSocket::GetSpeedLimit(enum transferDirection direction, CTime &time)
+_int64 CFtpControlSocket::GetSpeedLimit(enum transferDirection direction)
 {
   if (direction == download)
-    return GetSpeedLimit(time, OPTION_SPEEDLIMIT_DOWNLOAD_TYPE, OPTION_SPEEDLIMIT_DOWNLOAD_VALUE);
+    return GetSpeedLimit(OPTION_SPEEDLIMIT_DOWNLOAD_TYPE, OPTION_SPEEDLIMIT_DOWNLOAD_VALUE);
   else
-    return GetSpeedLimit(time, OPTION_SPEEDLIMIT_UPLOAD_TYPE, OPTION_SPEEDLIMIT_UPLOAD_VALUE);
-  return ( _int64)1000000000000;
+    return GetSpeedLimit(OPTION_SPEEDLIMIT_UPLOAD_TYPE, OPTION_SPEEDLIMIT_UPLOAD_VALUE);
 }
 
-_int64 CFtpControlSocket::GetAbleToUDSize( bool & beenWaiting, CTime & curTime, _int64 & curLimit, rde::list<CFtpControlSocket::t_ActiveList>::iterator & iter, enum transferDirection direction, int nBufSize)
+_int64 CFtpControlSocket::GetAbleToTransferSize(enum transferDirection direction, bool &beenWaiting, int nBufSize)
 {
   beenWaiting = false;
 
-  CTime nowTime = CTime::GetCurrentTime();
-  _int64 ableToRead = BUFSIZE;
-
-  if ( nowTime == curTime)
-  {
-    ableToRead = iter->nBytesAvailable;
+  if (!nBufSize)
+    nBufSize = BUFSIZE;
 
-    if (ableToRead <= 0)
-    {
-      //  we should wait till next second
-      nowTime = CTime::GetCurrentTime();
+  m_SpeedLimiter[direction].SetRate(static_cast<intptr_t>(GetSpeedLimit(direction)));
+  if (!m_pSpeedReservation[direction])
+    m_pSpeedReservation[direction] = new TBandwidthReservation(&m_SpeedLimiter[direction]);
 
-      while (nowTime == curTime && !iter->nBytesAvailable)
-      {
-        if (beenWaiting)
-        {
-          //Check if there are other commands in the command queue.
-          MSG msg;
-          if (PeekMessage(&msg, 0, m_pOwner->m_nInternalMessageID, m_pOwner->m_nInternalMessageID, PM_NOREMOVE))
-          {
-            LogMessage(FZ_LOG_INFO, L"Message waiting in queue, resuming later");
-            return 0;
-          }
-        }
-        m_SpeedLimitSync.Unlock();
-        Sleep(100);
-        m_SpeedLimitSync.Lock();
-        nowTime = CTime::GetCurrentTime();
-        beenWaiting = true;
-
-        // Since we didn't hold the critical section for some time, we have to renew the iterator
-        for (iter = m_InstanceList[direction].begin(); iter != m_InstanceList[direction].end(); iter++)
-          if (iter->pOwner == this)
-            break;
-        if (iter == m_InstanceList[direction].end())
-          return 0;
-      }
-    }
-    ableToRead = iter->nBytesAvailable;
-  }
-
-  if (nowTime != curTime)
+  // The bucket is refilled continuously, so we need to wait only
+  // until our share of the limit is available, not until the next second
+  _int64 ableToTransfer;
+  while (!(ableToTransfer = m_pSpeedReservation[direction]->Available(nBufSize)))
   {
-    if (ableToRead > 0)
-      ableToRead = 0;
-
-    curLimit = GetSpeedLimit(direction, curTime);
-    size_t sz = m_InstanceList[direction].size();
-    int64_t nMax = curLimit / (sz ? sz : 1);
-    _int64 nLeft = 0;
-    int nCount = 0;
-    rde::list<t_ActiveList>::iterator iter2;
-    for (iter2 = m_InstanceList[direction].begin(); iter2 != m_InstanceList[direction].end(); iter2++)
-    {
-      if (iter2->nBytesAvailable>0)
-      {
-        nLeft += iter2->nBytesAvailable;
-        iter2->nBytesTransferred = 1;
-      }
-      else
-      {
-        nCount++;
-        iter2->nBytesTransferred = 0;
-      }
-      iter2->nBytesAvailable = nMax;
-    }
-    if (nLeft && nCount)
+    if (beenWaiting)
     {
-      nMax = nLeft / nCount;
-      for (iter2 = m_InstanceList[direction].begin(); iter2 != m_InstanceList[direction].end(); iter2++)
+      //Check if there are other commands in the command queue.
+      MSG msg;
+      if (PeekMessage(&msg, 0, m_pOwner->m_nInternalMessageID, m_pOwner->m_nInternalMessageID, PM_NOREMOVE))
       {
-        if (!iter2->nBytesTransferred)
-          iter2->nBytesAvailable += nMax;
-        else
-          iter2->nBytesTransferred = 0;
+        LogMessage(FZ_LOG_INFO, L"Message waiting in queue, resuming later");
+        return 0;
       }
     }
-    ableToRead = iter->nBytesAvailable;
+    Sleep(m_pSpeedReservation[direction]->GetDelay(nBufSize));
+    beenWaiting = true;
   }
 
-  curTime = nowTime;
-
-  if (!nBufSize)
-    nBufSize = BUFSIZE;
-  if (ableToRead > nBufSize)
-    ableToRead = nBufSize;
-
-  return ableToRead;
-}
-
-_int64 CFtpControlSocket::GetAbleToTransferSize(enum transferDirection direction, bool &beenWaiting, int nBufSize)
-{
-  m_SpeedLimitSync.Lock();
-  rde::list<t_ActiveList>::iterator iter;
-  for (iter = m_InstanceList[direction].begin(); iter != m_InstanceList[direction].end(); iter++)
-    if (iter->pOwner == this)
-      break;
-  if (iter == m_InstanceList[direction].end())
-  {
-    t_ActiveList item;
-    CTime time = CTime::GetCurrentTime();
-    item.nBytesAvailable = GetSpeedLimit(direction, time) / (m_InstanceList[direction].size() + 1);
-    item.nBytesTransferred = 0;
-    item.pOwner = this;
-    m_InstanceList[direction].push_back(item);
-    iter = m_InstanceList[direction].end();
-    iter--;
-  }
-  _int64 limit = GetAbleToUDSize(beenWaiting, m_CurrentTransferTime[direction], m_CurrentTransferLimit[direction], iter, direction, nBufSize);
-  m_SpeedLimitSync.Unlock();
-  return limit;
+  return ableToTransfer;
 }
 
 BOOL CFtpControlSocket::RemoveActiveTransfer()
 {
   BOOL bFound = FALSE;
-  m_SpeedLimitSync.Lock();
-  rde::list<t_ActiveList>::iterator iter;
   for (int i = 0; i < 2; i++)
   {
-    for (iter = m_InstanceList[i].begin(); iter != m_InstanceList[i].end(); iter++)
-      if (iter->pOwner == this)
-      {
-        m_InstanceList[i].erase(iter);
-        bFound = TRUE;
-        break;
-      }
+    if (m_pSpeedReservation[i])
+    {
+      // Returns unused reservation to the other transfers
+      delete m_pSpeedReservation[i];
+      m_pSpeedReservation[i] = NULL;
+      bFound = TRUE;
+    }
   }
-  m_SpeedLimitSync.Unlock();
   return bFound;
 }
 
 BOOL CFtpControlSocket::SpeedLimitAddTransferredBytes(enum transferDirection direction, _int64 nBytesTransferred)
 {
-  m_SpeedLimitSync.Lock();
-  rde::list<t_ActiveList>::iterator iter;
-  for (iter = m_InstanceList[direction].begin(); iter != m_InstanceList[direction].end(); iter++)
-    if (iter->pOwner == this)
-    {
-      if (iter->nBytesAvailable > nBytesTransferred)
-        iter->nBytesAvailable -= nBytesTransferred;
-      else
-        iter->nBytesAvailable = 0;
-      iter->nBytesTransferred += nBytesTransferred;
-      m_SpeedLimitSync.Unlock();
-      return TRUE;
-    }
-  m_SpeedLimitSync.Unlock();
-  return FALSE;
+  if (!m_pSpeedReservation[direction])
+    return FALSE;
+
+  m_pSpeedReservation[direction]->Consume(nBytesTransferred);
+  return TRUE;
 }
 
 CString CFtpControlSocket::ConvertDomainName(CString domain)
@@ -6280,8 +6452,12 @@ bool CFtpControlSocket::NeedModeCommand()
   return false;
 #else
   bool useZlib;
-  if (m_Operation.nOpMode == CSMODE_LIST || (m_Operation.nOpMode == CSMODE_TRANSFER && m_Operation.nOpMode <= FILETRANSFER_TYPE))
+  if (m_Operation.nOpMode == CSMODE_LIST || ((m_Operation.nOpMode & CSMODE_TRANSFER) && m_Operation.nOpState < FILETRANSFER_TYPE))
     useZlib = GetOptionVal(OPTION_MODEZ_USE) != 0;
+  else if (m_Operation.nOpMode & CSMODE_TRANSFER)
+    // Segments are delimited by offsets in the uncompressed data
+    useZlib = (GetOptionVal(OPTION_MODEZ_USE) > 1) && !IsCompressedFile(static_cast<CFileTransferData *>(m_Operation.pData)->transferfile.remotefile) &&
+      !static_cast<CFileTransferData *>(m_Operation.pData)->transferdata.bPart;
   else
     useZlib = GetOptionVal(OPTION_MODEZ_USE) > 1;
 
@@ -6292,6 +6468,26 @@ bool CFtpControlSocket::NeedModeCommand()
 #endif
 }
 
+#ifndef MPEXT_NO_ZLIB
+bool CFtpControlSocket::IsCompressedFile(const CString & fileName) const
+{
+  // Deflating already compressed data only wastes CPU on both sides
+  static const wchar_t * CompressedExtensions[] = {
+    L"zip", L"gz", L"tgz", L"bz2", L"xz", L"7z", L"rar", L"zst",
+    L"jpg", L"jpeg", L"png", L"gif", L"mp3", L"mp4", L"mkv", L"avi" };
+  int pos = fileName.ReverseFind(L'.');
+  if (pos < 0)
+    return false;
+  CString ext = fileName.Mid(pos + 1);
+  for (size_t i = 0; i < _countof(CompressedExtensions); i++)
+  {
+    if (!ext.CompareNoCase(CompressedExtensions[i]))
+      return true;
+  }
+  return false;
+}
+#endif
+
 bool CFtpControlSocket::NeedOptsCommand()
 {
 #ifndef MPEXT_NO_ZLIB
@@ -6381,7 +6577,7 @@ CString CFtpControlSocket::GetReply()
 
 void CFtpControlSocket::OnSend(int nErrorCode)
 {
-  if (!m_sendBufferLen || !m_sendBuffer || m_awaitsReply)
+  if (!m_sendBufferLen || !m_sendBuffer || (m_awaitsReply && !IsPipelining()))
     return;
 
   int res = CAsyncSocketEx::Send(m_sendBuffer, (int)m_sendBufferLen, 0, m_bUTF8 ? 0 : m_CurrentServer.iDupFF);
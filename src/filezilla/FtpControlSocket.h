@@ -11,6 +11,8 @@ class CMainThread;
 
 class CAsyncProxySocketLayer;
 class CMainThread;
+class TBandwidthLimiter;
+class TBandwidthReservation;
 
 #define CSMODE_NONE             0x0000
 #define CSMODE_CONNECT          0x0001
@@ -35,12 +37,15 @@ CUSTOM_MEM_ALLOCATION_IMPL
   t_transferdata() :
     transfersize(0), transferleft(0),
     localFileHandle(INVALID_HANDLE_VALUE),
-    bResume(FALSE), bResumeAppend(FALSE), bType(FALSE)
+    bResume(FALSE), bResumeAppend(FALSE), bType(FALSE), bPart(FALSE)
   {
   }
   int64_t transfersize, transferleft;
   HANDLE localFileHandle;
   BOOL bResume, bResumeAppend, bType;
+  // Only a segment of the file is downloaded,
+  // data connection is closed once transferleft reaches zero
+  BOOL bPart;
 };
 
 class CFtpControlSocket : public CAsyncSocketEx, public CApiLog
@@ -58,6 +63,7 @@ public:
   virtual void List(BOOL bFinish, int nError = 0, CServerPath path = CServerPath(), CString subdir = L"", int nListMode = 0);
   virtual void ListFile(const CString & filename, const CServerPath & path);
   virtual void FtpCommand(LPCTSTR pCommand);
+  virtual void PipelineCommands(LPCTSTR pCommands);
   virtual void Disconnect();
   virtual void FileTransfer(t_transferfile * transferfile = 0, BOOL bFinish = FALSE, int nError = 0);
   virtual void Delete(const CString & filename, const CServerPath & path, bool filenameOnly);
@@ -101,7 +107,7 @@ public:
   BOOL RemoveActiveTransfer();
   BOOL SpeedLimitAddTransferredBytes(enum transferDirection direction, _int64 nBytesTransferred);
 
-  _int64 GetSpeedLimit(enum transferDirection direction, CTime & time);
+  _int64 GetSpeedLimit(enum transferDirection direction);
 
   _int64 GetAbleToTransferSize(enum transferDirection direction, bool &beenWaiting, int nBufSize = 0);
 
@@ -138,6 +144,12 @@ protected:
   int FileTransferListState(bool get);
   bool NeedModeCommand();
   bool NeedOptsCommand();
+  bool IsPipelining() const;
+  bool IsPipelineProbeStalled() const;
+  void PrefetchPasv(bool transferReplyPending);
+#ifndef MPEXT_NO_ZLIB
+  bool IsCompressedFile(const CString & fileName) const;
+#endif
   CString GetListingCmd();
 
   bool InitConnect();
@@ -159,19 +171,10 @@ protected:
   CString ConvertDomainName(CString domain);
   bool ConnectTransferSocket(const CString & host, UINT port);
 
-  struct t_ActiveList
-  {
-  CUSTOM_MEM_ALLOCATION_IMPL
-    CFtpControlSocket * pOwner;
-    int64_t nBytesAvailable;
-    int64_t nBytesTransferred;
-  };
-  static rde::list<t_ActiveList> m_InstanceList[2];
-  static CTime m_CurrentTransferTime[2];
-  static _int64 m_CurrentTransferLimit[2];
-  static CCriticalSection m_SpeedLimitSync;
-  _int64 GetAbleToUDSize(bool & beenWaiting, CTime & curTime, _int64 & curLimit, rde::list<t_ActiveList>::iterator & iter, enum transferDirection direction, int nBufSize);
-  _int64 GetSpeedLimit(CTime & time, int valType, int valValue);
+  // Shared by all transfers of the process, one per direction
+  static TBandwidthLimiter m_SpeedLimiter[2];
+  TBandwidthReservation * m_pSpeedReservation[2];
+  _int64 GetSpeedLimit(int valType, int valValue);
 
   void SetDirectoryListing(t_directory * pDirectory, bool bSetWorkingDir = true);
   t_directory * m_pDirectoryListing;
@@ -192,6 +195,7 @@ protected:
   class CListFileData;
   class CFileTransferData;
   class CMakeDirData;
+  class CPipelineData;
 
 #ifndef MPEXT_NO_ZLIB
   bool m_useZlib;
@@ -209,7 +213,25 @@ protected:
   bool m_isFileZilla;
 
   bool m_awaitsReply;
-  bool m_skipReply;
+  int m_skipReplies;
+  // Whether a batch of pipelined commands was fully answered on this connection
+  bool m_pipeliningConfirmed;
+
+  // PASV/EPSV sent ahead for the next transfer, see PrefetchPasv
+  enum
+  {
+    PASVPREFETCH_NONE,
+    PASVPREFETCH_QUEUED, // reply to the current transfer is still to come first
+    PASVPREFETCH_SENT, // next reply is the PASV/EPSV one
+    PASVPREFETCH_AWAITED, // as SENT, with the next transfer waiting for the reply
+    PASVPREFETCH_DISCARD, // as SENT, but the reply is outdated
+    PASVPREFETCH_RECEIVED,
+  };
+  int m_nPasvPrefetch;
+  CStringA m_pasvPrefetchReply;
+  DWORD m_pasvPrefetchTick;
+  // TYPE in effect on the server (L'A' or L'I'), 0 when unknown
+  TCHAR m_transferType;
 
   char * m_sendBuffer;
   size_t m_sendBufferLen;
@@ -147,9 +147,12 @@ CFtpListResult::CFtpListResult(t_server & server, bool *bUTF8, int *nCodePage)
 
   pos=0;
 
-  m_prevline=0;
-  m_curline=0;
+  m_listformat=listformat_none;
+  m_hasprevline=false;
+  m_lineterm=NULL;
+  m_linetermchar=0;
   m_curlistaddpos=0;
+  m_datasize=0;
 
   //Fill the month names map
 
@@ -389,94 +392,97 @@ CFtpListResult::~CFtpListResult()
     ptr=ptr->next;
     delete ptr2;
   }
-  if (m_prevline)
-    nb_free(m_prevline);
-  if (m_curline)
-    nb_free(m_curline);
 }
 
 t_directory::t_direntry *CFtpListResult::getList(int &num, bool mlst)
 {
-  #ifdef _DEBUG
-  USES_CONVERSION;
-  #endif
-  char *line=GetLine();
-  m_curline=line;
-  while (line)
+  ParseLines(mlst, false);
+  m_hasprevline = false;
+
+  num=(int)m_EntryList.size();
+  if (!num)
+    return 0;
+  t_directory::t_direntry *res=new t_directory::t_direntry[num];
+  int i=0;
+  for (tEntryList::iterator iter=m_EntryList.begin();iter!=m_EntryList.end();iter++, i++)
+  {
+    res[i]=*iter;
+  }
+  m_EntryList.clear();
+  m_TempData.clear();
+
+  return res;
+}
+
+void CFtpListResult::ParseLines(bool mlst, bool completeOnly)
+{
+  t_list *pOldListPos = curpos;
+  int nOldListBufferPos = pos;
+
+  t_directory::t_direntry direntry;
+  const char *line;
+  int linelen;
+  bool hasline = GetLine(line, linelen);
+  // the line is the previous (unparsable) line joined with the current one
+  bool joined = false;
+  while (hasline)
   {
+    if (completeOnly)
+    {
+      if (!curpos)
+      {
+        // the rest of the line has not been received yet
+        ReleaseLine();
+        break;
+      }
+      pOldListPos = curpos;
+      nOldListBufferPos = pos;
+    }
+
     int tmp;
-    char *tmpline = nb::chcalloc(strlen(line) + 1);
-    strcpy(tmpline, line);
-    t_directory::t_direntry direntry;
-    if (parseLine(tmpline, (int)strlen(tmpline), direntry, tmp, mlst))
+    if (joined ?
+        parseLine(&m_joinedline[0], (int)m_joinedline.size() - 1, direntry, tmp, mlst) :
+        parseLine(line, linelen, direntry, tmp, mlst))
     {
-      nb_free(tmpline);
       if (tmp)
         m_server.nServerType |= tmp;
       if (direntry.name!=L"." && direntry.name!=L"..")
       {
         AddLine(direntry);
       }
-      if (m_prevline)
-      {
-        nb_free(m_prevline);
-        m_prevline=0;
-      }
-      if (m_curline!=line)
-        nb_free(m_curline);
-      nb_free(line);
-      line=GetLine();
-      m_curline=line;
+      m_hasprevline = false;
+      joined = false;
+      ReleaseLine();
+      hasline = GetLine(line, linelen);
+    }
+    else if (m_hasprevline && !joined)
+    {
+      // possibly an entry split to two lines (VMS)
+      int prevlen=(int)m_prevline.size() - 1;
+      m_joinedline.resize(prevlen + 1 + linelen + 1);
+      memcpy(&m_joinedline[0], &m_prevline[0], prevlen);
+      m_joinedline[prevlen]=' ';
+      memcpy(&m_joinedline[prevlen + 1], line, linelen);
+      m_joinedline[prevlen + 1 + linelen]=0;
+      joined = true;
     }
     else
     {
-      nb_free(tmpline);
-      if (m_prevline)
-      {
-        if (m_curline!=line)
-        {
-          nb_free(m_prevline);
-          m_prevline=m_curline;
-          nb_free(line);
-          line=GetLine();
-          m_curline=line;
-        }
-        else
-        {
-          line=nb::chcalloc(strlen(m_prevline)+strlen(m_curline)+2);
-          sprintf(line, "%s %s", m_prevline, m_curline);
-        }
-      }
-      else
-      {
-        m_prevline=line;
-        line=GetLine();
-        m_curline=line;
-      }
+      m_prevline.resize(linelen + 1);
+      memcpy(&m_prevline[0], line, linelen);
+      m_prevline[linelen]=0;
+      m_hasprevline = true;
+      joined = false;
+      ReleaseLine();
+      hasline = GetLine(line, linelen);
     }
   }
-  if (m_prevline)
-  {
-    nb_free(m_prevline);
-    m_prevline=0;
-  }
-  if (m_curline!=line)
-    nb_free(m_curline);
-  nb_free(line);
-  m_curline=0;
 
-  num=(int)m_EntryList.size();
-  if (!num)
-    return 0;
-  t_directory::t_direntry *res=new t_directory::t_direntry[num];
-  int i=0;
-  for (tEntryList::iterator iter=m_EntryList.begin();iter!=m_EntryList.end();iter++, i++)
+  if (completeOnly)
   {
-    res[i]=*iter;
+    curpos=pOldListPos;
+    pos=nOldListBufferPos;
   }
-  m_EntryList.clear();
-
-  return res;
 }
 
 BOOL CFtpListResult::parseLine(const char *lineToParse, const int linelen, t_directory::t_direntry &direntry, int &nFTPServerType, bool mlst)
@@ -488,61 +494,92 @@ BOOL CFtpListResult::parseLine(const char *lineToParse, const int linelen, t_dir
   direntry.owner = L"";
   direntry.group = L"";
 
-  if (parseAsMlsd(lineToParse, linelen, direntry, mlst))
+  // Listings are almost always in one format,
+  // so try the format that matched the previous line first
+  // and go through all of them only if it does not match.
+  // Only formats strict enough not to accept lines meant for a format
+  // of higher precedence are remembered (see the loop below)
+  if (m_listformat != listformat_none &&
+      parseAs(m_listformat, lineToParse, linelen, direntry, mlst))
     return TRUE;
 
-  if (parseAsUnix(lineToParse, linelen, direntry))
-    return TRUE;
+  // In order of precedence, listformat_ibmmvspds2 should be last
+  for (int format = 0; format < listformat_count; format++)
+  {
+    if ((format != m_listformat) &&
+        parseAs((t_listformat)format, lineToParse, linelen, direntry, mlst))
+    {
+      // The formats following VMS (parseAsOther, the IBM ones, parseAsWfFtp)
+      // are loose and may match lines of a format of higher precedence,
+      // they are always tried in the original order
+      m_listformat = (format <= listformat_vms) ? (t_listformat)format : listformat_none;
+      return TRUE;
+    }
+  }
 
-  if (parseAsDos(lineToParse, linelen, direntry))
+  // name-only entries
+  if (strchr(lineToParse, ' ') == NULL)
+  {
+    copyStr(direntry.name, 0, lineToParse, (int)strlen(lineToParse));
     return TRUE;
+  }
 
-  if (parseAsEPLF(lineToParse, linelen, direntry))
-    return TRUE;
+  return FALSE;
+}
 
-  if (parseAsVMS(lineToParse, linelen, direntry))
+BOOL CFtpListResult::parseAs(t_listformat format, const char *line, const int linelen, t_directory::t_direntry &direntry, bool mlst)
+{
+  switch (format)
   {
+    case listformat_mlsd:
+      return parseAsMlsd(line, linelen, direntry, mlst);
+
+    case listformat_unix:
+      return parseAsUnix(line, linelen, direntry);
+
+    case listformat_dos:
+      return parseAsDos(line, linelen, direntry);
+
+    case listformat_eplf:
+      return parseAsEPLF(line, linelen, direntry);
+
+    case listformat_vms:
+      if (parseAsVMS(line, linelen, direntry))
+      {
 #ifndef LISTDEBUG
-    m_server.nServerType |= FZ_SERVERTYPE_SUB_FTP_VMS;
+        m_server.nServerType |= FZ_SERVERTYPE_SUB_FTP_VMS;
 #endif // LISTDEBUG
-    return TRUE;
-  }
+        return TRUE;
+      }
+      return FALSE;
 
-  if (parseAsOther(lineToParse, linelen, direntry))
-    return TRUE;
+    case listformat_other:
+      return parseAsOther(line, linelen, direntry);
 
-  if (parseAsIBMMVS(lineToParse, linelen, direntry))
-    return TRUE;
+    case listformat_ibmmvs:
+      return parseAsIBMMVS(line, linelen, direntry);
 
-  if (parseAsIBMMVSPDS(lineToParse, linelen, direntry))
-    return TRUE;
+    case listformat_ibmmvspds:
+      return parseAsIBMMVSPDS(line, linelen, direntry);
 
-  if (parseAsIBM(lineToParse, linelen, direntry))
-    return TRUE;
+    case listformat_ibm:
+      return parseAsIBM(line, linelen, direntry);
 
-  if (parseAsWfFtp(lineToParse, linelen, direntry))
-    return TRUE;
+    case listformat_wfftp:
+      return parseAsWfFtp(line, linelen, direntry);
 
-  // Should be last
-  if (parseAsIBMMVSPDS2(lineToParse, linelen, direntry))
-    return TRUE;
+    case listformat_ibmmvspds2:
+      return parseAsIBMMVSPDS2(line, linelen, direntry);
 
-  // name-only entries
-  if (strchr(lineToParse, ' ') == NULL)
-  {
-    copyStr(direntry.name, 0, lineToParse, (int)strlen(lineToParse));
-    return TRUE;
+    default:
+      DebugFail();
+      return FALSE;
   }
-
-  return FALSE;
 }
 
 // Used only with LISTDEBUG
 void CFtpListResult::AddData(char *data, int size)
 {
-  #ifdef _DEBUG
-  USES_CONVERSION;
-  #endif
   if (!size)
     return;
 
@@ -562,81 +599,19 @@ void CFtpListResult::AddData(char *data, int size)
   m_curlistaddpos->len = size;
   m_curlistaddpos->next = 0;
 
-  t_list *pOldListPos = curpos;
-  int nOldListBufferPos = pos;
-
-  //Try if there are already some complete lines
-  t_directory::t_direntry direntry;
-  char *line = GetLine();
-  m_curline = line;
-  while (line)
+  // Preallocate room for the entries the data received so far likely holds
+  // (listing lines are rarely shorter than 40 characters),
+  // so that large listings do not keep reallocating and copying the entries
+  m_datasize += size;
+  tEntryList::size_type expected = (tEntryList::size_type)(m_datasize / 40 + 1);
+  if (m_EntryList.capacity() < expected)
   {
-    if (curpos)
-    {
-      pOldListPos = curpos;
-      nOldListBufferPos = pos;
-    }
-    else
-    {
-      nb_free(line);
-      if (m_curline != line)
-        nb_free(m_curline);
-      m_curline = 0;
-      break;
-    }
-    int tmp;
-    char *tmpline = nb::chcalloc(strlen(line) + 1);
-    strcpy(tmpline, line);
-    if (parseLine(tmpline, (const int)strlen(tmpline), direntry, tmp, false))
-    {
-      nb_free(tmpline);
-      if (tmp)
-        m_server.nServerType |= tmp;
-      if (direntry.name!=L"." && direntry.name!=L"..")
-      {
-        AddLine(direntry);
-      }
-      if (m_prevline)
-      {
-        nb_free(m_prevline);
-        m_prevline=0;
-      }
-      if (m_curline!=line)
-        nb_free(m_curline);
-      nb_free(line);
-      line = GetLine();
-      m_curline = line;
-    }
-    else
-    {
-      nb_free(tmpline);
-      if (m_prevline)
-      {
-        if (m_curline != line)
-        {
-          nb_free(m_prevline);
-          m_prevline = m_curline;
-          nb_free(line);
-          line = GetLine();
-          m_curline = line;
-        }
-        else
-        {
-          line=nb::chcalloc(strlen(m_prevline)+strlen(m_curline)+2);
-          sprintf(line, "%s %s", m_prevline, m_curline);
-        }
-      }
-      else
-      {
-        m_prevline=line;
-        line=GetLine();
-        m_curline=line;
-      }
-    }
+    m_EntryList.reserve(expected * 2);
+    m_TempData.reserve(expected * 2);
   }
-  curpos=pOldListPos;
-  pos=nOldListBufferPos;
 
+  //Try if there are already some complete lines
+  ParseLines(false, true);
 }
 
 void CFtpListResult::SendToMessageLog()
@@ -645,11 +620,13 @@ void CFtpListResult::SendToMessageLog()
   int oldbufferpos = pos;
   curpos = listhead;
   pos=0;
-  char *line = GetLine();
+  const char *line;
+  int linelen;
+  bool hasline = GetLine(line, linelen);
   // Note that FZ_LOG_INFO here is not checked against debug level, as the direct
   // call to PostMessage bypasses check in LogMessage.
   // So we get the listing on any logging level, what is actually what we want
-  if (!line)
+  if (!hasline)
   {
     //Displays a message in the message log
     t_ffam_statusmessage *pStatus = new t_ffam_statusmessage();
@@ -658,10 +635,10 @@ void CFtpListResult::SendToMessageLog()
     pStatus->type = FZ_LOG_INFO;
     GetIntern()->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_STATUS, 0), (LPARAM)pStatus);
   }
-  while (line)
+  while (hasline)
   {
-    CString status = line;
-    nb_free(line);
+    CString status(line, linelen);
+    ReleaseLine();
 
     //Displays a message in the message log
     t_ffam_statusmessage *pStatus = new t_ffam_statusmessage();
@@ -671,16 +648,17 @@ void CFtpListResult::SendToMessageLog()
     if (!GetIntern()->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_STATUS, 0), (LPARAM)pStatus))
       delete pStatus;
 
-    line = GetLine();
+    hasline = GetLine(line, linelen);
   }
   curpos = oldlistpos;
   pos = oldbufferpos;
 }
 
-char * CFtpListResult::GetLine()
+bool CFtpListResult::GetLine(const char *&line, int &linelen)
 {
+  DebugAssert(m_lineterm == NULL);
   if (!curpos)
-    return 0;
+    return false;
   int len=curpos->len;
   while (curpos->buffer[pos]=='\r' || curpos->buffer[pos]=='\n' || curpos->buffer[pos]==' ' || curpos->buffer[pos]=='\t')
   {
@@ -689,7 +667,7 @@ char * CFtpListResult::GetLine()
     {
       curpos=curpos->next;
       if (!curpos)
-        return 0;
+        return false;
       len=curpos->len;
       pos=0;
     }
@@ -721,7 +699,22 @@ char * CFtpListResult::GetLine()
     }
   }
 
-  char *res = nb::chcalloc(reslen+1);
+  linelen=reslen;
+  if (startptr==curpos)
+  {
+    // The line is terminated within the buffer it starts in,
+    // terminate it in place (after trailing spaces are trimmed)
+    // instead of copying. The buffer is restored in ReleaseLine.
+    m_lineterm=&startptr->buffer[startpos+reslen];
+    m_linetermchar=*m_lineterm;
+    *m_lineterm=0;
+    line=&startptr->buffer[startpos];
+    return true;
+  }
+
+  // The line spans more buffers (or is not terminated yet), assemble it
+  m_linebuffer.resize(reslen+1);
+  char *res=&m_linebuffer[0];
   res[reslen]=0;
   int respos=0;
   while (startptr!=curpos && reslen)
@@ -743,7 +736,17 @@ char * CFtpListResult::GetLine()
     memcpy(&res[respos], &curpos->buffer[startpos], copylen);
   }
 
-  return res;
+  line=res;
+  return true;
+}
+
+void CFtpListResult::ReleaseLine()
+{
+  if (m_lineterm)
+  {
+    *m_lineterm=m_linetermchar;
+    m_lineterm=NULL;
+  }
 }
 
 void CFtpListResult::AddLine(t_directory::t_direntry &direntry)
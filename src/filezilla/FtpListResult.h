@@ -38,7 +38,7 @@ public:
   t_directory::t_direntry * getList(int & num, bool mlst);
 
 private:
-  typedef rde::list<t_directory::t_direntry> tEntryList;
+  typedef rde::vector<t_directory::t_direntry> tEntryList;
   tEntryList m_EntryList;
 
   BOOL parseLine(const char * lineToParse, const int linelen, t_directory::t_direntry & direntry, int & nFTPServerType, bool mlst);
@@ -55,6 +55,27 @@ private:
   BOOL parseAsIBMMVSPDS2(const char * line, const int linelen, t_directory::t_direntry & direntry);
   BOOL parseAsWfFtp(const char * line, const int linelen, t_directory::t_direntry & direntry);
 
+  enum t_listformat
+  {
+    listformat_none = -1,
+    listformat_mlsd,
+    listformat_unix,
+    listformat_dos,
+    listformat_eplf,
+    listformat_vms,
+    listformat_other,
+    listformat_ibmmvs,
+    listformat_ibmmvspds,
+    listformat_ibm,
+    listformat_wfftp,
+    listformat_ibmmvspds2,
+    listformat_count
+  };
+  BOOL parseAs(t_listformat format, const char * line, const int linelen, t_directory::t_direntry & direntry, bool mlst);
+  // Format that matched the last parsed line, tried first for the next one,
+  // only set for the unambiguous formats (listformat_vms and those before it)
+  t_listformat m_listformat;
+
   const char * GetNextToken(const char * line, const int linelen, int & len, int & pos, int type) const;
 
   bool ParseShortDate(const char * str, int len, t_directory::t_direntry::t_date & date) const;
@@ -72,7 +93,7 @@ private:
     t_list * next;
   } * listhead, * curpos, * m_curlistaddpos;
 
-  typedef rde::list<int> tTempData;
+  typedef rde::vector<int> tTempData;
   tTempData m_TempData;
 
   // Month names map
@@ -86,8 +107,17 @@ protected:
   const char * strnstr(const char * str, int len, const char * c) const;
   _int64 strntoi64(const char * str, int len) const;
   void AddLine(t_directory::t_direntry & direntry);
-  char * GetLine();
+  void ParseLines(bool mlst, bool completeOnly);
+  // Returns the next line, pointing directly into the received data
+  // where possible, valid until ReleaseLine() is called
+  bool GetLine(const char *& line, int & linelen);
+  void ReleaseLine();
   bool IsNumeric(const char * str, int len) const;
-  char * m_prevline;
-  char * m_curline;
+  rde::vector<char> m_linebuffer;
+  rde::vector<char> m_prevline;
+  rde::vector<char> m_joinedline;
+  bool m_hasprevline;
+  char * m_lineterm;
+  char m_linetermchar;
+  _int64 m_datasize;
 };
@@ -45,6 +45,9 @@ CUSTOM_MEM_ALLOCATION_IMPL
   t_server server;
   int nType;
   void * nUserData;
+  // Segment of the file to download, partsize < 0 means the whole file
+  int64_t partoffset;
+  int64_t partsize;
 };
 
 
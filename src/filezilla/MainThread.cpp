@@ -124,6 +124,10 @@ BOOL CMainThread::OnThreadMessage(UINT Msg, WPARAM wParam, LPARAM lParam)
           DebugAssert(m_pControlSocket);
           m_pControlSocket->FtpCommand(pCommand->param1);
           break;
+        case FZ_COMMAND_PIPELINE:
+          DebugAssert(m_pControlSocket);
+          m_pControlSocket->PipelineCommands(pCommand->param1);
+          break;
         case FZ_COMMAND_DELETE:
           DebugAssert(m_pControlSocket);
           m_pControlSocket->Delete(pCommand->param1, pCommand->path, (pCommand->param4 != 0));
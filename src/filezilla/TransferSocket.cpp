@@ -15,16 +15,93 @@
 
 #define BUFSIZE 16384
 
+// Amount of data after which compressibility of an upload is evaluated
+#define ZLIB_PROBE_SIZE (1024 * 1024)
+
 #define STATE_WAITING    0
 #define STATE_STARTING    1
 #define STATE_STARTED    2
 
+/////////////////////////////////////////////////////////////////////////////
+// CTransferBufferPool
+
+// Data buffers are recycled among transfer sockets (of all sessions),
+// so that transfers of many files do not allocate
+// the (possibly large) buffers again for each of them
+class CTransferBufferPool
+{
+public:
+  CTransferBufferPool()
+  {
+    m_size = 0;
+  }
+
+  ~CTransferBufferPool()
+  {
+    Clear();
+  }
+
+  char * Get(int size)
+  {
+    char * buffer = NULL;
+    m_section.Lock();
+    if ((size == m_size) && !m_buffers.empty())
+    {
+      buffer = m_buffers.back();
+      m_buffers.pop_back();
+    }
+    m_section.Unlock();
+    if (!buffer)
+      buffer = nb::chcalloc(size);
+    return buffer;
+  }
+
+  void Release(char * buffer, int size)
+  {
+    if (!buffer)
+      return;
+    m_section.Lock();
+    if (size != m_size)
+    {
+      // buffer size configuration has changed, drop buffers of the old size
+      Clear();
+      m_size = size;
+    }
+    if (m_buffers.size() < MaxBuffers)
+    {
+      m_buffers.push_back(buffer);
+      buffer = NULL;
+    }
+    m_section.Unlock();
+    nb_free(buffer);
+  }
+
+private:
+  enum { MaxBuffers = 8 };
+
+  void Clear()
+  {
+    for (size_t i = 0; i < m_buffers.size(); i++)
+      nb_free(m_buffers[i]);
+    m_buffers.clear();
+  }
+
+  CCriticalSectionWrapper m_section;
+  rde::vector<char *> m_buffers;
+  int m_size;
+};
+
+static CTransferBufferPool TransferBufferPool;
+
 /////////////////////////////////////////////////////////////////////////////
 // CTransferSocket
 
+static LONG TransferSocketId = 0;
+
 CTransferSocket::CTransferSocket(CFtpControlSocket *pOwner, int nMode)
 {
   DebugAssert(pOwner);
+  m_nTransferId = InterlockedIncrement(&TransferSocketId);
   InitIntern(pOwner->GetIntern());
   m_pOwner = pOwner;
   m_nMode = nMode;
@@ -45,6 +122,9 @@ CTransferSocket::CTransferSocket(CFtpControlSocket *pOwner, int nMode)
   m_bActivationPending = false;
   m_LastSendBufferUpdate = 0;
   m_SendBuf = 0;
+  m_nBufferSize = GetOptionVal(OPTION_MPEXT_TRANSFERBUFFERSIZE);
+  if (m_nBufferSize < BUFSIZE)
+    m_nBufferSize = BUFSIZE;
 
   UpdateStatusBar(true);
 
@@ -66,14 +146,15 @@ CTransferSocket::CTransferSocket(CFtpControlSocket *pOwner, int nMode)
 #ifndef MPEXT_NO_ZLIB
   memset(&m_zlibStream, 0, sizeof(m_zlibStream));
   m_useZlib = false;
+  m_zlibProbe = false;
 #endif
 }
 
 CTransferSocket::~CTransferSocket()
 {
-  nb_free(m_pBuffer);
+  TransferBufferPool.Release(m_pBuffer, m_nBufferSize);
 #ifndef MPEXT_NO_ZLIB
-  nb_free(m_pBuffer2);
+  TransferBufferPool.Release(m_pBuffer2, m_nBufferSize);
 #endif
   GetIntern()->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_TRANSFERSTATUS, 0), 0);
   Close();
@@ -120,8 +201,11 @@ void CTransferSocket::OnReceive(int nErrorCode)
     if (m_nTransferState == STATE_STARTING)
       OnConnect(0);
 
-    char *buffer = nb::chcalloc(BUFSIZE);
-    int numread = CAsyncSocketEx::Receive(buffer, BUFSIZE);
+    // The listing keeps the data (for the log),
+    // so it gets a copy of just the size actually received
+    if (!m_pBuffer)
+      m_pBuffer = TransferBufferPool.Get(m_nBufferSize);
+    int numread = CAsyncSocketEx::Receive(m_pBuffer, m_nBufferSize);
     if (numread != SOCKET_ERROR && numread)
     {
       m_LastActiveTime = CTime::GetCurrentTime();
@@ -129,44 +213,40 @@ void CTransferSocket::OnReceive(int nErrorCode)
 #ifndef MPEXT_NO_ZLIB
       if (m_useZlib)
       {
-        m_zlibStream.next_in = (Bytef *)buffer;
+        if (!m_pBuffer2)
+          m_pBuffer2 = TransferBufferPool.Get(m_nBufferSize);
+
+        m_zlibStream.next_in = (Bytef *)m_pBuffer;
         m_zlibStream.avail_in = numread;
-        char *out = nb::calloc(BUFSIZE);
-        m_zlibStream.next_out = (Bytef *)out;
-        m_zlibStream.avail_out = BUFSIZE;
+        m_zlibStream.next_out = (Bytef *)m_pBuffer2;
+        m_zlibStream.avail_out = m_nBufferSize;
         int res = inflate(&m_zlibStream, 0);
         while (res == Z_OK)
         {
-          m_pListResult->AddData(out, BUFSIZE - m_zlibStream.avail_out);
-          out = nb::calloc(BUFSIZE);
-          m_zlibStream.next_out = (Bytef *)out;
-          m_zlibStream.avail_out = BUFSIZE;
+          AddListData(m_pBuffer2, m_nBufferSize - m_zlibStream.avail_out);
+          m_zlibStream.next_out = (Bytef *)m_pBuffer2;
+          m_zlibStream.avail_out = m_nBufferSize;
           res = inflate(&m_zlibStream, 0);
         }
-        nb_free(buffer);
         if (res == Z_STREAM_END)
-          m_pListResult->AddData(out, BUFSIZE - m_zlibStream.avail_out);
+          AddListData(m_pBuffer2, m_nBufferSize - m_zlibStream.avail_out);
         else if (res != Z_OK && res != Z_BUF_ERROR)
         {
-          nb_free(out);
           CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
           return;
         }
-        else
-          nb_free(out);
       }
       else
 #endif
-        m_pListResult->AddData(buffer, numread);
+        AddListData(m_pBuffer, numread);
       m_transferdata.transfersize += numread;
       t_ffam_transferstatus *status = new t_ffam_transferstatus();
       status->bFileTransfer = FALSE;
       status->transfersize = -1;
       status->bytes = m_transferdata.transfersize;
+      status->transferid = m_nTransferId;
       GetIntern()->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_TRANSFERSTATUS, 0), (LPARAM)status);
     }
-    else
-      nb_free(buffer);
     if (!numread)
     {
       CloseAndEnsureSendClose(0);
@@ -199,9 +279,12 @@ void CTransferSocket::OnReceive(int nErrorCode)
     bool beenWaiting = false;
     _int64 ableToRead;
     if (GetState() != closed)
-      ableToRead = m_pOwner->GetAbleToTransferSize(CFtpControlSocket::download, beenWaiting);
+      ableToRead = m_pOwner->GetAbleToTransferSize(CFtpControlSocket::download, beenWaiting, m_nBufferSize);
     else
-      ableToRead = BUFSIZE;
+      ableToRead = m_nBufferSize;
+    // Do not read into the next segment
+    if (m_transferdata.bPart && (ableToRead > m_transferdata.transferleft))
+      ableToRead = m_transferdata.transferleft;
 
     if (!beenWaiting)
       DebugAssert(ableToRead);
@@ -212,7 +295,7 @@ void CTransferSocket::OnReceive(int nErrorCode)
     }
 
     if (!m_pBuffer)
-      m_pBuffer = nb::chcalloc(BUFSIZE);
+      m_pBuffer = TransferBufferPool.Get(m_nBufferSize);
 
     int numread = CAsyncSocketEx::Receive(m_pBuffer, static_cast<int>(ableToRead));
     if (numread!=SOCKET_ERROR)
@@ -257,25 +340,25 @@ void CTransferSocket::OnReceive(int nErrorCode)
       if (m_useZlib)
       {
         if (!m_pBuffer2)
-          m_pBuffer2 = nb::calloc(BUFSIZE);
+          m_pBuffer2 = TransferBufferPool.Get(m_nBufferSize);
 
         m_zlibStream.next_in = (Bytef *)m_pBuffer;
         m_zlibStream.avail_in = numread;
         m_zlibStream.next_out = (Bytef *)m_pBuffer2;
-        m_zlibStream.avail_out = BUFSIZE;
+        m_zlibStream.avail_out = m_nBufferSize;
         int res = inflate(&m_zlibStream, 0);
         while (res == Z_OK)
         {
-          m_pFile->Write(m_pBuffer2, BUFSIZE - m_zlibStream.avail_out);
-          written += BUFSIZE - m_zlibStream.avail_out;
+          m_pFile->Write(m_pBuffer2, m_nBufferSize - m_zlibStream.avail_out);
+          written += m_nBufferSize - m_zlibStream.avail_out;
           m_zlibStream.next_out = (Bytef *)m_pBuffer2;
-          m_zlibStream.avail_out = BUFSIZE;
+          m_zlibStream.avail_out = m_nBufferSize;
           res = inflate(&m_zlibStream, 0);
         }
         if (res == Z_STREAM_END)
         {
-          m_pFile->Write(m_pBuffer2, BUFSIZE - m_zlibStream.avail_out);
-          written += BUFSIZE - m_zlibStream.avail_out;
+          m_pFile->Write(m_pBuffer2, m_nBufferSize - m_zlibStream.avail_out);
+          written += m_nBufferSize - m_zlibStream.avail_out;
         }
         else if (res != Z_OK && res != Z_BUF_ERROR)
         {
@@ -303,10 +386,28 @@ void CTransferSocket::OnReceive(int nErrorCode)
     END_CATCH;
     m_transferdata.transferleft -= written;
 
+    if (m_transferdata.bPart && (m_transferdata.transferleft <= 0))
+    {
+      UpdateStatusBar(true);
+      // The rest of the file is downloaded by other connections,
+      // closing the data connection makes the server end the transfer
+      CloseAndEnsureSendClose(0);
+      return;
+    }
+
     UpdateStatusBar(false);
   }
 }
 
+void CTransferSocket::AddListData(const char *data, int len)
+{
+  if (!len)
+    return;
+  char *buffer = nb::chcalloc(len);
+  memcpy(buffer, data, len);
+  m_pListResult->AddData(buffer, len);
+}
+
 void CTransferSocket::SetBuffers()
 {
   /* Set internal socket send buffer
@@ -572,15 +673,15 @@ void CTransferSocket::OnSend(int nErrorCode)
   {
     if (!m_pBuffer)
     {
-      m_pBuffer = nb::calloc(BUFSIZE);
+      m_pBuffer = TransferBufferPool.Get(m_nBufferSize);
       m_bufferpos = 0;
 
       m_zlibStream.next_out = (Bytef *)m_pBuffer;
-      m_zlibStream.avail_out = BUFSIZE;
+      m_zlibStream.avail_out = m_nBufferSize;
     }
     if (!m_pBuffer2)
     {
-      m_pBuffer2 = nb::calloc(BUFSIZE);
+      m_pBuffer2 = TransferBufferPool.Get(m_nBufferSize);
 
       m_zlibStream.next_in = (Bytef *)m_pBuffer2;
     }
@@ -594,7 +695,7 @@ void CTransferSocket::OnSend(int nErrorCode)
         if (m_pFile)
         {
           DWORD numread;
-          numread = ReadDataFromFile(m_pBuffer2, BUFSIZE);
+          numread = ReadDataFromFile(m_pBuffer2, m_nBufferSize);
           if (numread < 0)
           {
             return;
@@ -604,17 +705,42 @@ void CTransferSocket::OnSend(int nErrorCode)
           m_zlibStream.next_in = (Bytef *)m_pBuffer2;
           m_zlibStream.avail_in = numread;
 
-          if (numread < BUFSIZE)
+          if (numread < static_cast<DWORD>(m_nBufferSize))
             m_pFile = 0;
         }
       }
       if (!m_zlibStream.avail_out)
       {
-        if (m_bufferpos >= BUFSIZE)
+        if (m_bufferpos >= m_nBufferSize)
         {
           m_bufferpos = 0;
           m_zlibStream.next_out = (Bytef *)m_pBuffer;
-          m_zlibStream.avail_out = BUFSIZE;
+          m_zlibStream.avail_out = m_nBufferSize;
+        }
+      }
+
+      if (m_zlibProbe && m_zlibStream.avail_out && (m_zlibStream.total_in >= ZLIB_PROBE_SIZE))
+      {
+        if (m_zlibStream.total_out < m_zlibStream.total_in / 100 * 95)
+        {
+          m_zlibProbe = false;
+        }
+        else
+        {
+          // The data does not compress (already compressed file),
+          // send the rest in stored blocks not to waste CPU
+          int paramsres = deflateParams(&m_zlibStream, 0, Z_DEFAULT_STRATEGY);
+          if (paramsres == Z_OK)
+          {
+            m_pOwner->ShowStatus(L"Data is not compressible, disabling compression", FZ_LOG_INFO);
+            m_zlibProbe = false;
+          }
+          else if (paramsres != Z_BUF_ERROR) // Z_BUF_ERROR = retry once output is sent
+          {
+            m_pOwner->ShowStatus(L"Compression error", FZ_LOG_ERROR);
+            CloseAndEnsureSendClose(CSMODE_TRANSFERERROR);
+            return;
+          }
         }
       }
 
@@ -630,17 +756,17 @@ void CTransferSocket::OnSend(int nErrorCode)
         }
       }
 
-      numsend = BUFSIZE;
-      int len = BUFSIZE - m_bufferpos - m_zlibStream.avail_out;
+      numsend = m_nBufferSize;
+      int len = m_nBufferSize - m_bufferpos - m_zlibStream.avail_out;
       if (!len && !m_pFile)
       {
         break;
       }
 
-      if (len < BUFSIZE)
+      if (len < m_nBufferSize)
         numsend = len;
 
-      int nLimit = (int)m_pOwner->GetAbleToTransferSize(CFtpControlSocket::upload, beenWaiting);
+      int nLimit = (int)m_pOwner->GetAbleToTransferSize(CFtpControlSocket::upload, beenWaiting, m_nBufferSize);
       if (nLimit != -1 && GetState() != closed && numsend > nLimit)
         numsend = nLimit;
 
@@ -680,7 +806,7 @@ void CTransferSocket::OnSend(int nErrorCode)
       UpdateStatusBar(false);
 
       if (!m_zlibStream.avail_in && !m_pFile && m_zlibStream.avail_out &&
-        m_zlibStream.avail_out + m_bufferpos == BUFSIZE && res == Z_STREAM_END)
+        m_zlibStream.avail_out + m_bufferpos == m_nBufferSize && res == Z_STREAM_END)
       {
         CloseOnShutDownOrError(0);
         return;
@@ -703,16 +829,16 @@ void CTransferSocket::OnSend(int nErrorCode)
       return;
     }
     if (!m_pBuffer)
-      m_pBuffer = nb::chcalloc(BUFSIZE);
+      m_pBuffer = TransferBufferPool.Get(m_nBufferSize);
 
     int numread;
 
     bool beenWaiting = false;
     _int64 currentBufferSize;
     if (GetState() != closed)
-      currentBufferSize = m_pOwner->GetAbleToTransferSize(CFtpControlSocket::upload, beenWaiting);
+      currentBufferSize = m_pOwner->GetAbleToTransferSize(CFtpControlSocket::upload, beenWaiting, m_nBufferSize);
     else
-      currentBufferSize = BUFSIZE;
+      currentBufferSize = m_nBufferSize;
 
     if (!currentBufferSize && !m_bufferpos)
     {
@@ -736,7 +862,7 @@ void CTransferSocket::OnSend(int nErrorCode)
     else
       numread = 0;
 
-    DebugAssert((numread+m_bufferpos) <= BUFSIZE);
+    DebugAssert((numread+m_bufferpos) <= m_nBufferSize);
     DebugAssert(numread>=0);
     DebugAssert(m_bufferpos>=0);
 
@@ -787,7 +913,7 @@ void CTransferSocket::OnSend(int nErrorCode)
       {
         int pos = numread + m_bufferpos - numsent;
 
-        if (pos < 0 || (numsent + pos) > BUFSIZE)
+        if (pos < 0 || (numsent + pos) > m_nBufferSize)
         {
           LogMessage(FZ_LOG_WARNING, L"Index out of range");
           CloseOnShutDownOrError(CSMODE_TRANSFERERROR);
@@ -821,9 +947,9 @@ void CTransferSocket::OnSend(int nErrorCode)
       UpdateStatusBar(false);
 
       if (GetState() != closed)
-        currentBufferSize = m_pOwner->GetAbleToTransferSize(CFtpControlSocket::upload, beenWaiting);
+        currentBufferSize = m_pOwner->GetAbleToTransferSize(CFtpControlSocket::upload, beenWaiting, m_nBufferSize);
       else
-        currentBufferSize = BUFSIZE;
+        currentBufferSize = m_nBufferSize;
 
       if (m_bufferpos < currentBufferSize)
       {
@@ -880,6 +1006,7 @@ void CTransferSocket::UpdateStatusBar(bool forceUpdate)
   status->bFileTransfer = m_nMode & (CSMODE_DOWNLOAD | CSMODE_UPLOAD);
   status->transfersize = m_transferdata.transfersize;
   status->bytes=m_transferdata.transfersize-m_transferdata.transferleft;
+  status->transferid = m_nTransferId;
 
   GetIntern()->FZPostMessage(FZ_MSG_MAKEMSG(FZ_MSG_TRANSFERSTATUS, 0), (LPARAM)status);
 }
@@ -1082,7 +1209,11 @@ bool CTransferSocket::InitZlib(int level)
     res = inflateInit2(&m_zlibStream, 15);
 
   if (res == Z_OK)
+  {
     m_useZlib = true;
+    // Only file uploads are worth probing, listings are always text
+    m_zlibProbe = (m_nMode & CSMODE_UPLOAD) && (level > 0);
+  }
 
   return res == Z_OK;
 }
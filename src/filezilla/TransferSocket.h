@@ -70,6 +70,7 @@ protected:
 #ifndef MPEXT_NO_ZLIB
   char * m_pBuffer2; // Used by zlib transfers
 #endif
+  int m_nBufferSize; // Size of both buffers above
   BOOL m_bCheckTimeout;
   CTime m_LastActiveTime;
   int m_nTransferState;
@@ -82,14 +83,17 @@ protected:
   void CloseOnShutDownOrError(int Mode);
   void LogError(int Error);
   void SetBuffers();
+  void AddListData(const char * data, int len);
 
   LARGE_INTEGER m_LastUpdateTime;
+  LONG m_nTransferId;
   unsigned int m_LastSendBufferUpdate;
   DWORD m_SendBuf;
 
 #ifndef MPEXT_NO_ZLIB
   z_stream m_zlibStream;
   bool m_useZlib;
+  bool m_zlibProbe; // Compressibility of uploaded data is yet to be evaluated
 #endif
 };
 
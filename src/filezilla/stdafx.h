@@ -2,7 +2,6 @@
 
 #define _int64 int64_t
 
-#define MPEXT_NO_ZLIB
 #define MPEXT_NO_GSS
 #define _AFX_ENABLE_INLINES
 #define _AFX_NOFORCE_LIBS
@@ -72,6 +71,8 @@ CUSTOM_MEM_ALLOCATION_IMPL
   int64_t bytes;
   int64_t transfersize;
   BOOL bFileTransfer;
+  // Identifies the data connection (transfer) the status belongs to
+  LONG transferid;
 };
 
 #undef CFile